@@ -14,6 +14,12 @@
 
 // CHANGELOG
 // (minor and older changes stripped away, please see git history for details)
+//  2018-05-26: Misc: Charge the allocations made while rendering to the GL staging memory tag (renoir::utils::MEMORY_TAG_GL_STAGING).
+//  2018-05-23: Misc: Accept a NULL window for headless rendering. The caller then provides io.DisplaySize and the mouse inputs, and no cursor is created or changed.
+//  2018-05-23: OpenGL: Batch consecutive draw commands sharing a texture, across draw lists, into a single glMultiDrawElementsBaseVertex. Clipping moves from the scissor to the fragment shader, with the clip rect as a vertex attribute.
+//  2018-05-22: OpenGL: Go through renoir::graphics::GLStateCache for every state change. Backing up and restoring the GL state is a copy of its shadow instead of ~20 glGet calls, and redundant texture/scissor changes between draw commands never reach GL.
+//  2018-05-22: OpenGL: Upload the vertices and indices of every draw list into a single per-frame region of a persistently mapped ring buffer (renoir::graphics::StreamBuffer) and draw with glDrawElementsBaseVertex.
+//  2018-05-21: OpenGL: Cache the VAO with the rest of device objects. It is only recreated (per frame) when rendering from a different GL context than the one that created it.
 //  2018-03-20: Misc: Setup io.BackendFlags ImGuiBackendFlags_HasMouseCursors flag + honor ImGuiConfigFlags_NoMouseCursorChange flag.
 //  2018-03-06: OpenGL: Added const char* glsl_version parameter to ImGui_ImplSdlGL3_Init() so user can override the GLSL version e.g. "#version 150".
 //  2018-02-23: OpenGL: Create the VAO in the render function so the setup can more easily be used with multiple shared GL context.
@@ -47,6 +53,10 @@
 #include <SDL_syswm.h>
 #include <external/GL/gl3w.h>    // This example is using gl3w to access OpenGL functions (because it is small). You may use glew/glad/glLoadGen/etc. whatever already works for you.
 
+#include "graphics/gl_state.h"
+#include "graphics/stream_buffer.h"
+#include "utils/memory.h"
+
 // SDL data
 static Uint64       g_Time = 0;
 static bool         g_MousePressed[3] = { false, false, false };
@@ -57,14 +67,79 @@ static char         g_GlslVersion[32] = "#version 150";
 static GLuint       g_FontTexture = 0;
 static int          g_ShaderHandle = 0, g_VertHandle = 0, g_FragHandle = 0;
 static int          g_AttribLocationTex = 0, g_AttribLocationProjMtx = 0;
-static int          g_AttribLocationPosition = 0, g_AttribLocationUV = 0, g_AttribLocationColor = 0;
-static unsigned int g_VboHandle = 0,g_ElementsHandle = 0;
+static int          g_AttribLocationPosition = 0, g_AttribLocationUV = 0, g_AttribLocationColor = 0, g_AttribLocationClip = 0;
+static renoir::graphics::StreamBuffer g_StreamBuffer;   // Vertices and indices of every frame
+static GLuint       g_VaoHandle = 0;
+static SDL_GLContext g_VaoContext = NULL;   // VAOs are not shared among GL contexts
+static uint32_t     g_VaoBufferGeneration = 0;  // g_StreamBuffer generation the cached VAO points to
+
+// What we upload per vertex: ImDrawVert plus the clip rect of its command, in framebuffer pixels with a bottom-left
+// origin (x0, y0, x1, y1). The fragment shader clips with it, so commands with different clip rects can share a draw.
+struct ImGui_ImplSdlGL3_Vert
+{
+    ImVec2  pos;
+    ImVec2  uv;
+    ImU32   col;
+    ImVec4  clip;
+};
+
+// Consecutive commands sharing a texture, drawn with a single glMultiDrawElementsBaseVertex. Each draw list in the
+// batch is one sub-draw, as its indices are relative to its own first vertex.
+struct ImGui_ImplSdlGL3_Batch
+{
+    GLuint              Texture;
+    int                 LastList;   // Draw list of the last sub-draw
+    ImVector<GLsizei>   Counts;
+    ImVector<void*>     Offsets;    // In bytes, from the start of the buffer
+    ImVector<GLint>     BaseVertices;
+};
+
+static ImVector<ImVec4>             g_VtxClips;     // Clip rect of each vertex of the list being uploaded
+static ImGui_ImplSdlGL3_Batch       g_Batch;
+
+// Points the attributes of 'vao_handle' to our buffers. The element buffer binding is part of the VAO state too.
+static void ImGui_ImplSdlGL3_SetupVertexArray(GLuint vao_handle)
+{
+    renoir::graphics::GLStateCache* gl_state = renoir::graphics::GetGLStateCache();
+    gl_state->BindVertexArray(vao_handle);
+    gl_state->BindBuffer(GL_ARRAY_BUFFER, g_StreamBuffer.buffer());
+    gl_state->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_StreamBuffer.buffer());
+    glEnableVertexAttribArray(g_AttribLocationPosition);
+    glEnableVertexAttribArray(g_AttribLocationUV);
+    glEnableVertexAttribArray(g_AttribLocationColor);
+    glEnableVertexAttribArray(g_AttribLocationClip);
+    glVertexAttribPointer(g_AttribLocationPosition, 2, GL_FLOAT, GL_FALSE, sizeof(ImGui_ImplSdlGL3_Vert), (GLvoid*)IM_OFFSETOF(ImGui_ImplSdlGL3_Vert, pos));
+    glVertexAttribPointer(g_AttribLocationUV, 2, GL_FLOAT, GL_FALSE, sizeof(ImGui_ImplSdlGL3_Vert), (GLvoid*)IM_OFFSETOF(ImGui_ImplSdlGL3_Vert, uv));
+    glVertexAttribPointer(g_AttribLocationColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImGui_ImplSdlGL3_Vert), (GLvoid*)IM_OFFSETOF(ImGui_ImplSdlGL3_Vert, col));
+    glVertexAttribPointer(g_AttribLocationClip, 4, GL_FLOAT, GL_FALSE, sizeof(ImGui_ImplSdlGL3_Vert), (GLvoid*)IM_OFFSETOF(ImGui_ImplSdlGL3_Vert, clip));
+}
+
+// Issues the pending batch, if any. Returns the number of draw calls issued.
+static int ImGui_ImplSdlGL3_FlushBatch()
+{
+    ImGui_ImplSdlGL3_Batch& batch = g_Batch;
+    if (batch.Counts.Size == 0)
+        return 0;
+    renoir::graphics::GetGLStateCache()->BindTexture2D(batch.Texture);
+    GLenum idx_type = sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    if (batch.Counts.Size == 1)
+        glDrawElementsBaseVertex(GL_TRIANGLES, batch.Counts[0], idx_type, batch.Offsets[0], batch.BaseVertices[0]);
+    else
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, batch.Counts.Data, idx_type, batch.Offsets.Data, batch.Counts.Size, batch.BaseVertices.Data);
+    batch.Counts.resize(0);
+    batch.Offsets.resize(0);
+    batch.BaseVertices.resize(0);
+    return 1;
+}
 
 // This is the main rendering function that you have to implement and provide to ImGui (via setting up 'RenderDrawListsFn' in the ImGuiIO structure)
 // Note that this implementation is little overcomplicated because we are saving/setting up/restoring every OpenGL state explicitly, in order to be able to run within any OpenGL engine that doesn't do so. 
+// Every state change goes through renoir's GLStateCache, so saving and restoring are copies of its CPU shadow.
 // If text or lines are blurry when integrating ImGui in your engine: in your Render function, try translating your projection matrix by (0.5f,0.5f) or (0.375f,0.375f)
 void ImGui_ImplSdlGL3_RenderDrawData(ImDrawData* draw_data)
 {
+    RNR_MEMORY_TAG(renoir::utils::MEMORY_TAG_GL_STAGING);
+
     // Avoid rendering when minimized, scale coordinates for retina displays (screen coordinates != framebuffer coordinates)
     ImGuiIO& io = ImGui::GetIO();
     int fb_width = (int)(io.DisplaySize.x * io.DisplayFramebufferScale.x);
@@ -73,40 +148,77 @@ void ImGui_ImplSdlGL3_RenderDrawData(ImDrawData* draw_data)
         return;
     draw_data->ScaleClipRects(io.DisplayFramebufferScale);
 
-    // Backup GL state
-    GLenum last_active_texture; glGetIntegerv(GL_ACTIVE_TEXTURE, (GLint*)&last_active_texture);
-    glActiveTexture(GL_TEXTURE0);
-    GLint last_program; glGetIntegerv(GL_CURRENT_PROGRAM, &last_program);
-    GLint last_texture; glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
-    GLint last_sampler; glGetIntegerv(GL_SAMPLER_BINDING, &last_sampler);
-    GLint last_array_buffer; glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &last_array_buffer);
-    GLint last_element_array_buffer; glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &last_element_array_buffer);
-    GLint last_vertex_array; glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &last_vertex_array);
-    GLint last_polygon_mode[2]; glGetIntegerv(GL_POLYGON_MODE, last_polygon_mode);
-    GLint last_viewport[4]; glGetIntegerv(GL_VIEWPORT, last_viewport);
-    GLint last_scissor_box[4]; glGetIntegerv(GL_SCISSOR_BOX, last_scissor_box);
-    GLenum last_blend_src_rgb; glGetIntegerv(GL_BLEND_SRC_RGB, (GLint*)&last_blend_src_rgb);
-    GLenum last_blend_dst_rgb; glGetIntegerv(GL_BLEND_DST_RGB, (GLint*)&last_blend_dst_rgb);
-    GLenum last_blend_src_alpha; glGetIntegerv(GL_BLEND_SRC_ALPHA, (GLint*)&last_blend_src_alpha);
-    GLenum last_blend_dst_alpha; glGetIntegerv(GL_BLEND_DST_ALPHA, (GLint*)&last_blend_dst_alpha);
-    GLenum last_blend_equation_rgb; glGetIntegerv(GL_BLEND_EQUATION_RGB, (GLint*)&last_blend_equation_rgb);
-    GLenum last_blend_equation_alpha; glGetIntegerv(GL_BLEND_EQUATION_ALPHA, (GLint*)&last_blend_equation_alpha);
-    GLboolean last_enable_blend = glIsEnabled(GL_BLEND);
-    GLboolean last_enable_cull_face = glIsEnabled(GL_CULL_FACE);
-    GLboolean last_enable_depth_test = glIsEnabled(GL_DEPTH_TEST);
-    GLboolean last_enable_scissor_test = glIsEnabled(GL_SCISSOR_TEST);
-
-    // Setup render state: alpha-blending enabled, no face culling, no depth testing, scissor enabled, polygon fill
-    glEnable(GL_BLEND);
-    glBlendEquation(GL_FUNC_ADD);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_SCISSOR_TEST);
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    // Upload every draw list at once. The stream buffer only waits if the GPU is still reading this region from
+    // RNR_STREAM_BUFFER_FRAMES frames ago. The slack covers aligning the indices after the vertices.
+    size_t vtx_size = (size_t)draw_data->TotalVtxCount * sizeof(ImGui_ImplSdlGL3_Vert);
+    size_t idx_size = (size_t)draw_data->TotalIdxCount * sizeof(ImDrawIdx);
+    g_StreamBuffer.BeginFrame(vtx_size + idx_size + sizeof(ImGui_ImplSdlGL3_Vert));
+    size_t vtx_buffer_offset = 0, idx_buffer_offset = 0;
+    ImGui_ImplSdlGL3_Vert* vtx_dst = (ImGui_ImplSdlGL3_Vert*)g_StreamBuffer.Allocate(vtx_size, sizeof(ImGui_ImplSdlGL3_Vert), &vtx_buffer_offset);
+    ImDrawIdx* idx_dst = (ImDrawIdx*)g_StreamBuffer.Allocate(idx_size, sizeof(ImDrawIdx), &idx_buffer_offset);
+    if (!vtx_dst || !idx_dst)
+    {
+        g_StreamBuffer.EndFrame();
+        return;
+    }
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    {
+        const ImDrawList* cmd_list = draw_data->CmdLists[n];
+
+        // A vertex is only referenced by the command that added it, so it takes that command's clip rect. The same
+        // truncation as glScissor, so pixel centers land on the same side of the edges.
+        g_VtxClips.resize(cmd_list->VtxBuffer.Size);
+        const ImDrawIdx* idx_buffer = cmd_list->IdxBuffer.Data;
+        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
+        {
+            const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
+            if (!pcmd->UserCallback)
+            {
+                int x0 = (int)pcmd->ClipRect.x, y0 = (int)(fb_height - pcmd->ClipRect.w);
+                ImVec4 clip((float)x0, (float)y0, (float)(x0 + (int)(pcmd->ClipRect.z - pcmd->ClipRect.x)), (float)(y0 + (int)(pcmd->ClipRect.w - pcmd->ClipRect.y)));
+                for (unsigned int i = 0; i < pcmd->ElemCount; i++)
+                    g_VtxClips[idx_buffer[i]] = clip;
+            }
+            idx_buffer += pcmd->ElemCount;
+        }
+
+        // Written in order, as the mapping might be write-combined memory
+        const ImDrawVert* vtx_src = cmd_list->VtxBuffer.Data;
+        for (int i = 0; i < cmd_list->VtxBuffer.Size; i++)
+        {
+            vtx_dst[i].pos = vtx_src[i].pos;
+            vtx_dst[i].uv = vtx_src[i].uv;
+            vtx_dst[i].col = vtx_src[i].col;
+            vtx_dst[i].clip = g_VtxClips[i];
+        }
+        memcpy(idx_dst, cmd_list->IdxBuffer.Data, (size_t)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
+        vtx_dst += cmd_list->VtxBuffer.Size;
+        idx_dst += cmd_list->IdxBuffer.Size;
+    }
+    // Without persistent mapping the region has to be unmapped before drawing from it
+    g_StreamBuffer.FinishWrites();
+
+    // Backup GL state. The cache already shadows it, so no need to query GL. It only knows about the context that
+    // created the device objects though, so for any other we query it like before.
+    renoir::graphics::GLStateCache* gl_state = renoir::graphics::GetGLStateCache();
+    bool foreign_context = g_VaoContext != SDL_GL_GetCurrentContext();
+    if (foreign_context)
+        gl_state->Sync();
+    const renoir::graphics::GLState last_state = gl_state->state();
+
+    // Setup render state: alpha-blending enabled, no face culling, no depth testing, polygon fill. No scissor either,
+    // the shader clips each vertex against its command's clip rect.
+    gl_state->ActiveTexture(GL_TEXTURE0);
+    gl_state->SetEnabled(GL_BLEND, true);
+    gl_state->BlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
+    gl_state->BlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl_state->SetEnabled(GL_CULL_FACE, false);
+    gl_state->SetEnabled(GL_DEPTH_TEST, false);
+    gl_state->SetEnabled(GL_SCISSOR_TEST, false);
+    gl_state->PolygonMode(GL_FILL);
 
     // Setup viewport, orthographic projection matrix
-    glViewport(0, 0, (GLsizei)fb_width, (GLsizei)fb_height);
+    gl_state->Viewport(0, 0, (GLsizei)fb_width, (GLsizei)fb_height);
     const float ortho_projection[4][4] =
     {
         { 2.0f/io.DisplaySize.x, 0.0f,                   0.0f, 0.0f },
@@ -114,71 +226,84 @@ void ImGui_ImplSdlGL3_RenderDrawData(ImDrawData* draw_data)
         { 0.0f,                  0.0f,                  -1.0f, 0.0f },
         {-1.0f,                  1.0f,                   0.0f, 1.0f },
     };
-    glUseProgram(g_ShaderHandle);
+    gl_state->UseProgram(g_ShaderHandle);
     glUniform1i(g_AttribLocationTex, 0);
     glUniformMatrix4fv(g_AttribLocationProjMtx, 1, GL_FALSE, &ortho_projection[0][0]);
-    glBindSampler(0, 0); // Rely on combined texture/sampler state.
-
-    // Recreate the VAO every time 
-    // (This is to easily allow multiple GL contexts. VAO are not shared among GL contexts, and we don't track creation/deletion of windows so we don't have an obvious key to use to cache them.)
-    GLuint vao_handle = 0;
-    glGenVertexArrays(1, &vao_handle);
-    glBindVertexArray(vao_handle);
-    glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
-    glEnableVertexAttribArray(g_AttribLocationPosition);
-    glEnableVertexAttribArray(g_AttribLocationUV);
-    glEnableVertexAttribArray(g_AttribLocationColor);
-    glVertexAttribPointer(g_AttribLocationPosition, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, pos));
-    glVertexAttribPointer(g_AttribLocationUV, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, uv));
-    glVertexAttribPointer(g_AttribLocationColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, col));
+    gl_state->BindSampler(0, 0); // Rely on combined texture/sampler state.
 
-    // Draw
+    // Use the cached VAO. VAOs are not shared among GL contexts, so if we are called from a different context than
+    // the one that created the device objects we fall back to a temporary one.
+    GLuint vao_handle = g_VaoHandle;
+    if (foreign_context)
+    {
+        glGenVertexArrays(1, &vao_handle);
+        ImGui_ImplSdlGL3_SetupVertexArray(vao_handle);
+    }
+    else if (g_VaoBufferGeneration != g_StreamBuffer.generation())
+    {
+        // The stream buffer grew into a new buffer
+        ImGui_ImplSdlGL3_SetupVertexArray(vao_handle);
+        g_VaoBufferGeneration = g_StreamBuffer.generation();
+    }
+    gl_state->BindVertexArray(vao_handle);
+
+    // Draw. Each list's indices are relative to its first vertex, which the base vertex points at. Commands are
+    // merged in submission order, as reordering them would break overlapping windows.
+    int cmd_count = 0, draw_count = 0;
+    GLint base_vertex = (GLint)(vtx_buffer_offset / sizeof(ImGui_ImplSdlGL3_Vert));
     for (int n = 0; n < draw_data->CmdListsCount; n++)
     {
         const ImDrawList* cmd_list = draw_data->CmdLists[n];
-        const ImDrawIdx* idx_buffer_offset = 0;
-
-        glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
-        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
 
         for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
         {
             const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
             if (pcmd->UserCallback)
             {
+                draw_count += ImGui_ImplSdlGL3_FlushBatch();
                 pcmd->UserCallback(cmd_list, pcmd);
+                // The callback might have changed anything behind the cache's back
+                gl_state->Invalidate();
             }
-            else
+            else if (pcmd->ElemCount > 0)
             {
-                glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->TextureId);
-                glScissor((int)pcmd->ClipRect.x, (int)(fb_height - pcmd->ClipRect.w), (int)(pcmd->ClipRect.z - pcmd->ClipRect.x), (int)(pcmd->ClipRect.w - pcmd->ClipRect.y));
-                glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx_buffer_offset);
+                ImGui_ImplSdlGL3_Batch& batch = g_Batch;
+                GLuint texture = (GLuint)(intptr_t)pcmd->TextureId;
+                if (batch.Counts.Size > 0 && batch.Texture != texture)
+                    draw_count += ImGui_ImplSdlGL3_FlushBatch();
+                batch.Texture = texture;
+
+                // Commands of the same list are contiguous in the index buffer, so they extend the last sub-draw
+                if (batch.Counts.Size > 0 && batch.LastList == n)
+                {
+                    batch.Counts.back() += (GLsizei)pcmd->ElemCount;
+                }
+                else
+                {
+                    batch.Counts.push_back((GLsizei)pcmd->ElemCount);
+                    batch.Offsets.push_back((void*)idx_buffer_offset);
+                    batch.BaseVertices.push_back(base_vertex);
+                    batch.LastList = n;
+                }
+                cmd_count++;
             }
-            idx_buffer_offset += pcmd->ElemCount;
+            idx_buffer_offset += pcmd->ElemCount * sizeof(ImDrawIdx);
         }
+        base_vertex += cmd_list->VtxBuffer.Size;
+    }
+    draw_count += ImGui_ImplSdlGL3_FlushBatch();
+    gl_state->CountDraws(draw_count, cmd_count);
+    g_StreamBuffer.EndFrame();
+    if (vao_handle != g_VaoHandle)
+    {
+        gl_state->BindVertexArray(0);
+        glDeleteVertexArrays(1, &vao_handle);
     }
-    glDeleteVertexArrays(1, &vao_handle);
 
-    // Restore modified GL state
-    glUseProgram(last_program);
-    glBindTexture(GL_TEXTURE_2D, last_texture);
-    glBindSampler(0, last_sampler);
-    glActiveTexture(last_active_texture);
-    glBindVertexArray(last_vertex_array);
-    glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, last_element_array_buffer);
-    glBlendEquationSeparate(last_blend_equation_rgb, last_blend_equation_alpha);
-    glBlendFuncSeparate(last_blend_src_rgb, last_blend_dst_rgb, last_blend_src_alpha, last_blend_dst_alpha);
-    if (last_enable_blend) glEnable(GL_BLEND); else glDisable(GL_BLEND);
-    if (last_enable_cull_face) glEnable(GL_CULL_FACE); else glDisable(GL_CULL_FACE);
-    if (last_enable_depth_test) glEnable(GL_DEPTH_TEST); else glDisable(GL_DEPTH_TEST);
-    if (last_enable_scissor_test) glEnable(GL_SCISSOR_TEST); else glDisable(GL_SCISSOR_TEST);
-    glPolygonMode(GL_FRONT_AND_BACK, (GLenum)last_polygon_mode[0]);
-    glViewport(last_viewport[0], last_viewport[1], (GLsizei)last_viewport[2], (GLsizei)last_viewport[3]);
-    glScissor(last_scissor_box[0], last_scissor_box[1], (GLsizei)last_scissor_box[2], (GLsizei)last_scissor_box[3]);
+    // Restore modified GL state. Only what actually changed reaches GL.
+    gl_state->Restore(last_state);
+    if (foreign_context)
+        gl_state->Invalidate();
 }
 
 static const char* ImGui_ImplSdlGL3_GetClipboardText(void*)
@@ -245,10 +370,11 @@ void ImGui_ImplSdlGL3_CreateFontsTexture()
     io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);   // Load as RGBA 32-bits for OpenGL3 demo because it is more likely to be compatible with user's existing shader.
 
     // Upload texture to graphics system
-    GLint last_texture;
-    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
+    renoir::graphics::GLStateCache* gl_state = renoir::graphics::GetGLStateCache();
+    GLuint last_texture = gl_state->state().textures_2d[0];
+    gl_state->ActiveTexture(GL_TEXTURE0);
     glGenTextures(1, &g_FontTexture);
-    glBindTexture(GL_TEXTURE_2D, g_FontTexture);
+    gl_state->BindTexture2D(g_FontTexture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
@@ -258,28 +384,32 @@ void ImGui_ImplSdlGL3_CreateFontsTexture()
     io.Fonts->TexID = (void *)(intptr_t)g_FontTexture;
 
     // Restore state
-    glBindTexture(GL_TEXTURE_2D, last_texture);
+    if (last_texture != RNR_GL_STATE_UNKNOWN)
+        gl_state->BindTexture2D(last_texture);
 }
 
 bool ImGui_ImplSdlGL3_CreateDeviceObjects()
 {
-    // Backup GL state
-    GLint last_texture, last_array_buffer, last_vertex_array;
-    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
-    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &last_array_buffer);
-    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &last_vertex_array);
+    // The cache starts knowing nothing, and the user might have changed the state since we last looked. This is the only
+    // time we query it: from here on every change goes through the cache.
+    renoir::graphics::GLStateCache* gl_state = renoir::graphics::GetGLStateCache();
+    gl_state->Sync();
+    const renoir::graphics::GLState last_state = gl_state->state();
 
     const GLchar *vertex_shader =
         "uniform mat4 ProjMtx;\n"
         "in vec2 Position;\n"
         "in vec2 UV;\n"
         "in vec4 Color;\n"
+        "in vec4 Clip;\n"
         "out vec2 Frag_UV;\n"
         "out vec4 Frag_Color;\n"
+        "flat out vec4 Frag_Clip;\n"
         "void main()\n"
         "{\n"
         "	Frag_UV = UV;\n"
         "	Frag_Color = Color;\n"
+        "	Frag_Clip = Clip;\n"
         "	gl_Position = ProjMtx * vec4(Position.xy,0,1);\n"
         "}\n";
 
@@ -287,9 +417,12 @@ bool ImGui_ImplSdlGL3_CreateDeviceObjects()
         "uniform sampler2D Texture;\n"
         "in vec2 Frag_UV;\n"
         "in vec4 Frag_Color;\n"
+        "flat in vec4 Frag_Clip;\n"
         "out vec4 Out_Color;\n"
         "void main()\n"
         "{\n"
+        "	if (any(lessThan(gl_FragCoord.xy, Frag_Clip.xy)) || any(greaterThanEqual(gl_FragCoord.xy, Frag_Clip.zw)))\n"
+        "		discard;\n"
         "	Out_Color = Frag_Color * texture( Texture, Frag_UV.st);\n"
         "}\n";
 
@@ -312,25 +445,36 @@ bool ImGui_ImplSdlGL3_CreateDeviceObjects()
     g_AttribLocationPosition = glGetAttribLocation(g_ShaderHandle, "Position");
     g_AttribLocationUV = glGetAttribLocation(g_ShaderHandle, "UV");
     g_AttribLocationColor = glGetAttribLocation(g_ShaderHandle, "Color");
+    g_AttribLocationClip = glGetAttribLocation(g_ShaderHandle, "Clip");
 
-    glGenBuffers(1, &g_VboHandle);
-    glGenBuffers(1, &g_ElementsHandle);
+    if (!renoir::utils::IsStatusOk(g_StreamBuffer.Init()))
+        return false;
+
+    // The attribute layout never changes, so the VAO is set up once and lives as long as the rest of objects
+    glGenVertexArrays(1, &g_VaoHandle);
+    ImGui_ImplSdlGL3_SetupVertexArray(g_VaoHandle);
+    g_VaoContext = SDL_GL_GetCurrentContext();
+    g_VaoBufferGeneration = g_StreamBuffer.generation();
 
     ImGui_ImplSdlGL3_CreateFontsTexture();
 
     // Restore modified GL state
-    glBindTexture(GL_TEXTURE_2D, last_texture);
-    glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
-    glBindVertexArray(last_vertex_array);
+    gl_state->Restore(last_state);
 
     return true;
 }
 
 void    ImGui_ImplSdlGL3_InvalidateDeviceObjects()
 {
-    if (g_VboHandle) glDeleteBuffers(1, &g_VboHandle);
-    if (g_ElementsHandle) glDeleteBuffers(1, &g_ElementsHandle);
-    g_VboHandle = g_ElementsHandle = 0;
+    if (g_VaoHandle) glDeleteVertexArrays(1, &g_VaoHandle);
+    g_VaoHandle = 0;
+    g_VaoContext = NULL;
+
+    g_StreamBuffer.Shutdown();
+    g_VtxClips.clear();
+    g_Batch.Counts.clear();
+    g_Batch.Offsets.clear();
+    g_Batch.BaseVertices.clear();
 
     if (g_ShaderHandle && g_VertHandle) glDetachShader(g_ShaderHandle, g_VertHandle);
     if (g_VertHandle) glDeleteShader(g_VertHandle);
@@ -391,6 +535,13 @@ bool    ImGui_ImplSdlGL3_Init(SDL_Window* window, const char* glsl_version)
     io.GetClipboardTextFn = ImGui_ImplSdlGL3_GetClipboardText;
     io.ClipboardUserData = NULL;
 
+    // Headless (no window): no cursors, and the SDL video subsystem might not even be initialized
+    if (window == NULL)
+    {
+        io.BackendFlags &= ~ImGuiBackendFlags_HasMouseCursors;
+        return true;
+    }
+
     g_MouseCursors[ImGuiMouseCursor_Arrow] = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_ARROW);
     g_MouseCursors[ImGuiMouseCursor_TextInput] = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_IBEAM);
     g_MouseCursors[ImGuiMouseCursor_ResizeAll] = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_SIZEALL);
@@ -404,8 +555,6 @@ bool    ImGui_ImplSdlGL3_Init(SDL_Window* window, const char* glsl_version)
     SDL_VERSION(&wmInfo.version);
     SDL_GetWindowWMInfo(window, &wmInfo);
     io.ImeWindowHandle = wmInfo.info.win.window;
-#else
-    (void)window;
 #endif
 
     return true;
@@ -415,7 +564,8 @@ void ImGui_ImplSdlGL3_Shutdown()
 {
     // Destroy SDL mouse cursors
     for (ImGuiMouseCursor cursor_n = 0; cursor_n < ImGuiMouseCursor_COUNT; cursor_n++)
-        SDL_FreeCursor(g_MouseCursors[cursor_n]);
+        if (g_MouseCursors[cursor_n])
+            SDL_FreeCursor(g_MouseCursors[cursor_n]);
     memset(g_MouseCursors, 0, sizeof(g_MouseCursors));
 
     // Destroy OpenGL objects
@@ -429,6 +579,20 @@ void ImGui_ImplSdlGL3_NewFrame(SDL_Window* window)
 
     ImGuiIO& io = ImGui::GetIO();
 
+    // Setup time step (we don't use SDL_GetTicks() because it is using millisecond resolution)
+    static Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 current_time = SDL_GetPerformanceCounter();
+    io.DeltaTime = g_Time > 0 ? (float)((double)(current_time - g_Time) / frequency) : (float)(1.0f / 60.0f);
+    g_Time = current_time;
+
+    // Headless: display size and mouse come from the caller
+    if (window == NULL)
+    {
+        io.DisplayFramebufferScale = ImVec2(1.0f, 1.0f);
+        ImGui::NewFrame();
+        return;
+    }
+
     // Setup display size (every frame to accommodate for window resizing)
     int w, h;
     int display_w, display_h;
@@ -437,12 +601,6 @@ void ImGui_ImplSdlGL3_NewFrame(SDL_Window* window)
     io.DisplaySize = ImVec2((float)w, (float)h);
     io.DisplayFramebufferScale = ImVec2(w > 0 ? ((float)display_w / w) : 0, h > 0 ? ((float)display_h / h) : 0);
 
-    // Setup time step (we don't use SDL_GetTicks() because it is using millisecond resolution)
-    static Uint64 frequency = SDL_GetPerformanceFrequency();
-    Uint64 current_time = SDL_GetPerformanceCounter();
-    io.DeltaTime = g_Time > 0 ? (float)((double)(current_time - g_Time) / frequency) : (float)(1.0f / 60.0f);
-    g_Time = current_time;
-
     // Setup mouse inputs (we already got mouse wheel, keyboard keys & characters from our event handler)
     int mx, my;
     Uint32 mouse_buttons = SDL_GetMouseState(&mx, &my);
@@ -15,6 +15,7 @@
 struct SDL_Window;
 typedef union SDL_Event SDL_Event;
 
+// A NULL window renders headless (eg. into an FBO): set io.DisplaySize and the mouse inputs yourself before NewFrame().
 IMGUI_API bool        ImGui_ImplSdlGL3_Init(SDL_Window* window, const char* glsl_version = NULL);
 IMGUI_API void        ImGui_ImplSdlGL3_Shutdown();
 IMGUI_API void        ImGui_ImplSdlGL3_NewFrame(SDL_Window* window);
@@ -0,0 +1,58 @@
+/******************************************************************************
+ * @file: dock.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-26
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * imguidock calls, with whatever they allocate (through ImGui) charged to
+ * MEMORY_TAG_DOCK. Only the calls themselves, what is drawn inside a dock is
+ * charged as usual.
+ ******************************************************************************/
+
+#ifndef SRC_EDITOR_DOCK_H
+#define SRC_EDITOR_DOCK_H
+
+#include <imgui/imgui.h>
+#include <external/imguidock.h>
+
+#include "utils/memory.h"
+
+namespace renoir {
+namespace editor {
+
+inline ImGui::DockContext *CreateDockContext() {
+  RNR_MEMORY_TAG(::renoir::utils::MEMORY_TAG_DOCK);
+  return ImGui::CreateDockContext();
+}
+
+inline void DestroyDockContext(ImGui::DockContext *context) {
+  RNR_MEMORY_TAG(::renoir::utils::MEMORY_TAG_DOCK);
+  ImGui::DestroyDockContext(context);
+}
+
+inline void BeginDockspace() {
+  RNR_MEMORY_TAG(::renoir::utils::MEMORY_TAG_DOCK);
+  ImGui::BeginDockspace();
+}
+
+inline void EndDockspace() {
+  RNR_MEMORY_TAG(::renoir::utils::MEMORY_TAG_DOCK);
+  ImGui::EndDockspace();
+}
+
+inline bool BeginDock(const char *label) {
+  RNR_MEMORY_TAG(::renoir::utils::MEMORY_TAG_DOCK);
+  return ImGui::BeginDock(label);
+}
+
+inline void EndDock() {
+  RNR_MEMORY_TAG(::renoir::utils::MEMORY_TAG_DOCK);
+  ImGui::EndDock();
+}
+
+}   // namespace editor
+}   // namespace renoir
+
+#endif  // SRC_EDITOR_DOCK_H
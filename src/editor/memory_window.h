@@ -0,0 +1,211 @@
+/******************************************************************************
+ * @file: memory_window.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-26
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Dock that shows where the memory goes: what every subsystem (memory tag)
+ * has live and how much it allocates per frame, the same per thread, and
+ * the state of the pools. The whole report can be dumped as JSON.
+ ******************************************************************************/
+
+#ifndef SRC_EDITOR_MEMORY_WINDOW_H
+#define SRC_EDITOR_MEMORY_WINDOW_H
+
+#include <mutex>
+
+#include <imgui/imgui.h>
+
+#include "editor/dock.h"
+#include "logging/log.h"
+#include "utils/memory.h"
+#include "utils/scope_trigger.h"
+
+#define RNR_MEMORY_WINDOW_REPORT_PATH "renoir_memory.json"
+
+namespace renoir {
+namespace editor {
+
+namespace internal {
+
+using ::renoir::logging::GlobalLogContext;
+using ::renoir::logging::ThreadLocalLogContext;
+using ::renoir::utils::FrameAllocate;
+using ::renoir::utils::FrameFormattedString;
+using ::renoir::utils::MemoryStats;
+using ::renoir::utils::MemoryTag;
+using ::renoir::utils::MemoryTagStats;
+using ::renoir::utils::PoolClassStats;
+using ::renoir::utils::ThreadMemoryUsage;
+using ::renoir::utils::MEMORY_TAG_COUNT;
+
+struct MemoryWindowState {
+  bool only_used_tags = true;
+  // Of the last dump
+  bool dumped = false;
+  ::renoir::utils::Status dump_status;
+};
+
+inline double ToKilobytes(int64_t bytes) {
+  return (double)bytes / 1024.0;
+}
+
+inline bool IsMemoryTagUsed(const MemoryTagStats& stats) {
+  return stats.heap_allocations + stats.pool_allocations + stats.frees > 0 ||
+         stats.external_bytes != 0;
+}
+
+inline void DrawMemoryTags(const MemoryWindowState& state) {
+  MemoryTagStats tags[MEMORY_TAG_COUNT];
+  ::renoir::utils::GetMemoryTagStats(tags);
+
+  ImGui::Columns(8, "memory_tags");
+  const char *headers[] = {"Tag", "Heap KB", "Pooled KB", "External KB", "Peak KB",
+                           "Allocs/frame", "Allocs", "Frees"};
+  for (const char *header : headers) {
+    ImGui::TextUnformatted(header);
+    ImGui::NextColumn();
+  }
+  ImGui::Separator();
+  for (size_t tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+    const MemoryTagStats& stats = tags[tag];
+    if (state.only_used_tags && !IsMemoryTagUsed(stats)) {
+      continue;
+    }
+    ImGui::TextUnformatted(::renoir::utils::GetMemoryTagName((MemoryTag)tag));
+    ImGui::NextColumn();
+    ImGui::Text("%.1f", ToKilobytes(stats.live_heap_bytes));
+    ImGui::NextColumn();
+    ImGui::Text("%.1f", ToKilobytes(stats.live_pooled_bytes));
+    ImGui::NextColumn();
+    ImGui::Text("%.1f", ToKilobytes(stats.external_bytes));
+    ImGui::NextColumn();
+    ImGui::Text("%.1f", ToKilobytes(stats.peak_bytes));
+    ImGui::NextColumn();
+    if (stats.last_frame_allocations > 0) {
+      ImGui::TextColored({1.0f, 0.4f, 0.4f, 1.0f}, "%llu",
+                         (unsigned long long)stats.last_frame_allocations);
+    } else {
+      ImGui::TextUnformatted("0");
+    }
+    ImGui::NextColumn();
+    ImGui::Text("%llu", (unsigned long long)(stats.heap_allocations + stats.pool_allocations));
+    ImGui::NextColumn();
+    ImGui::Text("%llu", (unsigned long long)stats.frees);
+    ImGui::NextColumn();
+  }
+  ImGui::Columns(1);
+}
+
+// Name of the thread from its log context, if it ever logged
+inline const char *GetMemoryThreadName(size_t thread_uid) {
+  if (thread_uid == 0) {
+    return "<no context>";
+  }
+  GlobalLogContext *global_context = ::renoir::logging::GetGlobalLogContext();
+  std::lock_guard<std::mutex> guard(global_context->mutex);
+  auto it = global_context->log_contexts.find(thread_uid);
+  if (it == global_context->log_contexts.end()) {
+    return "";
+  }
+  // Copied, the name can change once the mutex is released
+  const ThreadLocalLogContext *context = it->second;
+  if (!context->alive.load(std::memory_order_acquire)) {
+    return FrameFormattedString("%s (exited)", context->thread_name());
+  }
+  return FrameFormattedString("%s", context->thread_name());
+}
+
+// Live bytes of every thread, by tag. Frees from other threads are
+// subtracted where they happen, so a thread can go negative.
+inline void DrawThreadMemory() {
+  size_t max_count = ::renoir::utils::GetTrackedThreadCount();
+  ThreadMemoryUsage *threads =
+      (ThreadMemoryUsage*)FrameAllocate(max_count * sizeof(ThreadMemoryUsage));
+  if (!threads) {
+    return;
+  }
+  size_t count = ::renoir::utils::GetThreadMemoryUsage(threads, max_count);
+  for (size_t i = 0; i < count; i++) {
+    const ThreadMemoryUsage& usage = threads[i];
+    const char *label = FrameFormattedString("Thread %zu: %s##memory_thread_%zu",
+                                             usage.thread_uid,
+                                             GetMemoryThreadName(usage.thread_uid), i);
+    if (!ImGui::TreeNode(label)) {
+      continue;
+    }
+    for (size_t tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+      const MemoryTagStats& stats = usage.tags[tag];
+      if (!IsMemoryTagUsed(stats)) {
+        continue;
+      }
+      ImGui::Text("%-10s %10.1f KB live | %llu allocs, %llu frees",
+                  ::renoir::utils::GetMemoryTagName((MemoryTag)tag),
+                  ToKilobytes(stats.live_heap_bytes + stats.live_pooled_bytes +
+                              stats.external_bytes),
+                  (unsigned long long)(stats.heap_allocations + stats.pool_allocations),
+                  (unsigned long long)stats.frees);
+    }
+    ImGui::TreePop();
+  }
+}
+
+inline void DrawMemoryPools() {
+  MemoryStats stats = ::renoir::utils::GetMemoryStats();
+  for (const PoolClassStats& pool : stats.pools) {
+    float used = pool.block_count > 0 ? (float)pool.blocks_in_use / (float)pool.block_count : 0;
+    ImGui::ProgressBar(used, {150, 0},
+                       FrameFormattedString("%zu / %zu", pool.blocks_in_use, pool.block_count));
+    ImGui::SameLine();
+    ImGui::Text("%zu bytes", pool.block_size);
+  }
+  ImGui::Text("Large blocks: %zu live", stats.large_allocations);
+  ImGui::Text("Frame arena: %.1f / %.1f KB, peak %.1f KB, %llu overflows",
+              (double)stats.frame_arena_used / 1024.0, (double)stats.frame_arena_capacity / 1024.0,
+              (double)stats.frame_arena_peak / 1024.0,
+              (unsigned long long)stats.frame_arena_overflows);
+}
+
+}   // namespace internal
+
+// Main thread, within a dockspace
+inline void MemoryDock() {
+  static internal::MemoryWindowState state;
+  if (!BeginDock("Memory")) {
+    EndDock();
+    return;
+  }
+  SCOPED_TRIGGER((void)0, EndDock());
+
+  ImGui::Checkbox("Only used tags", &state.only_used_tags);
+  ImGui::SameLine();
+  if (ImGui::Button("Dump JSON")) {
+    state.dump_status = ::renoir::utils::WriteMemoryReport(RNR_MEMORY_WINDOW_REPORT_PATH);
+    state.dumped = true;
+  }
+  if (state.dumped) {
+    ImGui::SameLine();
+    if (::renoir::utils::IsStatusOk(state.dump_status)) {
+      ImGui::Text("Written to %s", RNR_MEMORY_WINDOW_REPORT_PATH);
+    } else {
+      ImGui::TextColored({1.0f, 0.4f, 0.4f, 1.0f}, "%s", state.dump_status.context.msg.c_str());
+    }
+  }
+
+  if (ImGui::CollapsingHeader("Tags", ImGuiTreeNodeFlags_DefaultOpen)) {
+    internal::DrawMemoryTags(state);
+  }
+  if (ImGui::CollapsingHeader("Threads")) {
+    internal::DrawThreadMemory();
+  }
+  if (ImGui::CollapsingHeader("Pools")) {
+    internal::DrawMemoryPools();
+  }
+}
+
+}   // namespace editor
+}   // namespace renoir
+
+#endif  // SRC_EDITOR_MEMORY_WINDOW_H
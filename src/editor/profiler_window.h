@@ -0,0 +1,547 @@
+/******************************************************************************
+ * @file: profiler_window.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-19
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Dock that shows the profiled frames: a timeline of the last frames with a
+ * row per thread, the flame graph of the selected frame and the stats of
+ * every zone. It draws from a snapshot that is refreshed a few times per
+ * second (or never, while paused), so looking at the frames doesn't change
+ * them.
+ ******************************************************************************/
+
+#ifndef SRC_EDITOR_PROFILER_WINDOW_H
+#define SRC_EDITOR_PROFILER_WINDOW_H
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <imgui/imgui.h>
+#include <external/imguidock.h>
+
+#include "editor/dock.h"
+#include "graphics/gl_state.h"
+#include "platform/clock.h"
+#include "platform/frame_pacer.h"
+#include "platform/frame_scheduler.h"
+#include "profiling/gpu_profiler.h"
+#include "profiling/profile_snapshot.h"
+#include "profiling/trace_export.h"
+#include "utils/memory.h"
+#include "utils/scope_trigger.h"
+
+// How often the profiler window copies the frames
+#define RNR_PROFILER_WINDOW_REFRESH_MS 250
+
+namespace renoir {
+namespace editor {
+
+namespace internal {
+
+using ::renoir::profiling::GpuFrame;
+using ::renoir::profiling::GpuZone;
+using ::renoir::profiling::ProfileFrame;
+using ::renoir::profiling::ProfileSnapshot;
+using ::renoir::profiling::ProfileThreadInfo;
+using ::renoir::profiling::ProfileZone;
+using ::renoir::profiling::ProfileZoneStats;
+
+struct ProfilerWindowState {
+  ProfileSnapshot snapshot;
+  std::vector<ProfileZoneStats> stats;
+  // Resolved GPU frames, oldest first
+  std::vector<GpuFrame> gpu_frames;
+  uint64_t snapshot_ticks = 0;
+  bool paused = false;
+  // Frames shown by the timeline (the stats use the whole snapshot)
+  int timeline_frames = 10;
+  // ProfileFrame::index of the frame in the flame graph. Kept by index so it
+  // survives refreshing the snapshot.
+  uint64_t selected_frame = 0;
+  bool has_selection = false;
+  size_t flame_thread_uid = 0;
+};
+
+// Same name, same color, wherever it comes from
+inline ImU32 GetZoneColor(const char *name) {
+  uint32_t hash = 2166136261u;
+  for (const char *c = name; *c; c++) {
+    hash = (hash ^ (uint8_t)*c) * 16777619u;
+  }
+  return ImColor::HSV((float)(hash % 360) / 360.0f, 0.55f, 0.75f);
+}
+
+struct ZoneCanvas {
+  ImDrawList *draw_list;
+  ImVec2 origin;
+  float width;
+  float lane_height;
+  uint64_t begin;
+  uint64_t end;
+  // Set to the zone under the mouse, if any
+  const ProfileZone *hovered;
+
+ public:
+  float GetX(uint64_t ticks) const {
+    if (ticks <= begin) {
+      return origin.x;
+    }
+    return origin.x + (float)((double)(ticks - begin) / (double)(end - begin) * width);
+  }
+};
+
+// Draws |zone| at |y|, with its name if it fits
+inline void DrawZone(ZoneCanvas *canvas, const ProfileZone& zone, float y) {
+  float x0 = canvas->GetX(zone.begin);
+  float x1 = canvas->GetX(zone.end);
+  // Zones shorter than a pixel still show up
+  if (x1 - x0 < 1.0f) {
+    x1 = x0 + 1.0f;
+  }
+  ImVec2 min(x0, y);
+  ImVec2 max(x1, y + canvas->lane_height - 1.0f);
+  canvas->draw_list->AddRectFilled(min, max, GetZoneColor(zone.name));
+
+  if (x1 - x0 > 8.0f) {
+    ImVec4 clip(x0, y, x1 - 2.0f, max.y);
+    canvas->draw_list->AddText(ImGui::GetFont(), ImGui::GetFontSize(), {x0 + 2.0f, y},
+                               IM_COL32(0, 0, 0, 255), zone.name, nullptr, 0.0f, &clip);
+  }
+
+  if (ImGui::IsMouseHoveringRect(min, max)) {
+    canvas->hovered = &zone;
+  }
+}
+
+inline void ShowZoneTooltip(const ProfileZone& zone, const ProfileSnapshot& snapshot) {
+  const ProfileThreadInfo *thread = snapshot.GetThread(zone.thread_uid);
+  ImGui::SetTooltip("%s\n%.3f ms\nThread %zu: %s", zone.name,
+                    ::renoir::platform::TicksToMilliseconds(zone.end - zone.begin),
+                    zone.thread_uid, thread ? thread->name.c_str() : "<unknown>");
+}
+
+inline const ProfileFrame *FindSnapshotFrame(const ProfileSnapshot& snapshot, uint64_t index) {
+  for (const ProfileFrame& frame : snapshot.frames) {
+    if (frame.index == index) {
+      return &frame;
+    }
+  }
+  return nullptr;
+}
+
+// A row per thread, each as tall as its deepest zone in the shown frames.
+// Clicking a frame selects it for the flame graph.
+inline void DrawProfileTimeline(ProfilerWindowState *state) {
+  const ProfileSnapshot& snapshot = state->snapshot;
+  size_t frame_count = std::min((size_t)state->timeline_frames, snapshot.frames.size());
+  if (frame_count == 0) {
+    ImGui::TextUnformatted("No frames yet");
+    return;
+  }
+  size_t first_frame = snapshot.frames.size() - frame_count;
+
+  // Row layout, in UID order
+  ::renoir::utils::FrameMap<size_t, uint32_t> lanes;
+  for (size_t i = first_frame; i < snapshot.frames.size(); i++) {
+    for (const ProfileZone& zone : snapshot.frames[i].zones) {
+      uint32_t& depth = lanes[zone.thread_uid];
+      depth = std::max(depth, zone.depth + 1);
+    }
+  }
+
+  const float label_width = 160.0f;
+  const float lane_height = ImGui::GetTextLineHeight();
+  ::renoir::utils::FrameMap<size_t, float> row_offsets;
+  float height = 0;
+  for (auto& it : lanes) {
+    row_offsets[it.first] = height;
+    height += it.second * lane_height + 4.0f;
+  }
+
+  ImVec2 start = ImGui::GetCursorScreenPos();
+  float width = std::max(ImGui::GetContentRegionAvailWidth() - label_width, 50.0f);
+  ImGui::InvisibleButton("##timeline", {label_width + width, height});
+  bool clicked = ImGui::IsItemClicked(0);
+
+  ZoneCanvas canvas;
+  canvas.draw_list = ImGui::GetWindowDrawList();
+  canvas.origin = {start.x + label_width, start.y};
+  canvas.width = width;
+  canvas.lane_height = lane_height;
+  canvas.begin = snapshot.frames[first_frame].begin;
+  canvas.end = std::max(snapshot.frames.back().end, canvas.begin + 1);
+  canvas.hovered = nullptr;
+
+  for (auto& it : row_offsets) {
+    const ProfileThreadInfo *thread = snapshot.GetThread(it.first);
+    const char *label = ::renoir::utils::FrameFormattedString(
+        "%zu: %s", it.first, thread ? thread->name.c_str() : "<unknown>");
+    ImVec4 clip(start.x, start.y + it.second, start.x + label_width - 4.0f,
+                start.y + it.second + lane_height);
+    canvas.draw_list->AddText(ImGui::GetFont(), ImGui::GetFontSize(), {start.x, start.y + it.second},
+                              ImGui::GetColorU32(ImGuiCol_Text), label, nullptr, 0.0f,
+                              &clip);
+  }
+
+  ImVec2 clip_min = canvas.origin;
+  ImVec2 clip_max(canvas.origin.x + width, canvas.origin.y + height);
+  canvas.draw_list->PushClipRect(clip_min, clip_max, true);
+  float mouse_x = ImGui::GetIO().MousePos.x;
+  for (size_t i = first_frame; i < snapshot.frames.size(); i++) {
+    const ProfileFrame& frame = snapshot.frames[i];
+    float x0 = canvas.GetX(frame.begin);
+    float x1 = canvas.GetX(frame.end);
+    bool selected = state->has_selection && state->selected_frame == frame.index;
+    if (selected) {
+      canvas.draw_list->AddRectFilled({x0, clip_min.y}, {x1, clip_max.y},
+                                      IM_COL32(255, 255, 255, 30));
+    }
+    canvas.draw_list->AddLine({x0, clip_min.y}, {x0, clip_max.y}, IM_COL32(255, 255, 255, 80));
+
+    if (clicked && mouse_x >= x0 && mouse_x < x1) {
+      state->selected_frame = frame.index;
+      state->has_selection = true;
+    }
+
+    for (const ProfileZone& zone : frame.zones) {
+      DrawZone(&canvas, zone, start.y + row_offsets[zone.thread_uid] + zone.depth * lane_height);
+    }
+  }
+  canvas.draw_list->PopClipRect();
+
+  if (canvas.hovered) {
+    ShowZoneTooltip(*canvas.hovered, snapshot);
+  }
+}
+
+// The selected frame of a single thread, stretched to the whole width
+inline void DrawProfileFlameGraph(ProfilerWindowState *state) {
+  const ProfileSnapshot& snapshot = state->snapshot;
+  const ProfileFrame *frame = FindSnapshotFrame(snapshot, state->selected_frame);
+  if (!state->has_selection || !frame) {
+    ImGui::TextUnformatted("Click a frame in the timeline");
+    return;
+  }
+
+  // Only the threads that have zones in this frame
+  ::renoir::utils::FrameVector<const ProfileThreadInfo*> threads;
+  uint32_t depth = 0;
+  for (const ProfileThreadInfo& thread : snapshot.threads) {
+    for (const ProfileZone& zone : frame->zones) {
+      if (zone.thread_uid == thread.thread_uid) {
+        threads.push_back(&thread);
+        break;
+      }
+    }
+  }
+  if (threads.empty()) {
+    ImGui::Text("Frame %llu has no zones", (unsigned long long)frame->index);
+    return;
+  }
+
+  int current = 0;
+  for (size_t i = 0; i < threads.size(); i++) {
+    if (threads[i]->thread_uid == state->flame_thread_uid) {
+      current = (int)i;
+    }
+  }
+  ImGui::Text("Frame %llu: %.3f ms", (unsigned long long)frame->index,
+              ::renoir::platform::TicksToMilliseconds(frame->end - frame->begin));
+  ImGui::SameLine();
+  ImGui::PushItemWidth(200);
+  auto thread_getter = [](void *data, int index, const char **out) {
+    *out = (*(::renoir::utils::FrameVector<const ProfileThreadInfo*>*)data)[index]->name.c_str();
+    return true;
+  };
+  ImGui::Combo("##flame_thread", &current, thread_getter, &threads, (int)threads.size());
+  ImGui::PopItemWidth();
+  state->flame_thread_uid = threads[current]->thread_uid;
+
+  for (const ProfileZone& zone : frame->zones) {
+    if (zone.thread_uid == state->flame_thread_uid) {
+      depth = std::max(depth, zone.depth + 1);
+    }
+  }
+
+  ZoneCanvas canvas;
+  canvas.draw_list = ImGui::GetWindowDrawList();
+  canvas.origin = ImGui::GetCursorScreenPos();
+  canvas.width = std::max(ImGui::GetContentRegionAvailWidth(), 50.0f);
+  canvas.lane_height = ImGui::GetTextLineHeightWithSpacing();
+  canvas.begin = frame->begin;
+  canvas.end = std::max(frame->end, frame->begin + 1);
+  canvas.hovered = nullptr;
+  ImGui::InvisibleButton("##flame_graph", {canvas.width, depth * canvas.lane_height});
+
+  canvas.draw_list->PushClipRect(canvas.origin, {canvas.origin.x + canvas.width,
+                                                 canvas.origin.y + depth * canvas.lane_height},
+                                 true);
+  for (const ProfileZone& zone : frame->zones) {
+    if (zone.thread_uid == state->flame_thread_uid) {
+      DrawZone(&canvas, zone, canvas.origin.y + zone.depth * canvas.lane_height);
+    }
+  }
+  canvas.draw_list->PopClipRect();
+
+  if (canvas.hovered) {
+    ShowZoneTooltip(*canvas.hovered, snapshot);
+  }
+}
+
+// Passes of the last resolved GPU frame, plus their average over the copy
+inline void DrawGpuPasses(const ProfilerWindowState& state) {
+  if (state.gpu_frames.empty()) {
+    ImGui::TextUnformatted("No GPU frames (timer queries not supported?)");
+    return;
+  }
+  const GpuFrame& last = state.gpu_frames.back();
+  ImGui::Text("Frame %llu: %.3f ms on the GPU | %llu frames dropped",
+              (unsigned long long)last.index, last.duration_ms,
+              (unsigned long long)::renoir::profiling::GetGpuDroppedFrames());
+
+  ImGui::Columns(3, "gpu_passes");
+  ImGui::TextUnformatted("Pass");
+  ImGui::NextColumn();
+  ImGui::TextUnformatted("Last ms");
+  ImGui::NextColumn();
+  ImGui::TextUnformatted("Avg ms");
+  ImGui::NextColumn();
+  ImGui::Separator();
+  for (const GpuZone& zone : last.zones) {
+    double total_ms = 0;
+    size_t count = 0;
+    for (const GpuFrame& frame : state.gpu_frames) {
+      for (const GpuZone& other : frame.zones) {
+        if (other.name == zone.name || strcmp(other.name, zone.name) == 0) {
+          total_ms += other.duration_ms;
+          count++;
+        }
+      }
+    }
+    ImGui::Text("%*s%s", (int)zone.depth * 2, "", zone.name);
+    ImGui::NextColumn();
+    ImGui::Text("%.3f", zone.duration_ms);
+    ImGui::NextColumn();
+    ImGui::Text("%.3f", total_ms / (double)count);
+    ImGui::NextColumn();
+  }
+  ImGui::Columns(1);
+}
+
+// State changes and draws of the last rendered frame, and how many were saved
+inline void DrawGLStateCounters() {
+  const ::renoir::graphics::GLStateCounters& counters =
+      ::renoir::graphics::GetGLStateCache()->last_frame_counters();
+  uint64_t total = counters.issued + counters.filtered;
+  ImGui::Text("GL state: %llu calls issued | %llu filtered (%.1f%%) | %llu queries",
+              (unsigned long long)counters.issued, (unsigned long long)counters.filtered,
+              total ? 100.0 * (double)counters.filtered / (double)total : 0.0,
+              (unsigned long long)counters.queried);
+  ImGui::Text("Draws: %llu calls for %llu commands", (unsigned long long)counters.draws,
+              (unsigned long long)counters.draw_commands);
+}
+
+// Idle scheduling toggle, and whether idling actually gets us to the target
+inline void DrawFrameSchedulerStats() {
+  bool idle_enabled = ::renoir::platform::IsFrameSchedulerEnabled();
+  if (ImGui::Checkbox("Idle when untouched", &idle_enabled)) {
+    ::renoir::platform::SetFrameSchedulerEnabled(idle_enabled);
+  }
+  ::renoir::platform::FrameSchedulerStats stats = ::renoir::platform::GetFrameSchedulerStats();
+  ImGui::SameLine();
+  ImGui::Text("%.1f frames/s | %.0f%% idle | %llu wake ups |", stats.frames_per_second,
+              stats.idle_ratio * 100.0, (unsigned long long)stats.wake_ups);
+  ImGui::SameLine();
+  bool over_target = stats.cpu_percent > RNR_FRAME_SCHEDULER_IDLE_CPU_TARGET;
+  ImGui::TextColored(over_target ? ImVec4(1.0f, 0.4f, 0.4f, 1.0f) : ImVec4(0.4f, 1.0f, 0.4f, 1.0f),
+                     "CPU %.1f%% (idle target %.1f%%)", stats.cpu_percent,
+                     RNR_FRAME_SCHEDULER_IDLE_CPU_TARGET);
+}
+
+// Heap traffic of the last frame, which in steady state should be none
+inline void DrawFrameMemoryStats() {
+  ::renoir::utils::MemoryStats stats = ::renoir::utils::GetMemoryStats();
+  ImVec4 color = stats.last_frame_heap_allocations > 0 ? ImVec4(1.0f, 0.4f, 0.4f, 1.0f)
+                                                       : ImVec4(0.4f, 1.0f, 0.4f, 1.0f);
+  ImGui::TextColored(color, "Heap allocations: %llu last frame",
+                     (unsigned long long)stats.last_frame_heap_allocations);
+  ImGui::SameLine();
+  ImGui::Text("| %llu clean frames | frame arena %.1f / %.1f KB (%llu overflows)",
+              (unsigned long long)stats.clean_frames, (double)stats.frame_arena_used / 1024.0,
+              (double)stats.frame_arena_capacity / 1024.0,
+              (unsigned long long)stats.frame_arena_overflows);
+}
+
+// Pacing controls and the input latency they get
+inline void DrawFramePacing() {
+  using ::renoir::platform::SwapMode;
+  ::renoir::platform::FramePacerStats stats = ::renoir::platform::GetFramePacerStats();
+
+  const char *modes[] = {"Immediate", "Vsync", "Adaptive vsync"};
+  int mode = (int)stats.requested_mode;
+  ImGui::PushItemWidth(130);
+  if (ImGui::Combo("Swap", &mode, modes, IM_ARRAYSIZE(modes))) {
+    ::renoir::platform::SetSwapMode((SwapMode::InternalEnum)mode);
+  }
+  ImGui::SameLine();
+  float budget_ms = (float)::renoir::platform::GetFrameBudget();
+  if (ImGui::DragFloat("Budget ms", &budget_ms, 0.1f, 0.0f, 100.0f, "%.1f")) {
+    ::renoir::platform::SetFrameBudget(budget_ms);
+  }
+  ImGui::SameLine();
+  float margin_ms = (float)::renoir::platform::GetFramePacerMargin();
+  if (ImGui::DragFloat("Margin ms", &margin_ms, 0.05f, 0.0f, 20.0f, "%.2f")) {
+    ::renoir::platform::SetFramePacerMargin(margin_ms);
+  }
+  ImGui::PopItemWidth();
+  ImGui::SameLine();
+  bool late_sampling = ::renoir::platform::IsLateInputSampling();
+  if (ImGui::Checkbox("Late input", &late_sampling)) {
+    ::renoir::platform::SetLateInputSampling(late_sampling);
+  }
+
+  if (stats.active_mode != stats.requested_mode) {
+    ImGui::TextColored(ImVec4(1.0f, 0.8f, 0.3f, 1.0f), "Not supported, using %s",
+                       modes[(int)stats.active_mode]);
+  }
+  ImGui::Text("Period %.2f ms (refresh %.2f ms) | predicted work %.2f ms | %llu missed | "
+              "%llu dropped", stats.period_ms, stats.refresh_interval_ms,
+              stats.predicted_work_ms, (unsigned long long)stats.missed_frames,
+              (unsigned long long)stats.dropped_frames);
+
+  const ::renoir::platform::FramePacerLatency *last = ::renoir::platform::GetFramePacerLatency(0);
+  if (!last) {
+    ImGui::TextUnformatted("No frame measured yet");
+    return;
+  }
+  ImGui::Text("Input to present: %.2f ms avg | %.2f ms max (GPU end from %s)",
+              stats.avg_input_to_present_ms, stats.max_input_to_present_ms,
+              stats.gpu_timestamps ? "timestamps" : "fence polling");
+  ImGui::Text("Frame %llu: slept %.2f | input to submit %.2f | GPU done %.2f | present %.2f ms",
+              (unsigned long long)last->frame_index, last->sleep_ms, last->input_to_submit_ms,
+              last->input_to_gpu_ms, last->input_to_present_ms);
+
+  // Oldest first
+  float latencies[RNR_FRAME_PACER_HISTORY];
+  int count = 0;
+  while (count < RNR_FRAME_PACER_HISTORY &&
+         ::renoir::platform::GetFramePacerLatency((size_t)count)) {
+    count++;
+  }
+  for (int i = 0; i < count; i++) {
+    latencies[i] = (float)::renoir::platform::GetFramePacerLatency(
+        (size_t)(count - 1 - i))->input_to_present_ms;
+  }
+  ImGui::PlotLines("##input_latency", latencies, count, 0, "Input to present ms", 0.0f,
+                   (float)stats.max_input_to_present_ms * 1.2f, ImVec2(0, 60));
+}
+
+inline void DrawProfileZoneStats(const ProfilerWindowState& state) {
+  ImGui::Text("Zones over the last %zu frames", state.snapshot.frames.size());
+  ImGui::Columns(7, "zone_stats");
+  const char *headers[] = {"Zone", "Count", "Total ms", "Min ms", "Avg ms", "P99 ms", "Max ms"};
+  for (const char *header : headers) {
+    ImGui::TextUnformatted(header);
+    ImGui::NextColumn();
+  }
+  ImGui::Separator();
+  for (const ProfileZoneStats& stats : state.stats) {
+    ImGui::TextUnformatted(stats.name);
+    ImGui::NextColumn();
+    ImGui::Text("%zu", stats.count);
+    ImGui::NextColumn();
+    ImGui::Text("%.3f", stats.total_ms);
+    ImGui::NextColumn();
+    ImGui::Text("%.3f", stats.min_ms);
+    ImGui::NextColumn();
+    ImGui::Text("%.3f", stats.avg_ms);
+    ImGui::NextColumn();
+    ImGui::Text("%.3f", stats.p99_ms);
+    ImGui::NextColumn();
+    ImGui::Text("%.3f", stats.max_ms);
+    ImGui::NextColumn();
+  }
+  ImGui::Columns(1);
+}
+
+}   // namespace internal
+
+// Must be called from the thread that marks the frames, within a dockspace
+inline void ProfilerDock() {
+  static internal::ProfilerWindowState state;
+  if (!BeginDock("Profiler")) {
+    EndDock();
+    return;
+  }
+  SCOPED_TRIGGER((void)0, EndDock());
+  RNR_PROFILE_SCOPE("Profiler window");
+
+  uint64_t now = ::renoir::platform::GetTicks();
+  uint64_t refresh_ticks = ::renoir::platform::NanosecondsToTicks(
+      (uint64_t)RNR_PROFILER_WINDOW_REFRESH_MS * 1000000);
+  if (!state.paused && now - state.snapshot_ticks >= refresh_ticks) {
+    ::renoir::profiling::TakeProfileSnapshot(RNR_PROFILE_FRAME_COUNT, &state.snapshot);
+    ::renoir::profiling::ComputeProfileZoneStats(state.snapshot, &state.stats);
+    state.gpu_frames.clear();
+    for (size_t age = RNR_PROFILE_FRAME_COUNT; age > 0; age--) {
+      if (const internal::GpuFrame *frame = ::renoir::profiling::GetGpuFrame(age - 1)) {
+        state.gpu_frames.push_back(*frame);
+      }
+    }
+    state.snapshot_ticks = now;
+  }
+
+  ImGui::Checkbox("Pause", &state.paused);
+  ImGui::SameLine();
+  ImGui::PushItemWidth(200);
+  ImGui::SliderInt("Frames", &state.timeline_frames, 1, RNR_PROFILE_FRAME_COUNT);
+  ImGui::PopItemWidth();
+  ImGui::SameLine();
+  if (ImGui::Button("Capture trace (F12)")) {
+    ::renoir::profiling::RequestTraceCapture();
+  }
+  ImGui::SameLine();
+  float spike_threshold_ms = (float)::renoir::profiling::GetTraceSpikeThreshold();
+  ImGui::PushItemWidth(150);
+  if (ImGui::SliderFloat("Spike ms", &spike_threshold_ms, 0.0f, 200.0f, "%.1f")) {
+    ::renoir::profiling::SetTraceSpikeThreshold(spike_threshold_ms);
+  }
+  ImGui::PopItemWidth();
+  ImGui::SameLine();
+  ImGui::Text("%zu captures", ::renoir::profiling::GetTraceCaptureCount());
+  for (const internal::ProfileThreadInfo& thread : state.snapshot.threads) {
+    if (thread.dropped) {
+      ImGui::SameLine();
+      ImGui::TextColored({1.0f, 0.4f, 0.4f, 1.0f}, "%s dropped %llu zones", thread.name.c_str(),
+                         (unsigned long long)thread.dropped);
+    }
+  }
+  internal::DrawFrameSchedulerStats();
+  internal::DrawFrameMemoryStats();
+
+  if (ImGui::CollapsingHeader("Timeline", ImGuiTreeNodeFlags_DefaultOpen)) {
+    internal::DrawProfileTimeline(&state);
+  }
+  if (ImGui::CollapsingHeader("Flame graph", ImGuiTreeNodeFlags_DefaultOpen)) {
+    internal::DrawProfileFlameGraph(&state);
+  }
+  if (ImGui::CollapsingHeader("GPU", ImGuiTreeNodeFlags_DefaultOpen)) {
+    internal::DrawGLStateCounters();
+    internal::DrawGpuPasses(state);
+  }
+  if (ImGui::CollapsingHeader("Frame pacing", ImGuiTreeNodeFlags_DefaultOpen)) {
+    internal::DrawFramePacing();
+  }
+  if (ImGui::CollapsingHeader("Zones", ImGuiTreeNodeFlags_DefaultOpen)) {
+    internal::DrawProfileZoneStats(state);
+  }
+}
+
+}   // namespace editor
+}   // namespace renoir
+
+#endif  // SRC_EDITOR_PROFILER_WINDOW_H
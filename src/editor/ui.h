@@ -11,24 +11,112 @@
 #ifndef SRC_EDITOR_UI_H
 #define SRC_EDITOR_UI_H
 
+#include <algorithm>
+
 #include <imgui/imgui.h>
 #include <external/imguidock.h>
 
 #include "logging/log.h"
+#include "editor/dock.h"
+#include "editor/memory_window.h"
+#include "editor/profiler_window.h"
+#include "logging/log_view.h"
+#include "utils/memory.h"
 #include "utils/scope_trigger.h"
-#include "utils/string.h"
 
 namespace renoir {
 namespace editor {
 
 using ::renoir::utils::ScopeTrigger;
-using ::renoir::utils::FormattedString;
+using ::renoir::utils::FrameFormattedString;
 
 using namespace ::renoir::logging;
 
-void LogWindow(ImVec2 start_pos, ImVec2 start_size) {
-  /* static size_t static_log_count = 0; */
+namespace internal {
+
+// Floods the log from its own thread, so we can measure the log window with
+// a big history. By default it pushes in bursts so the drain thread can keep
+// up with it. With |flood| it doesn't pause, to exercise the overflow policy.
+struct LogStressTest {
+  std::thread thread;
+  std::atomic<bool> running;
+  std::atomic<size_t> logged;
+  LogOverflowPolicy policy = LogOverflowPolicy::LOG_OVERFLOW_DROP_NEWEST;
+  bool flood = false;
+
+ public:
+  LogStressTest() : running(false), logged(0) {}
+  ~LogStressTest() {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+};
+
+void StartLogStressTest(LogStressTest *test, size_t count) {
+  if (test->running.load()) {
+    return;
+  }
+  if (test->thread.joinable()) {
+    test->thread.join();
+  }
+
+  test->running = true;
+  test->logged = 0;
+  LogOverflowPolicy policy = test->policy;
+  bool flood = test->flood;
+  test->thread = std::thread([test, count, policy, flood]() {
+    ::renoir::platform::GetThreadContext()->name = "Log stress test";
+    SetLogOverflowPolicy(policy);
+    const size_t burst = RNR_THREAD_LOG_ENTRIES / 2;
+    for (size_t i = 0; i < count; i += burst) {
+      for (size_t j = i; j < i + burst && j < count; j++) {
+        RNR_LOG_INFO("Stress entry %zu of %zu (%f)", j, count, (double)j * 0.5);
+      }
+      test->logged.store(i + burst < count ? i + burst : count);
+      if (!flood) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+    test->running = false;
+  });
+}
+
+// Keeps the last frame times, to see what the log window costs us
+struct FrameTimes {
+  static const int kFrameCount = 120;
+  float times_ms[kFrameCount] = {};
+  int current = 0;
 
+ public:
+  void Add(float time_ms) {
+    times_ms[current] = time_ms;
+    current = (current + 1) % kFrameCount;
+  }
+
+  float Max() const {
+    float max = 0;
+    for (float time : times_ms) {
+      max = time > max ? time : max;
+    }
+    return max;
+  }
+};
+
+}   // namespace internal
+
+/**
+ * Every thread's entries, merged by time and indexed, as shown by LogWindow.
+ * LogWindow doesn't update it: the frame does it with LogView::Update before
+ * building the UI, which only processes what arrived since the last frame
+ * and doesn't need the main thread.
+ */
+LogView *GetLogWindowView() {
+  static LogView view;
+  return &view;
+}
+
+void LogWindow(ImVec2 start_pos, ImVec2 start_size) {
   ImGui::SetNextWindowPos(start_pos, ImGuiCond_Once);
   ImGui::SetNextWindowSize(start_size, ImGuiCond_Once);
 
@@ -39,6 +127,91 @@ void LogWindow(ImVec2 start_pos, ImVec2 start_size) {
 
   GlobalLogContext *global_context = GetGlobalLogContext();
 
+  LogView& view = *GetLogWindowView();
+  // Edited in place and only handed to the view when it changes, so we
+  // don't copy it (and its text and thread list) every frame. Only this
+  // window sets the filter, so it stays the same as the view's.
+  static LogFilter filter = view.filter();
+  bool filter_changed = false;
+
+  // Benchmark controls
+  static internal::LogStressTest stress_test;
+  static internal::FrameTimes frame_times;
+  frame_times.Add(ImGui::GetIO().DeltaTime * 1000.0f);
+  if (ImGui::Button("Stress (1M entries)")) {
+    internal::StartLogStressTest(&stress_test, 1000000);
+  }
+  ImGui::SameLine();
+  {
+    const char *policies[] = {"Drop newest", "Overwrite oldest", "Block"};
+    int policy = (int)stress_test.policy;
+    ImGui::PushItemWidth(130);
+    if (ImGui::Combo("##stress_policy", &policy, policies, IM_ARRAYSIZE(policies))) {
+      stress_test.policy = (LogOverflowPolicy::InternalEnum)policy;
+    }
+    ImGui::PopItemWidth();
+  }
+  ImGui::SameLine();
+  ImGui::Checkbox("Flood", &stress_test.flood);
+  ImGui::SameLine();
+  ImGui::Text("Entries: %zu (showing %zu) | Frame: %.2f ms (max %.2f ms)",
+              view.row_count(), view.filtered_row_count(),
+              ImGui::GetIO().DeltaTime * 1000.0f, frame_times.Max());
+  // Past the retention limits the oldest entries go away
+  uint64_t dropped = view.dropped_count();
+  if (dropped > 0 || view.dropped_rows() > 0) {
+    ImGui::SameLine();
+    ImGui::TextColored({1.0f, 0.8f, 0.4f, 1.0f}, "| %llu entries dropped (%zu rows)",
+                       (unsigned long long)dropped, view.dropped_rows());
+  }
+  uint64_t sink_dropped = global_context->sink_dropped.load(std::memory_order_relaxed);
+  if (sink_dropped > 0) {
+    ImGui::SameLine();
+    ImGui::TextColored({1.0f, 0.4f, 0.4f, 1.0f}, "| %llu not written by the sinks",
+                       (unsigned long long)sink_dropped);
+  }
+  if (stress_test.running.load()) {
+    ImGui::SameLine();
+    ImGui::Text("| Stress: %zu logged", stress_test.logged.load());
+  }
+
+  // Filters
+  for (int level = 0; level < RNR_LOG_LEVEL_COUNT; level++) {
+    bool enabled = (filter.level_mask & (1u << level)) != 0;
+    if (ImGui::Checkbox(GetLogLevelShortName((LogLevel::InternalEnum)level), &enabled)) {
+      filter.level_mask ^= 1u << level;
+      filter_changed = true;
+    }
+    ImGui::SameLine();
+  }
+
+  static char search_buffer[256] = {};
+  ImGui::PushItemWidth(200);
+  if (ImGui::InputText("##search", search_buffer, sizeof(search_buffer))) {
+    filter.text = search_buffer;
+    filter_changed = true;
+  }
+  ImGui::PopItemWidth();
+  ImGui::SameLine();
+  if (ImGui::Checkbox("Regex", &filter.use_regex)) {
+    filter_changed = true;
+  }
+  if (view.searching()) {
+    ImGui::SameLine();
+    ImGui::Text("Searching... %zu/%zu", view.searched_rows(), view.row_count());
+  }
+  if (!view.search_error().empty()) {
+    ImGui::SameLine();
+    ImGui::TextColored({1.0f, 0.4f, 0.4f, 1.0f}, "%s", view.search_error().c_str());
+  }
+  if (filter.use_location) {
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Clear location")) {
+      filter.use_location = false;
+      filter_changed = true;
+    }
+  }
+
   {
     auto window_width = ImGui::GetWindowWidth();
     static float pane_ratio = 0.4f;
@@ -46,14 +219,81 @@ void LogWindow(ImVec2 start_pos, ImVec2 start_size) {
                    ImGui::EndChild());
 
 
-    for (auto it : global_context->log_contexts) {
-      size_t uid = it.second->thread_context->UID;
-      const char *name = it.second->thread_context->name.c_str();
-      auto label = FormattedString("Thread %zu: %s", uid, name);
-      ImGui::Selectable(label.c_str());
+    // Selecting threads restricts the view to them
+    std::lock_guard<std::mutex> guard(global_context->mutex);
+    for (auto& it : global_context->log_contexts) {
+      ThreadLocalLogContext *context = it.second;
+      const char *name = context->alive.load(std::memory_order_acquire)
+          ? context->thread_name()
+          : FrameFormattedString("%s (exited)", context->thread_name());
+      // Whatever the overflow policy threw away. The counters change all the
+      // time, so the ID comes from the uid only (after ###).
+      uint64_t dropped = context->dropped.load(std::memory_order_relaxed);
+      uint64_t overwritten = context->overwritten.load(std::memory_order_relaxed);
+      const char *label = (dropped || overwritten)
+          ? FrameFormattedString("Thread %zu: %s (dropped %llu, overwritten %llu)###thread_%zu",
+                                 context->thread_uid, name, (unsigned long long)dropped,
+                                 (unsigned long long)overwritten, context->thread_uid)
+          : FrameFormattedString("Thread %zu: %s###thread_%zu", context->thread_uid, name,
+                                 context->thread_uid);
+
+      auto& threads = filter.threads;
+      auto thread_it = std::find(threads.begin(), threads.end(), context->thread_uid);
+      bool selected = thread_it != threads.end();
+      if (ImGui::Selectable(label, selected)) {
+        if (selected) {
+          threads.erase(thread_it);
+        } else {
+          threads.push_back(context->thread_uid);
+        }
+        filter_changed = true;
+      }
+    }
+  }
+
+  ImGui::SameLine();
+  {
+    SCOPED_TRIGGER(ImGui::BeginChild("right_pane", {0, 0}, true,
+                                     ImGuiWindowFlags_HorizontalScrollbar),
+                   ImGui::EndChild());
+
+    // Every row has the same height, so the offset of any row is just
+    // index * height and the clipper only has to format the visible rows.
+    bool at_bottom = ImGui::GetScrollY() >= ImGui::GetScrollMaxY();
+    char line[1024];
+    LogEntry entry;
+    const ThreadLocalLogContext *context;
+    ImGuiListClipper clipper((int)view.filtered_row_count(),
+                             ImGui::GetTextLineHeightWithSpacing());
+    while (clipper.Step()) {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+        // Its thread's history might have dropped it already
+        if (!view.ReadRow(view.GetFilteredRow(i), &entry, &context)) {
+          ImGui::TextDisabled("<dropped>");
+          continue;
+        }
+        FormatLogLine(context->thread_uid, entry, line, sizeof(line));
+        ImGui::TextUnformatted(line);
+
+        // Right click filters by the location of the entry
+        if (ImGui::IsItemClicked(1)) {
+          filter.use_location = true;
+          filter.filename = entry.filename;
+          filter.line = entry.line;
+          filter_changed = true;
+        }
+      }
+    }
+
+    // Follow the tail unless the user scrolled up
+    if (at_bottom) {
+      ImGui::SetScrollHere(1.0f);
     }
   }
 
+  if (filter_changed) {
+    view.SetFilter(filter);
+  }
 }
 
 void TestWindow() {
@@ -73,15 +313,18 @@ void TestWindow() {
 
   if (visible) {
 
-    SCOPED_TRIGGER(ImGui::BeginDockspace(), ImGui::EndDockspace());
+    SCOPED_TRIGGER(BeginDockspace(), EndDockspace());
+
+    ProfilerDock();
+    MemoryDock();
 
     static char tmp[128];
     for (int i = 0; i < 5; i++) {
       sprintf(tmp, "Dock %d", i);
-      if (ImGui::BeginDock(tmp)) {
+      if (BeginDock(tmp)) {
         ImGui::Text("Content of dock %d", i);
       }
-      ImGui::EndDock();
+      EndDock();
     }
 
 
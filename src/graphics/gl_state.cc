@@ -0,0 +1,324 @@
+/******************************************************************************
+ * @file: gl_state.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-22
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include "graphics/gl_state.h"
+
+namespace renoir {
+namespace graphics {
+
+namespace {
+
+bool IsRectKnown(const GLint rect[4]) {
+  return rect[2] >= 0;
+}
+
+bool SameRect(const GLint rect[4], GLint x, GLint y, GLsizei width, GLsizei height) {
+  return rect[0] == x && rect[1] == y && rect[2] == width && rect[3] == height;
+}
+
+}   // namespace
+
+void GLStateCache::Invalidate() {
+  state_.program = RNR_GL_STATE_UNKNOWN;
+  state_.active_texture = RNR_GL_STATE_UNKNOWN;
+  for (int i = 0; i < RNR_GL_STATE_TEXTURE_UNITS; i++) {
+    state_.textures_2d[i] = RNR_GL_STATE_UNKNOWN;
+    state_.samplers[i] = RNR_GL_STATE_UNKNOWN;
+  }
+  state_.vertex_array = RNR_GL_STATE_UNKNOWN;
+  state_.array_buffer = RNR_GL_STATE_UNKNOWN;
+  state_.element_array_buffer = RNR_GL_STATE_UNKNOWN;
+  state_.blend = RNR_GL_STATE_UNKNOWN;
+  state_.cull_face = RNR_GL_STATE_UNKNOWN;
+  state_.depth_test = RNR_GL_STATE_UNKNOWN;
+  state_.scissor_test = RNR_GL_STATE_UNKNOWN;
+  state_.blend_equation_rgb = RNR_GL_STATE_UNKNOWN;
+  state_.blend_equation_alpha = RNR_GL_STATE_UNKNOWN;
+  state_.blend_src_rgb = RNR_GL_STATE_UNKNOWN;
+  state_.blend_dst_rgb = RNR_GL_STATE_UNKNOWN;
+  state_.blend_src_alpha = RNR_GL_STATE_UNKNOWN;
+  state_.blend_dst_alpha = RNR_GL_STATE_UNKNOWN;
+  state_.polygon_mode = RNR_GL_STATE_UNKNOWN;
+  state_.viewport[2] = -1;
+  state_.scissor_box[2] = -1;
+}
+
+void GLStateCache::Sync() {
+  auto get = [this](GLenum name) {
+    GLint value = 0;
+    glGetIntegerv(name, &value);
+    counters_.queried++;
+    return (GLuint)value;
+  };
+  auto is_enabled = [this](GLenum cap) {
+    counters_.queried++;
+    return (GLuint)glIsEnabled(cap);
+  };
+
+  state_.program = get(GL_CURRENT_PROGRAM);
+  state_.active_texture = get(GL_ACTIVE_TEXTURE);
+  // Only the active unit is queried, reading the rest means switching units
+  for (int i = 0; i < RNR_GL_STATE_TEXTURE_UNITS; i++) {
+    state_.textures_2d[i] = RNR_GL_STATE_UNKNOWN;
+    state_.samplers[i] = RNR_GL_STATE_UNKNOWN;
+  }
+  GLuint unit = state_.active_texture - GL_TEXTURE0;
+  if (unit < RNR_GL_STATE_TEXTURE_UNITS) {
+    state_.textures_2d[unit] = get(GL_TEXTURE_BINDING_2D);
+    state_.samplers[unit] = get(GL_SAMPLER_BINDING);
+  }
+  state_.vertex_array = get(GL_VERTEX_ARRAY_BINDING);
+  state_.array_buffer = get(GL_ARRAY_BUFFER_BINDING);
+  state_.element_array_buffer = get(GL_ELEMENT_ARRAY_BUFFER_BINDING);
+
+  state_.blend = is_enabled(GL_BLEND);
+  state_.cull_face = is_enabled(GL_CULL_FACE);
+  state_.depth_test = is_enabled(GL_DEPTH_TEST);
+  state_.scissor_test = is_enabled(GL_SCISSOR_TEST);
+  state_.blend_equation_rgb = get(GL_BLEND_EQUATION_RGB);
+  state_.blend_equation_alpha = get(GL_BLEND_EQUATION_ALPHA);
+  state_.blend_src_rgb = get(GL_BLEND_SRC_RGB);
+  state_.blend_dst_rgb = get(GL_BLEND_DST_RGB);
+  state_.blend_src_alpha = get(GL_BLEND_SRC_ALPHA);
+  state_.blend_dst_alpha = get(GL_BLEND_DST_ALPHA);
+
+  GLint polygon_mode[2];
+  glGetIntegerv(GL_POLYGON_MODE, polygon_mode);
+  glGetIntegerv(GL_VIEWPORT, state_.viewport);
+  glGetIntegerv(GL_SCISSOR_BOX, state_.scissor_box);
+  counters_.queried += 3;
+  state_.polygon_mode = (GLenum)polygon_mode[0];
+}
+
+void GLStateCache::Restore(const GLState& state) {
+  if (state.program != RNR_GL_STATE_UNKNOWN) {
+    UseProgram(state.program);
+  }
+  // Textures and samplers first, as they need to switch units
+  for (GLuint i = 0; i < RNR_GL_STATE_TEXTURE_UNITS; i++) {
+    if (state.textures_2d[i] != RNR_GL_STATE_UNKNOWN &&
+        state.textures_2d[i] != state_.textures_2d[i]) {
+      ActiveTexture(GL_TEXTURE0 + i);
+      BindTexture2D(state.textures_2d[i]);
+    }
+    if (state.samplers[i] != RNR_GL_STATE_UNKNOWN) {
+      BindSampler(i, state.samplers[i]);
+    }
+  }
+  if (state.active_texture != RNR_GL_STATE_UNKNOWN) {
+    ActiveTexture(state.active_texture);
+  }
+
+  // The element buffer goes after the VAO it belongs to
+  if (state.vertex_array != RNR_GL_STATE_UNKNOWN) {
+    BindVertexArray(state.vertex_array);
+  }
+  if (state.array_buffer != RNR_GL_STATE_UNKNOWN) {
+    BindBuffer(GL_ARRAY_BUFFER, state.array_buffer);
+  }
+  if (state.element_array_buffer != RNR_GL_STATE_UNKNOWN) {
+    BindBuffer(GL_ELEMENT_ARRAY_BUFFER, state.element_array_buffer);
+  }
+
+  if (state.blend != RNR_GL_STATE_UNKNOWN) {
+    SetEnabled(GL_BLEND, state.blend == GL_TRUE);
+  }
+  if (state.cull_face != RNR_GL_STATE_UNKNOWN) {
+    SetEnabled(GL_CULL_FACE, state.cull_face == GL_TRUE);
+  }
+  if (state.depth_test != RNR_GL_STATE_UNKNOWN) {
+    SetEnabled(GL_DEPTH_TEST, state.depth_test == GL_TRUE);
+  }
+  if (state.scissor_test != RNR_GL_STATE_UNKNOWN) {
+    SetEnabled(GL_SCISSOR_TEST, state.scissor_test == GL_TRUE);
+  }
+  if (state.blend_equation_rgb != RNR_GL_STATE_UNKNOWN &&
+      state.blend_equation_alpha != RNR_GL_STATE_UNKNOWN) {
+    BlendEquationSeparate(state.blend_equation_rgb, state.blend_equation_alpha);
+  }
+  if (state.blend_src_rgb != RNR_GL_STATE_UNKNOWN && state.blend_dst_rgb != RNR_GL_STATE_UNKNOWN &&
+      state.blend_src_alpha != RNR_GL_STATE_UNKNOWN &&
+      state.blend_dst_alpha != RNR_GL_STATE_UNKNOWN) {
+    BlendFuncSeparate(state.blend_src_rgb, state.blend_dst_rgb, state.blend_src_alpha,
+                      state.blend_dst_alpha);
+  }
+  if (state.polygon_mode != RNR_GL_STATE_UNKNOWN) {
+    PolygonMode(state.polygon_mode);
+  }
+  if (IsRectKnown(state.viewport)) {
+    Viewport(state.viewport[0], state.viewport[1], state.viewport[2], state.viewport[3]);
+  }
+  if (IsRectKnown(state.scissor_box)) {
+    Scissor(state.scissor_box[0], state.scissor_box[1], state.scissor_box[2],
+            state.scissor_box[3]);
+  }
+}
+
+bool GLStateCache::Update(GLuint *current, GLuint value) {
+  if (*current == value) {
+    counters_.filtered++;
+    return false;
+  }
+  *current = value;
+  counters_.issued++;
+  return true;
+}
+
+void GLStateCache::UseProgram(GLuint program) {
+  if (Update(&state_.program, program)) {
+    glUseProgram(program);
+  }
+}
+
+void GLStateCache::ActiveTexture(GLenum unit) {
+  if (Update(&state_.active_texture, unit)) {
+    glActiveTexture(unit);
+  }
+}
+
+void GLStateCache::BindTexture2D(GLuint texture) {
+  GLuint unit = state_.active_texture - GL_TEXTURE0;
+  if (state_.active_texture == RNR_GL_STATE_UNKNOWN || unit >= RNR_GL_STATE_TEXTURE_UNITS) {
+    counters_.issued++;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    return;
+  }
+  if (Update(&state_.textures_2d[unit], texture)) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+  }
+}
+
+void GLStateCache::BindSampler(GLuint unit, GLuint sampler) {
+  if (unit >= RNR_GL_STATE_TEXTURE_UNITS) {
+    counters_.issued++;
+    glBindSampler(unit, sampler);
+    return;
+  }
+  if (Update(&state_.samplers[unit], sampler)) {
+    glBindSampler(unit, sampler);
+  }
+}
+
+void GLStateCache::BindVertexArray(GLuint vertex_array) {
+  if (Update(&state_.vertex_array, vertex_array)) {
+    glBindVertexArray(vertex_array);
+    state_.element_array_buffer = RNR_GL_STATE_UNKNOWN;
+  }
+}
+
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer) {
+  GLuint *current = nullptr;
+  if (target == GL_ARRAY_BUFFER) {
+    current = &state_.array_buffer;
+  } else if (target == GL_ELEMENT_ARRAY_BUFFER) {
+    current = &state_.element_array_buffer;
+  }
+  if (!current) {
+    counters_.issued++;
+    glBindBuffer(target, buffer);
+    return;
+  }
+  if (Update(current, buffer)) {
+    glBindBuffer(target, buffer);
+  }
+}
+
+void GLStateCache::SetEnabled(GLenum cap, bool enabled) {
+  GLuint *current = nullptr;
+  switch (cap) {
+    case GL_BLEND: current = &state_.blend; break;
+    case GL_CULL_FACE: current = &state_.cull_face; break;
+    case GL_DEPTH_TEST: current = &state_.depth_test; break;
+    case GL_SCISSOR_TEST: current = &state_.scissor_test; break;
+    default: break;
+  }
+  if (current && !Update(current, enabled ? GL_TRUE : GL_FALSE)) {
+    return;
+  }
+  if (!current) {
+    counters_.issued++;
+  }
+  if (enabled) {
+    glEnable(cap);
+  } else {
+    glDisable(cap);
+  }
+}
+
+void GLStateCache::BlendEquationSeparate(GLenum mode_rgb, GLenum mode_alpha) {
+  if (state_.blend_equation_rgb == mode_rgb && state_.blend_equation_alpha == mode_alpha) {
+    counters_.filtered++;
+    return;
+  }
+  state_.blend_equation_rgb = mode_rgb;
+  state_.blend_equation_alpha = mode_alpha;
+  counters_.issued++;
+  glBlendEquationSeparate(mode_rgb, mode_alpha);
+}
+
+void GLStateCache::BlendFuncSeparate(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha,
+                                     GLenum dst_alpha) {
+  if (state_.blend_src_rgb == src_rgb && state_.blend_dst_rgb == dst_rgb &&
+      state_.blend_src_alpha == src_alpha && state_.blend_dst_alpha == dst_alpha) {
+    counters_.filtered++;
+    return;
+  }
+  state_.blend_src_rgb = src_rgb;
+  state_.blend_dst_rgb = dst_rgb;
+  state_.blend_src_alpha = src_alpha;
+  state_.blend_dst_alpha = dst_alpha;
+  counters_.issued++;
+  glBlendFuncSeparate(src_rgb, dst_rgb, src_alpha, dst_alpha);
+}
+
+void GLStateCache::PolygonMode(GLenum mode) {
+  if (Update(&state_.polygon_mode, mode)) {
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+  }
+}
+
+void GLStateCache::Viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+  if (SameRect(state_.viewport, x, y, width, height)) {
+    counters_.filtered++;
+    return;
+  }
+  state_.viewport[0] = x;
+  state_.viewport[1] = y;
+  state_.viewport[2] = width;
+  state_.viewport[3] = height;
+  counters_.issued++;
+  glViewport(x, y, width, height);
+}
+
+void GLStateCache::Scissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+  if (SameRect(state_.scissor_box, x, y, width, height)) {
+    counters_.filtered++;
+    return;
+  }
+  state_.scissor_box[0] = x;
+  state_.scissor_box[1] = y;
+  state_.scissor_box[2] = width;
+  state_.scissor_box[3] = height;
+  counters_.issued++;
+  glScissor(x, y, width, height);
+}
+
+void GLStateCache::EndFrame() {
+  last_frame_counters_ = counters_;
+  counters_ = {};
+}
+
+GLStateCache *GetGLStateCache() {
+  static GLStateCache cache;
+  return &cache;
+}
+
+}   // namespace graphics
+}   // namespace renoir
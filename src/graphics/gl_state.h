@@ -0,0 +1,141 @@
+/******************************************************************************
+ * @file: gl_state.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-22
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * CPU shadow of the GL state we touch: program, textures, samplers, buffers,
+ * VAO, blend/cull/depth/scissor, polygon mode, viewport and scissor box.
+ * Setting a value that is already current doesn't reach GL, and saving or
+ * restoring the state (as the ImGui backend does around its draws) is a copy
+ * of the shadow instead of a round of glGet calls.
+ *
+ * For it to work every change of those states has to go through the cache.
+ * Code that changes them behind its back must call Invalidate() (cheap, the
+ * next sets always go through) or Sync() (queries everything back).
+ *
+ * The cache belongs to the GL context, so it must only be used from the
+ * thread that owns it.
+ ******************************************************************************/
+
+#ifndef SRC_GRAPHICS_GL_STATE_H
+#define SRC_GRAPHICS_GL_STATE_H
+
+#include <cstdint>
+
+#include <external/GL/gl3w.h>
+
+// Texture units whose 2D binding and sampler are tracked
+#define RNR_GL_STATE_TEXTURE_UNITS 8
+// Value of a state we don't know. Setting it always reaches GL.
+#define RNR_GL_STATE_UNKNOWN 0xFFFFFFFFu
+
+namespace renoir {
+namespace graphics {
+
+struct GLState {
+  GLuint program;
+  GLenum active_texture;
+  GLuint textures_2d[RNR_GL_STATE_TEXTURE_UNITS];
+  GLuint samplers[RNR_GL_STATE_TEXTURE_UNITS];
+  GLuint vertex_array;
+  GLuint array_buffer;
+  // Part of the VAO state, so it becomes unknown whenever the VAO changes
+  GLuint element_array_buffer;
+
+  // GL_TRUE, GL_FALSE or unknown
+  GLuint blend;
+  GLuint cull_face;
+  GLuint depth_test;
+  GLuint scissor_test;
+  GLenum blend_equation_rgb;
+  GLenum blend_equation_alpha;
+  GLenum blend_src_rgb;
+  GLenum blend_dst_rgb;
+  GLenum blend_src_alpha;
+  GLenum blend_dst_alpha;
+  GLenum polygon_mode;
+
+  // Unknown while the width is negative
+  GLint viewport[4];
+  GLint scissor_box[4];
+};
+
+struct GLStateCounters {
+  // Calls that reached GL
+  uint64_t issued = 0;
+  // Calls dropped because the value was already set
+  uint64_t filtered = 0;
+  // glGet/glIsEnabled calls made by Sync
+  uint64_t queried = 0;
+  // Reported by the renderers through CountDraws
+  uint64_t draws = 0;
+  uint64_t draw_commands = 0;
+};
+
+class GLStateCache {
+ public:
+  GLStateCache() { Invalidate(); }
+
+ public:
+  // Forgets everything. Must be called after code that bypasses the cache.
+  void Invalidate();
+  // Queries the whole state back from GL
+  void Sync();
+
+  const GLState& state() const { return state_; }
+  // Sets back every known state of |state|
+  void Restore(const GLState& state);
+
+ public:
+  void UseProgram(GLuint program);
+  void ActiveTexture(GLenum unit);
+  // On the active unit
+  void BindTexture2D(GLuint texture);
+  void BindSampler(GLuint unit, GLuint sampler);
+  void BindVertexArray(GLuint vertex_array);
+  // GL_ARRAY_BUFFER and GL_ELEMENT_ARRAY_BUFFER are tracked, other targets
+  // go straight to GL
+  void BindBuffer(GLenum target, GLuint buffer);
+
+  // GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST and GL_SCISSOR_TEST are tracked
+  void SetEnabled(GLenum cap, bool enabled);
+  void BlendEquationSeparate(GLenum mode_rgb, GLenum mode_alpha);
+  void BlendFuncSeparate(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha);
+  // Always for GL_FRONT_AND_BACK
+  void PolygonMode(GLenum mode);
+  void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+  void Scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+
+ public:
+  // Since the last EndFrame
+  const GLStateCounters& counters() const { return counters_; }
+  // Of the frame before the last EndFrame
+  const GLStateCounters& last_frame_counters() const { return last_frame_counters_; }
+  // Draw calls issued and the commands they covered, so batching shows up
+  // next to the state changes
+  void CountDraws(uint64_t draws, uint64_t commands) {
+    counters_.draws += draws;
+    counters_.draw_commands += commands;
+  }
+  void EndFrame();
+
+ private:
+  // Returns true if |current| has to change to |value| (and updates it)
+  bool Update(GLuint *current, GLuint value);
+
+ private:
+  GLState state_;
+  GLStateCounters counters_;
+  GLStateCounters last_frame_counters_;
+};
+
+// The cache of the main GL context
+GLStateCache *GetGLStateCache();
+
+}   // namespace graphics
+}   // namespace renoir
+
+#endif  // SRC_GRAPHICS_GL_STATE_H
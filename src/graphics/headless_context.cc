@@ -0,0 +1,177 @@
+/******************************************************************************
+ * @file: headless_context.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-23
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include <cstring>
+
+#ifdef RNR_HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "graphics/headless_context.h"
+
+namespace renoir {
+namespace graphics {
+
+using ::renoir::utils::CreateStatus;
+using ::renoir::utils::Status;
+using ::renoir::utils::StatusKind;
+
+#ifdef RNR_HEADLESS_EGL
+
+namespace {
+
+bool HasExtension(const char *extensions, const char *name) {
+  if (!extensions) {
+    return false;
+  }
+  size_t length = strlen(name);
+  for (const char *it = strstr(extensions, name); it; it = strstr(it + 1, name)) {
+    bool starts = it == extensions || it[-1] == ' ';
+    bool ends = it[length] == ' ' || it[length] == '\0';
+    if (starts && ends) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The surfaceless platform doesn't need a display server. Without it we try
+// the default display, which works on most Mesa setups too.
+EGLDisplay GetHeadlessDisplay() {
+  const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (HasExtension(client_extensions, "EGL_MESA_platform_surfaceless")) {
+    auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+        eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display) {
+      EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                                EGL_DEFAULT_DISPLAY, nullptr);
+      if (display != EGL_NO_DISPLAY) {
+        return display;
+      }
+    }
+  }
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+}   // namespace
+
+HeadlessContext::~HeadlessContext() {
+  Shutdown();
+}
+
+Status HeadlessContext::Init(int width, int height) {
+  EGLDisplay display = GetHeadlessDisplay();
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not get an EGL display (0x%x)",
+                        eglGetError());
+  }
+  display_ = display;
+
+  const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+  if (!HasExtension(extensions, "EGL_KHR_surfaceless_context")) {
+    Shutdown();
+    return CreateStatus(StatusKind::STATUS_ERROR, "EGL_KHR_surfaceless_context not supported");
+  }
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    Shutdown();
+    return CreateStatus(StatusKind::STATUS_ERROR, "Desktop GL not supported by EGL");
+  }
+
+  // We never create a surface, so any config (or none) will do
+  EGLConfig config = nullptr;
+  if (!HasExtension(extensions, "EGL_KHR_no_config_context")) {
+    const EGLint config_attribs[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLint config_count = 0;
+    if (!eglChooseConfig(display, config_attribs, &config, 1, &config_count) ||
+        config_count == 0) {
+      Shutdown();
+      return CreateStatus(StatusKind::STATUS_ERROR, "No EGL config for desktop GL");
+    }
+  }
+
+  // Same version and profile as the SDL window asks for
+  const EGLint context_attribs[] = {
+    EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+    EGL_CONTEXT_MINOR_VERSION_KHR, 2,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+    EGL_NONE,
+  };
+  EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+  if (context == EGL_NO_CONTEXT) {
+    Shutdown();
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not create a GL 3.2 context (0x%x)",
+                        eglGetError());
+  }
+  context_ = context;
+  if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    Shutdown();
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not make the context current (0x%x)",
+                        eglGetError());
+  }
+
+  // gl3wInit looks the functions up through GLX, which knows nothing of EGL
+  if (gl3wInit2((GL3WGetProcAddressProc)eglGetProcAddress) != 0) {
+    Shutdown();
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not load the GL functions");
+  }
+
+  width_ = width;
+  height_ = height;
+  glGenRenderbuffers(1, &color_buffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, color_buffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer_);
+  GLenum framebuffer_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (framebuffer_status != GL_FRAMEBUFFER_COMPLETE) {
+    Shutdown();
+    return CreateStatus(StatusKind::STATUS_ERROR, "Incomplete %dx%d framebuffer (0x%x)", width,
+                        height, framebuffer_status);
+  }
+  return {};
+}
+
+void HeadlessContext::Shutdown() {
+  if (context_) {
+    if (framebuffer_) {
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glDeleteFramebuffers(1, &framebuffer_);
+      framebuffer_ = 0;
+    }
+    if (color_buffer_) {
+      glDeleteRenderbuffers(1, &color_buffer_);
+      color_buffer_ = 0;
+    }
+    eglMakeCurrent((EGLDisplay)display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext((EGLDisplay)display_, (EGLContext)context_);
+    context_ = nullptr;
+  }
+  if (display_) {
+    eglTerminate((EGLDisplay)display_);
+    display_ = nullptr;
+  }
+}
+
+#else
+
+HeadlessContext::~HeadlessContext() {}
+
+Status HeadlessContext::Init(int, int) {
+  return CreateStatus(StatusKind::STATUS_ERROR, "renoir was built without EGL support");
+}
+
+void HeadlessContext::Shutdown() {}
+
+#endif  // RNR_HEADLESS_EGL
+
+}   // namespace graphics
+}   // namespace renoir
@@ -0,0 +1,61 @@
+/******************************************************************************
+ * @file: headless_context.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-23
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * GL context without a window, for the build farm and benchmarks.
+ * It's an EGL context on the surfaceless platform (Mesa, including llvmpipe
+ * when there is no GPU) that renders into its own framebuffer object, bound
+ * as the draw framebuffer by Init. There is nothing to swap, so frames are
+ * never throttled by vsync.
+ *
+ * Only available when built with RNR_HEADLESS_EGL (CMake sets it when it
+ * finds EGL). Otherwise Init just fails.
+ ******************************************************************************/
+
+#ifndef SRC_GRAPHICS_HEADLESS_CONTEXT_H
+#define SRC_GRAPHICS_HEADLESS_CONTEXT_H
+
+#include <external/GL/gl3w.h>
+
+#include "utils/macros.h"
+#include "utils/status.h"
+
+namespace renoir {
+namespace graphics {
+
+class HeadlessContext {
+ public:
+  HeadlessContext() = default;
+  ~HeadlessContext();
+  DISABLE_COPY(HeadlessContext);
+  DISABLE_MOVE(HeadlessContext);
+
+ public:
+  // Creates a GL 3.2 core context, makes it current, loads the GL functions
+  // (gl3w) and binds a |width| x |height| RGBA8 framebuffer
+  utils::Status Init(int width, int height);
+  void Shutdown();
+
+ public:
+  GLuint framebuffer() const { return framebuffer_; }
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+ private:
+  // EGL handles, kept opaque so including this doesn't pull EGL in
+  void *display_ = nullptr;
+  void *context_ = nullptr;
+  GLuint framebuffer_ = 0;
+  GLuint color_buffer_ = 0;
+  int width_ = 0;
+  int height_ = 0;
+};
+
+}   // namespace graphics
+}   // namespace renoir
+
+#endif  // SRC_GRAPHICS_HEADLESS_CONTEXT_H
@@ -0,0 +1,212 @@
+/******************************************************************************
+ * @file: stream_buffer.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-21
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include "graphics/stream_buffer.h"
+#include "utils/memory.h"
+
+namespace renoir {
+namespace graphics {
+
+using ::renoir::utils::CreateStatus;
+using ::renoir::utils::Status;
+using ::renoir::utils::StatusKind;
+
+namespace {
+
+// Waits for |fence| and deletes it. Returns true if we actually had to wait.
+bool WaitForFence(GLsync *fence) {
+  if (!*fence) {
+    return false;
+  }
+  bool waited = false;
+  GLenum result = glClientWaitSync(*fence, 0, 0);
+  while (result == GL_TIMEOUT_EXPIRED) {
+    waited = true;
+    result = glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+  }
+  glDeleteSync(*fence);
+  *fence = nullptr;
+  return waited;
+}
+
+}   // namespace
+
+StreamBuffer::~StreamBuffer() {
+  // The GL context might be gone by now, so we can't release anything here
+}
+
+Status StreamBuffer::Init(size_t region_size) {
+  if (!gl3wIsSupported(3, 2)) {
+    return CreateStatus(StatusKind::STATUS_ERROR, "Stream buffers need GL 3.2");
+  }
+  return CreateBuffer(region_size);
+}
+
+void StreamBuffer::Shutdown() {
+  DestroyBuffer();
+}
+
+// Replaces the current buffer only if the new one could be created
+Status StreamBuffer::CreateBuffer(size_t region_size) {
+  size_t size = region_size * RNR_STREAM_BUFFER_FRAMES;
+
+  // COPY_WRITE so we don't disturb whatever the user has bound
+  GLint last_buffer;
+  glGetIntegerv(GL_COPY_WRITE_BUFFER_BINDING, &last_buffer);
+  GLuint buffer = 0;
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+
+  uint8_t *mapping = nullptr;
+  bool persistent = (gl3wIsSupported(4, 4) && glBufferStorage);
+  if (persistent) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_COPY_WRITE_BUFFER, (GLsizeiptr)size, nullptr, flags);
+    mapping = (uint8_t*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)size, flags);
+    // Some drivers advertise it but fail to map. The other path still works.
+    if (!mapping) {
+      glDeleteBuffers(1, &buffer);
+      glGenBuffers(1, &buffer);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+      persistent = false;
+    }
+  }
+  if (!persistent) {
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)size, nullptr, GL_STREAM_DRAW);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, (GLuint)last_buffer);
+
+  if (glGetError() != GL_NO_ERROR) {
+    glDeleteBuffers(1, &buffer);
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not create a %zu bytes stream buffer",
+                        size);
+  }
+
+  DestroyBuffer();
+  buffer_ = buffer;
+  mapping_ = mapping;
+  persistent_ = persistent;
+  region_size_ = region_size;
+  region_ = 0;
+  used_ = 0;
+  generation_++;
+  tracked_bytes_ = size;
+  utils::TrackExternalBytes(utils::MEMORY_TAG_GL_STAGING, (int64_t)tracked_bytes_);
+  return {};
+}
+
+void StreamBuffer::DestroyBuffer() {
+  for (GLsync& fence : fences_) {
+    if (fence) {
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+  if (buffer_) {
+    // Deleting the buffer unmaps it
+    glDeleteBuffers(1, &buffer_);
+    buffer_ = 0;
+  }
+  mapping_ = nullptr;
+  in_frame_ = false;
+  writing_ = false;
+  utils::TrackExternalBytes(utils::MEMORY_TAG_GL_STAGING, -(int64_t)tracked_bytes_);
+  tracked_bytes_ = 0;
+}
+
+void StreamBuffer::BeginFrame(size_t size) {
+  if (!buffer_) {
+    return;
+  }
+  if (size > region_size_) {
+    // Every region could be in use, so everything has to finish first
+    for (GLsync& fence : fences_) {
+      WaitForFence(&fence);
+    }
+    size_t region_size = region_size_;
+    while (region_size < size) {
+      region_size *= 2;
+    }
+    // On failure we go on with the old buffer, and grow again next frame
+    if (!utils::IsStatusOk(CreateBuffer(region_size))) {
+      region_ = (region_ + 1) % RNR_STREAM_BUFFER_FRAMES;
+    }
+  } else {
+    region_ = (region_ + 1) % RNR_STREAM_BUFFER_FRAMES;
+  }
+
+  if (WaitForFence(&fences_[region_])) {
+    stalls_++;
+  }
+  used_ = 0;
+
+  if (!persistent_) {
+    GLint last_buffer;
+    glGetIntegerv(GL_COPY_WRITE_BUFFER_BINDING, &last_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+    // The fence already told us the GPU is done with the region
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                       GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+    mapping_ = (uint8_t*)glMapBufferRange(GL_COPY_WRITE_BUFFER,
+                                          (GLintptr)(region_ * region_size_),
+                                          (GLsizeiptr)region_size_, flags);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, (GLuint)last_buffer);
+  }
+  in_frame_ = mapping_ != nullptr;
+  writing_ = in_frame_;
+}
+
+uint8_t *StreamBuffer::Allocate(size_t size, size_t alignment, size_t *offset) {
+  if (!writing_) {
+    return nullptr;
+  }
+  size_t region_begin = region_ * region_size_;
+  // Offsets are aligned within the whole buffer, as that's what GL sees
+  size_t begin = region_begin + used_;
+  begin = ((begin + alignment - 1) / alignment) * alignment;
+  if (begin + size > region_begin + region_size_) {
+    return nullptr;
+  }
+  used_ = begin + size - region_begin;
+  *offset = begin;
+  return persistent_ ? mapping_ + begin : mapping_ + (begin - region_begin);
+}
+
+void StreamBuffer::FinishWrites() {
+  if (!writing_) {
+    return;
+  }
+  writing_ = false;
+
+  if (!persistent_) {
+    GLint last_buffer;
+    glGetIntegerv(GL_COPY_WRITE_BUFFER_BINDING, &last_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+    if (used_ > 0) {
+      glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)used_);
+    }
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, (GLuint)last_buffer);
+    mapping_ = nullptr;
+  }
+}
+
+void StreamBuffer::EndFrame() {
+  if (!in_frame_) {
+    return;
+  }
+  FinishWrites();
+  in_frame_ = false;
+  // Covers every command issued so far, including the draws reading the region
+  fences_[region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+}   // namespace graphics
+}   // namespace renoir
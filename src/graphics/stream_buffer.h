@@ -0,0 +1,113 @@
+/******************************************************************************
+ * @file: stream_buffer.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-21
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Ring buffer for data that is written once per frame by the CPU and read by
+ * the GPU (vertices, indices). The buffer is split in RNR_STREAM_BUFFER_FRAMES
+ * regions, one per frame in flight, each guarded by a fence. Writing into a
+ * region only waits if the GPU is still reading it from
+ * RNR_STREAM_BUFFER_FRAMES frames ago.
+ *
+ * With GL 4.4 (or ARB_buffer_storage) the buffer is mapped once, persistent
+ * and coherent. Otherwise each frame maps its region with
+ * GL_MAP_UNSYNCHRONIZED_BIT, as the fence already did the synchronization,
+ * and FinishWrites unmaps it: GL can't draw from a buffer mapped without
+ * GL_MAP_PERSISTENT_BIT.
+ *
+ *  buffer.BeginFrame(size);
+ *  ... Allocate and write ...
+ *  buffer.FinishWrites();
+ *  ... draws ...
+ *  buffer.EndFrame();
+ *
+ * The buffer can be bound to any target (eg. GL_ARRAY_BUFFER and
+ * GL_ELEMENT_ARRAY_BUFFER at the same time) and sources draws through the
+ * offsets returned by Allocate.
+ ******************************************************************************/
+
+#ifndef SRC_GRAPHICS_STREAM_BUFFER_H
+#define SRC_GRAPHICS_STREAM_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <external/GL/gl3w.h>
+
+#include "utils/macros.h"
+#include "utils/status.h"
+
+// Frames the GPU can be behind the CPU before writing waits
+#define RNR_STREAM_BUFFER_FRAMES 3
+// Initial size of each frame region. It grows when a frame needs more.
+#define RNR_STREAM_BUFFER_REGION_SIZE (1024 * 1024)
+
+namespace renoir {
+namespace graphics {
+
+class StreamBuffer {
+ public:
+  StreamBuffer() = default;
+  ~StreamBuffer();
+  DISABLE_COPY(StreamBuffer);
+  DISABLE_MOVE(StreamBuffer);
+
+ public:
+  // Needs a current GL context (3.2 or newer, for the fences)
+  utils::Status Init(size_t region_size = RNR_STREAM_BUFFER_REGION_SIZE);
+  void Shutdown();
+
+  // Moves to the next region, which must hold at least |size| bytes. If it
+  // doesn't, the buffer is recreated bigger, which changes buffer(). If that
+  // fails the old buffer is kept (so Allocate can come up short) and the
+  // next frame tries again.
+  void BeginFrame(size_t size);
+  // Returns where to write |size| bytes, aligned to |alignment| (not
+  // necessarily a power of two) from the start of the buffer, and their
+  // offset in |offset|. Returns nullptr if the region is full.
+  uint8_t *Allocate(size_t size, size_t alignment, size_t *offset);
+  // Makes the writes visible to GL. Must come before the draws that read
+  // them, and no Allocate after it.
+  void FinishWrites();
+  // Fences the region, after the draws that read it
+  void EndFrame();
+
+ public:
+  GLuint buffer() const { return buffer_; }
+  bool persistent() const { return persistent_; }
+  // Bumped every time the buffer is recreated, so users can tell when the
+  // VAOs pointing at it need to be set up again
+  uint32_t generation() const { return generation_; }
+  // Times BeginFrame had to wait for the GPU
+  uint64_t stalls() const { return stalls_; }
+
+ private:
+  utils::Status CreateBuffer(size_t region_size);
+  void DestroyBuffer();
+
+ private:
+  GLuint buffer_ = 0;
+  bool persistent_ = false;
+  size_t region_size_ = 0;
+  // Whole buffer when persistent, the current region otherwise
+  uint8_t *mapping_ = nullptr;
+  GLsync fences_[RNR_STREAM_BUFFER_FRAMES] = {};
+  size_t region_ = 0;
+  // Bytes used in the current region
+  size_t used_ = 0;
+  bool in_frame_ = false;
+  // Between BeginFrame and FinishWrites
+  bool writing_ = false;
+  uint32_t generation_ = 0;
+  uint64_t stalls_ = 0;
+  // Reported to the memory tracking as GL staging
+  size_t tracked_bytes_ = 0;
+};
+
+}   // namespace graphics
+}   // namespace renoir
+
+#endif  // SRC_GRAPHICS_STREAM_BUFFER_H
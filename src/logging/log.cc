@@ -8,48 +8,532 @@
  * @description: TODO(Cristian): Add description
  ******************************************************************************/
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
 
 #include "logging/log.h"
+#include "profiling/profiler.h"
+#include "utils/memory.h"
 
 namespace renoir {
 namespace logging {
 
 using ::renoir::platform::GetThreadContext;
 
-ThreadLocalLogContext::ThreadLocalLogContext() : thread_context(GetThreadContext()) {
-  GlobalLogContext *global_context = GetGlobalLogContext();
-  size_t size = 0;
+namespace {
+
+class StderrLogSink : public LogSink {
+ public:
+  void Consume(const ThreadLocalLogContext& context, const LogEntry& entry) override {
+    FormatLogLine(context.thread_uid, entry, buffer_, sizeof(buffer_));
+    fprintf(stderr, "%s\n", buffer_);
+  }
+
+  void Flush() override {
+    fflush(stderr);
+  }
+
+ private:
+  char buffer_[1024];
+};
+
+struct LogDrain {
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool running = false;
+  // Set while the drain waits for entries. CommitPush stores the write index
+  // before checking it and the drain sets it before checking the indices
+  // (all seq_cst), so either the drain sees the entry or the producer sees
+  // the drain asleep and wakes it.
+  std::atomic<bool> sleeping{false};
+  // Set while the drain lets a burst accumulate. A producer whose ring is
+  // filling up cuts it short (HurryLogDrain).
+  std::atomic<bool> batching{false};
+  StderrLogSink stderr_sink;
+
+  // Drain thread only. Contexts of the current pass (the capacity is kept
+  // between passes) and history chunks allocated so far, out of
+  // RNR_LOG_HISTORY_MAX_CHUNKS.
+  std::vector<ThreadLocalLogContext*> contexts;
+  size_t history_chunks = 0;
+};
+
+LogDrain *GetLogDrain() {
+  static LogDrain drain;
+  return &drain;
+}
+
+// Called by LogHistory::Append, so only from the drain thread.
+// Under the budget it allocates a new chunk. Past it, it takes the chunk of
+// whatever history has the stalest one (the one whose newest entry is the
+// oldest), which every history holding chunks is in |contexts| to offer.
+LogEntry *TakeLogHistoryChunk() {
+  LogDrain *drain = GetLogDrain();
+  if (drain->history_chunks < RNR_LOG_HISTORY_MAX_CHUNKS) {
+    drain->history_chunks++;
+    RNR_MEMORY_TAG(utils::MEMORY_TAG_LOGGING);
+    return new LogEntry[RNR_LOG_HISTORY_CHUNK_ENTRIES];
+  }
+
+  LogHistory *oldest = nullptr;
+  uint64_t oldest_ticks = UINT64_MAX;
+  for (ThreadLocalLogContext *context : drain->contexts) {
+    uint64_t ticks;
+    if (context->history.GetOldestChunkTicks(&ticks) && ticks <= oldest_ticks) {
+      oldest = &context->history;
+      oldest_ticks = ticks;
+    }
+  }
+  return oldest->DropOldestChunk();
+}
+
+void HurryLogDrain() {
+  LogDrain *drain = GetLogDrain();
+  if (drain->batching.load(std::memory_order_relaxed) &&
+      drain->batching.exchange(false, std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> guard(drain->mutex);
+    drain->cv.notify_one();
+  }
+}
+
+// Empties every registered ring into the sinks.
+// We only take up to one ring worth of entries per context, so a thread
+// flooding the log cannot starve the others.
+// The global mutex is only held to snapshot the contexts (which are never
+// freed), so the sink I/O doesn't stall the UI or the threads registering.
+// The sinks mutex is held throughout, so a removed sink is no longer in use.
+size_t DrainLogContexts(GlobalLogContext *global_context) {
+  RNR_PROFILE_SCOPE("Drain log");
+  std::vector<ThreadLocalLogContext*>& contexts = GetLogDrain()->contexts;
   {
     std::lock_guard<std::mutex> guard(global_context->mutex);
-    global_context->log_contexts[thread_context->thread_id] = this;
-    size = global_context->log_contexts.size();
+    contexts.clear();
+    for (auto& it : global_context->log_contexts) {
+      contexts.push_back(it.second);
+    }
+  }
+
+  std::lock_guard<std::mutex> sinks_guard(global_context->sinks_mutex);
+  size_t consumed = 0;
+  LogEntry entry;
+  for (ThreadLocalLogContext *context : contexts) {
+    for (size_t i = 0; i < RNR_THREAD_LOG_ENTRIES; i++) {
+      if (!context->Pop(&entry)) {
+        break;
+      }
+      for (LogSink *sink : global_context->sinks) {
+        sink->Consume(*context, entry);
+      }
+      context->history.Append(entry);
+      consumed++;
+    }
+  }
+
+  if (consumed > 0) {
+    for (LogSink *sink : global_context->sinks) {
+      sink->Flush();
+    }
+  }
+  return consumed;
+}
+
+bool HasPendingLogEntries(GlobalLogContext *global_context) {
+  std::lock_guard<std::mutex> guard(global_context->mutex);
+  for (auto& it : global_context->log_contexts) {
+    ThreadLocalLogContext *context = it.second;
+    if (context->write_index.load(std::memory_order_seq_cst) !=
+        context->read_index.load(std::memory_order_acquire)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void DrainThreadMain() {
+  GetThreadContext()->name = "Log drain";
+  utils::SetThreadMemoryTag(utils::MEMORY_TAG_LOGGING);
+
+  LogDrain *drain = GetLogDrain();
+  GlobalLogContext *global_context = GetGlobalLogContext();
+
+  std::unique_lock<std::mutex> lock(drain->mutex);
+  while (drain->running) {
+    lock.unlock();
+    // If we didn't catch up, go again without sleeping
+    while (DrainLogContexts(global_context) > 0) {}
+
+    // Sleep until something gets logged (see LogDrain::sleeping)
+    drain->sleeping.store(true, std::memory_order_seq_cst);
+    if (HasPendingLogEntries(global_context)) {
+      drain->sleeping.store(false, std::memory_order_relaxed);
+      lock.lock();
+      continue;
+    }
+    lock.lock();
+    drain->cv.wait(lock, [drain]() {
+      return !drain->running || !drain->sleeping.load(std::memory_order_relaxed);
+    });
+
+    // Let the rest of the burst that woke us come in, so we drain it (and
+    // the sinks flush) once instead of per entry
+    drain->batching.store(true, std::memory_order_relaxed);
+    drain->cv.wait_for(lock, std::chrono::milliseconds(RNR_LOG_DRAIN_INTERVAL_MS), [drain]() {
+      return !drain->running || !drain->batching.load(std::memory_order_relaxed);
+    });
+    drain->batching.store(false, std::memory_order_relaxed);
+  }
+  lock.unlock();
+
+  // Whatever got logged while we were shutting down
+  while (DrainLogContexts(global_context) > 0) {}
+}
+
+struct LogModuleRegistry {
+  std::mutex mutex;
+  LogModule *head = nullptr;
+};
+
+LogModuleRegistry *GetLogModuleRegistry() {
+  static LogModuleRegistry registry;
+  return &registry;
+}
+
+}   // namespace
+
+LogModule g_default_log_module("default", LogLevel::LOG_DEBUG);
+
+LogModule::LogModule(const char *name, LogLevel level)
+  : name(name), level((int)level), next(nullptr) {
+  LogModuleRegistry *registry = GetLogModuleRegistry();
+  std::lock_guard<std::mutex> guard(registry->mutex);
+  next = registry->head;
+  registry->head = this;
+}
+
+LogModule *GetLogModules() {
+  LogModuleRegistry *registry = GetLogModuleRegistry();
+  std::lock_guard<std::mutex> guard(registry->mutex);
+  return registry->head;
+}
+
+bool SetLogModuleLevel(const char *name, LogLevel level) {
+  for (LogModule *module = GetLogModules(); module; module = module->next) {
+    if (strcmp(module->name, name) == 0) {
+      module->level.store((int)level, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+ThreadLocalLogContext::ThreadLocalLogContext()
+  : thread_context(GetThreadContext()),
+    thread_uid(thread_context->UID),
+    alive(true),
+    write_index(0),
+    read_index(0),
+    overflow_policy((int)LogOverflowPolicy::RNR_LOG_DEFAULT_OVERFLOW_POLICY),
+    dropped(0),
+    overwritten(0) {}
+
+LogEntry *ThreadLocalLogContext::BeginPush() {
+  // Only we write |write_index|, so relaxed is enough for our own index
+  uint64_t write = write_index.load(std::memory_order_relaxed);
+  uint64_t read = read_index.load(std::memory_order_acquire);
+  LogEntry *slot = &entries[write & (RNR_THREAD_LOG_ENTRIES - 1)];
+  if (write - read >= RNR_THREAD_LOG_ENTRIES / 2) {
+    // Filling up, the drain shouldn't wait for the rest of the burst
+    HurryLogDrain();
+  }
+  if (write - read < RNR_THREAD_LOG_ENTRIES) {
+    return slot;
+  }
+
+  switch (GetOverflowPolicy()) {
+    case LogOverflowPolicy::LOG_OVERFLOW_DROP_NEWEST:
+      break;
+    case LogOverflowPolicy::LOG_OVERFLOW_OVERWRITE_OLDEST:
+      // Drop the oldest entry ourselves. If the CAS fails the drain just
+      // popped it, which frees the slot all the same.
+      if (read_index.compare_exchange_strong(read, read + 1, std::memory_order_acq_rel,
+                                             std::memory_order_acquire)) {
+        overwritten.fetch_add(1, std::memory_order_relaxed);
+      }
+      return slot;
+    case LogOverflowPolicy::LOG_OVERFLOW_BLOCK:
+      if (WaitForSpace(write)) {
+        return slot;
+      }
+      break;
+  }
+
+  dropped.fetch_add(1, std::memory_order_relaxed);
+  return nullptr;
+}
+
+bool ThreadLocalLogContext::WaitForSpace(uint64_t write) {
+  auto IsFull = [this, write]() {
+    return write - read_index.load(std::memory_order_acquire) >= RNR_THREAD_LOG_ENTRIES;
+  };
+
+  for (int i = 0; i < RNR_LOG_BLOCK_SPIN_COUNT; i++) {
+    if (!IsFull()) {
+      return true;
+    }
+    platform::CpuPause();
+  }
+
+  uint64_t deadline = platform::GetTicks() +
+                      platform::NanosecondsToTicks(RNR_LOG_BLOCK_TIMEOUT_US * 1000ull);
+  while (IsFull()) {
+    if (platform::GetTicks() >= deadline) {
+      return false;
+    }
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+void ThreadLocalLogContext::CommitPush() {
+  uint64_t write = write_index.load(std::memory_order_relaxed);
+  write_index.store(write + 1, std::memory_order_seq_cst);
+
+  // Only the first entry after the drain went to sleep pays for waking it
+  LogDrain *drain = GetLogDrain();
+  if (drain->sleeping.load(std::memory_order_seq_cst) &&
+      drain->sleeping.exchange(false, std::memory_order_seq_cst)) {
+    // Under the mutex, so it can't land between the drain's check and wait
+    std::lock_guard<std::mutex> guard(drain->mutex);
+    drain->cv.notify_one();
+  }
+}
+
+bool ThreadLocalLogContext::Push(const LogEntry& entry) {
+  LogEntry *slot = BeginPush();
+  if (!slot) {
+    return false;
+  }
+  *slot = entry;
+  CommitPush();
+  return true;
+}
+
+bool ThreadLocalLogContext::Pop(LogEntry *out) {
+  uint64_t read = read_index.load(std::memory_order_acquire);
+  while (true) {
+    uint64_t write = write_index.load(std::memory_order_acquire);
+    if (read == write) {
+      return false;
+    }
+
+    *out = entries[read & (RNR_THREAD_LOG_ENTRIES - 1)];
+    // If the producer overwrote this entry while we copied it, the CAS fails
+    // (loading the new oldest index into |read|) and we go again.
+    if (read_index.compare_exchange_strong(read, read + 1, std::memory_order_acq_rel,
+                                           std::memory_order_acquire)) {
+      return true;
+    }
+  }
+}
+
+LogHistory::~LogHistory() {
+  for (auto& chunk : chunks) {
+    delete[] chunk.load(std::memory_order_relaxed);
   }
 }
 
+void LogHistory::Append(const LogEntry& entry) {
+  uint64_t index = count.load(std::memory_order_relaxed);
+  uint64_t chunk_index = index / RNR_LOG_HISTORY_CHUNK_ENTRIES;
+  std::atomic<LogEntry*>& slot = chunks[chunk_index % RNR_LOG_HISTORY_MAX_CHUNKS];
+  LogEntry *chunk = slot.load(std::memory_order_relaxed);
+  if (index % RNR_LOG_HISTORY_CHUNK_ENTRIES == 0 && chunk) {
+    // We hold the whole budget and the slot has our oldest chunk
+    chunk = DropOldestChunk();
+  }
+  if (!chunk) {
+    // Either a new chunk, or the current one was taken by another history
+    chunk = TakeLogHistoryChunk();
+  }
+
+  chunk[index % RNR_LOG_HISTORY_CHUNK_ENTRIES] = entry;
+  slot.store(chunk, std::memory_order_relaxed);
+  // Publishes both the entry and the chunk pointer
+  count.store(index + 1, std::memory_order_release);
+}
+
+bool LogHistory::GetOldestChunkTicks(uint64_t *ticks) const {
+  uint64_t begin = first.load(std::memory_order_relaxed);
+  uint64_t end = count.load(std::memory_order_relaxed);
+  if (begin == end) {
+    return false;
+  }
+  uint64_t chunk_end = (begin / RNR_LOG_HISTORY_CHUNK_ENTRIES + 1) * RNR_LOG_HISTORY_CHUNK_ENTRIES;
+  uint64_t newest = std::min(chunk_end, end) - 1;
+  const LogEntry *chunk = chunks[(newest / RNR_LOG_HISTORY_CHUNK_ENTRIES) %
+                                 RNR_LOG_HISTORY_MAX_CHUNKS].load(std::memory_order_relaxed);
+  *ticks = chunk[newest % RNR_LOG_HISTORY_CHUNK_ENTRIES].ticks;
+  return true;
+}
+
+LogEntry *LogHistory::DropOldestChunk() {
+  uint64_t begin = first.load(std::memory_order_relaxed);
+  uint64_t end = count.load(std::memory_order_relaxed);
+  uint64_t chunk_index = begin / RNR_LOG_HISTORY_CHUNK_ENTRIES;
+  // If it's the chunk being filled, every entry goes and the rest of them
+  // will land in a new chunk
+  uint64_t new_first = std::min((chunk_index + 1) * RNR_LOG_HISTORY_CHUNK_ENTRIES, end);
+
+  // Readers have to see the entries dropped before anything is written over
+  // them (see Read)
+  first.store(new_first, std::memory_order_relaxed);
+  discarded.fetch_add(new_first - begin, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  return chunks[chunk_index % RNR_LOG_HISTORY_MAX_CHUNKS].exchange(nullptr,
+                                                                    std::memory_order_relaxed);
+}
+
 GlobalLogContext *GetGlobalLogContext() {
   static GlobalLogContext global_context;
   return &global_context;
 }
 
-void Log(const LogLevel& level, const char *filename, size_t line,
-                const char *fmt, ...) {
-  PROCESS_VARGLIST(msg_buffer, 1024, fmt);
-  LogEntry entry = CreateLogEntry(level, filename, line, msg_buffer);
+ThreadLocalLogContext *RegisterThreadLocalLogContext() {
+  RNR_MEMORY_TAG(utils::MEMORY_TAG_LOGGING);
+  ThreadLocalLogContext *context = new ThreadLocalLogContext();
+
+  GlobalLogContext *global_context = GetGlobalLogContext();
+  std::lock_guard<std::mutex> guard(global_context->mutex);
+  global_context->log_contexts[context->thread_uid] = context;
+  return context;
+}
+
+void UnregisterThreadLocalLogContext(ThreadLocalLogContext *context) {
+  // We don't remove it from the map, as there could be pending entries.
+  // Readers check |alive| and use the thread context under the mutex, so
+  // it has to be cleared under it too.
+  GlobalLogContext *global_context = GetGlobalLogContext();
+  std::lock_guard<std::mutex> guard(global_context->mutex);
+  context->exited_name = context->thread_context->name;
+  context->alive.store(false, std::memory_order_release);
+}
 
-  ThreadLocalLogContext *context = GetLocalLogContext();
+size_t FormatLogEntry(const LogEntry& entry, char *out, size_t out_size) {
+  if (entry.deferred) {
+    return FormatLogArgs(entry.fmt, entry.data, entry.data_len, out, out_size);
+  }
 
-  // We write into the write index
-  context->entries[context->write_index] = entry;
-  context->write_index = (context->write_index + 1) % sizeof(context->entries);
+  if (out_size == 0) {
+    return 0;
+  }
+  size_t len = entry.data_len < out_size - 1 ? entry.data_len : out_size - 1;
+  memcpy(out, entry.data, len);
+  out[len] = '\0';
+  return len;
+}
 
-  if (context->write_index == context->read_index) {
-    context->read_index = (context->read_index + 1) % sizeof(context->entries);
+size_t FormatLogLine(size_t thread_uid, const LogEntry& entry, char *out, size_t out_size) {
+  if (out_size == 0) {
+    return 0;
   }
 
-  fprintf(stderr, "LOG: %s\n", msg_buffer);
-};
+  time_t time;
+  size_t us;
+  platform::TicksToWallClock(entry.ticks, &time, &us);
+  // Called from several threads, so we need the reentrant versions
+  struct tm local_time;
+#ifdef _WIN32
+  localtime_s(&local_time, &time);
+#else
+  localtime_r(&time, &local_time);
+#endif
+  char time_buffer[32];
+  strftime(time_buffer, sizeof(time_buffer), "%H:%M:%S", &local_time);
+
+  // Only the basename, full paths just make noise
+  const char *filename = entry.filename;
+  for (const char *c = entry.filename; *c; c++) {
+    if (*c == '/' || *c == '\\') {
+      filename = c + 1;
+    }
+  }
 
+  int written = snprintf(out, out_size, "[%s.%06zu][T%zu][%-5s] %s:%zu: ",
+                         time_buffer, us, thread_uid, GetLogLevelShortName(entry.level),
+                         filename, entry.line);
+  if (written < 0) {
+    out[0] = '\0';
+    return 0;
+  }
+  size_t len = (size_t)written;
+  if (len >= out_size - 1) {
+    return out_size - 1;
+  }
+  return len + FormatLogEntry(entry, out + len, out_size - len);
+}
+
+const char *GetLogLevelShortName(LogLevel level) {
+  switch (level) {
+    case LogLevel::LOG_FATAL: return "FATAL";
+    case LogLevel::LOG_ERROR: return "ERROR";
+    case LogLevel::LOG_WARN: return "WARN";
+    case LogLevel::LOG_INFO: return "INFO";
+    case LogLevel::LOG_DEBUG: return "DEBUG";
+  }
+  return "?";
+}
 
+void StartLogDrainThread(bool log_to_stderr) {
+  // Make sure the calibration is taken before the sinks need it
+  platform::GetClockCalibration();
+
+  LogDrain *drain = GetLogDrain();
+  {
+    std::lock_guard<std::mutex> guard(drain->mutex);
+    if (drain->running) {
+      return;
+    }
+    drain->running = true;
+    drain->sleeping.store(false, std::memory_order_relaxed);
+  }
+
+  if (log_to_stderr) {
+    AddLogSink(&drain->stderr_sink);
+  }
+  drain->thread = std::thread(DrainThreadMain);
+}
+
+void StopLogDrainThread() {
+  LogDrain *drain = GetLogDrain();
+  {
+    std::lock_guard<std::mutex> guard(drain->mutex);
+    if (!drain->running) {
+      return;
+    }
+    drain->running = false;
+  }
+  drain->cv.notify_one();
+  drain->thread.join();
+
+  RemoveLogSink(&drain->stderr_sink);
+}
+
+void AddLogSink(LogSink *sink) {
+  GlobalLogContext *global_context = GetGlobalLogContext();
+  std::lock_guard<std::mutex> guard(global_context->sinks_mutex);
+  global_context->sinks.push_back(sink);
+}
+
+void RemoveLogSink(LogSink *sink) {
+  GlobalLogContext *global_context = GetGlobalLogContext();
+  std::lock_guard<std::mutex> guard(global_context->sinks_mutex);
+  auto& sinks = global_context->sinks;
+  sinks.erase(std::remove(sinks.begin(), sinks.end(), sink), sinks.end());
+}
 
 
 }   // namespace logging
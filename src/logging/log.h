@@ -11,81 +11,515 @@
 #ifndef SRC_LOGGING_LOG_H
 #define SRC_LOGGING_LOG_H
 
-#include <chrono>
+#include <atomic>
+#include <cstdint>
 #include <cstdio>
 #include <string>
 #include <thread>
+#include <type_traits>
 #include <map>
 #include <mutex>
+#include <vector>
 
+#include "logging/log_format.h"
 #include "utils/macros.h"
 #include "utils/printable_enum.h"
+#include "platform/clock.h"
 #include "platform/thread.h"
 
+// Must be a power of two, as indices are masked into the ring
 #define RNR_THREAD_LOG_ENTRIES 2048
+// The drain thread sleeps until something is logged, then waits this long
+// for the rest of the burst before emptying the rings
+#define RNR_LOG_DRAIN_INTERVAL_MS 2
+// Retained history, kept in chunks of entries. The chunks of every thread
+// share one budget: past it the oldest chunk of any thread is dropped and its
+// memory reused, so the total doesn't grow with the amount of threads.
+#define RNR_LOG_HISTORY_CHUNK_ENTRIES 4096
+#ifndef RNR_LOG_HISTORY_BUDGET_BYTES
+#define RNR_LOG_HISTORY_BUDGET_BYTES (64 << 20)
+#endif
+// Inline storage per entry, for either the encoded arguments or the message
+#define RNR_LOG_ENTRY_DATA_SIZE 192
+// Overflow policy of new threads (see LogOverflowPolicy)
+#ifndef RNR_LOG_DEFAULT_OVERFLOW_POLICY
+#define RNR_LOG_DEFAULT_OVERFLOW_POLICY LOG_OVERFLOW_DROP_NEWEST
+#endif
+// LOG_OVERFLOW_BLOCK: pause-spins before yielding, and how long a producer
+// waits for the drain at most before dropping the entry
+#define RNR_LOG_BLOCK_SPIN_COUNT 256
+#define RNR_LOG_BLOCK_TIMEOUT_US 5000
+// Whether the Log front-end defers the formatting to the consumers
+#ifndef RNR_LOG_DEFERRED_FORMAT
+#define RNR_LOG_DEFERRED_FORMAT 1
+#endif
+
+// Numeric values of LogLevel, so the preprocessor can compare them.
+// Higher is more verbose.
+#define RNR_LOG_LEVEL_FATAL 0
+#define RNR_LOG_LEVEL_ERROR 1
+#define RNR_LOG_LEVEL_WARN  2
+#define RNR_LOG_LEVEL_INFO  3
+#define RNR_LOG_LEVEL_DEBUG 4
+
+// Most verbose level that gets compiled in. RNR_LOG_* calls above it are
+// removed entirely (their arguments are not even evaluated).
+#ifndef RNR_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define RNR_LOG_MIN_LEVEL RNR_LOG_LEVEL_INFO
+#else
+#define RNR_LOG_MIN_LEVEL RNR_LOG_LEVEL_DEBUG
+#endif
+#endif
 
 namespace renoir {
 namespace logging {
 
+static_assert((RNR_THREAD_LOG_ENTRIES & (RNR_THREAD_LOG_ENTRIES - 1)) == 0,
+              "RNR_THREAD_LOG_ENTRIES must be a power of two");
+
 PRINTABLE_ENUM(LogLevel, LOG_FATAL, LOG_ERROR, LOG_WARN,
                          LOG_INFO, LOG_DEBUG);
 
+static_assert(LogLevel::LOG_FATAL == RNR_LOG_LEVEL_FATAL &&
+              LogLevel::LOG_ERROR == RNR_LOG_LEVEL_ERROR &&
+              LogLevel::LOG_WARN == RNR_LOG_LEVEL_WARN &&
+              LogLevel::LOG_INFO == RNR_LOG_LEVEL_INFO &&
+              LogLevel::LOG_DEBUG == RNR_LOG_LEVEL_DEBUG,
+              "RNR_LOG_LEVEL_* must match LogLevel");
+
+/**
+ * What Log() does when the calling thread's ring is full.
+ * - DROP_NEWEST: the new entry is discarded (counted in |dropped|).
+ * - OVERWRITE_OLDEST: the oldest pending entry is discarded to make room
+ *   (counted in |overwritten|). Keeps the most recent history.
+ * - BLOCK: waits for the drain thread, spinning RNR_LOG_BLOCK_SPIN_COUNT
+ *   times and then yielding. After RNR_LOG_BLOCK_TIMEOUT_US it gives up and
+ *   drops the entry, so the producer latency stays bounded.
+ */
+PRINTABLE_ENUM(LogOverflowPolicy, LOG_OVERFLOW_DROP_NEWEST, LOG_OVERFLOW_OVERWRITE_OLDEST,
+                                  LOG_OVERFLOW_BLOCK);
+
+/**
+ * Runtime level for a group of log calls. The RNR_LOG_* macros check it with
+ * a single relaxed load before evaluating any argument.
+ * Modules must have static storage (see RNR_LOG_DEFINE_MODULE) and register
+ * themselves in an intrusive list on construction.
+ */
+struct LogModule {
+  const char *name;
+  std::atomic<int> level;
+  LogModule *next;
+
+ public:
+  LogModule(const char *name, LogLevel level = LogLevel::LOG_INFO);
+  DISABLE_COPY(LogModule);
+  DISABLE_MOVE(LogModule);
+
+ public:
+  bool IsEnabled(int level_value) const {
+    return level.load(std::memory_order_relaxed) >= level_value;
+  }
+};
+
+// Used by every RNR_LOG_* call that doesn't set RNR_LOG_MODULE
+extern LogModule g_default_log_module;
+
+// Head of the list of registered modules (follow LogModule::next)
+LogModule *GetLogModules();
+// Returns false if there is no module called |name|
+bool SetLogModuleLevel(const char *name, LogLevel level);
+
+/**
+ * POD entry so that logging never touches the heap.
+ * |filename| and |fmt| are not copied, so they must point to static storage
+ * (__FILE__ and string literals).
+ *
+ * If |deferred| is set, |data| holds the arguments encoded by EncodeLogArgs
+ * and the message only gets formatted when someone reads it (FormatLogEntry).
+ * Otherwise |data| holds the already formatted, null terminated message.
+ * Either way, whatever didn't fit in |data| is dropped and |truncated| is set.
+ */
 struct LogEntry {
   LogLevel level;
-  std::string filename;
-  std::string msg;
+  bool deferred;
+  bool truncated;
+  uint16_t data_len;
   size_t line;
-  time_t time;
-  size_t us;
-};  
+  const char *filename;
+  const char *fmt;
+  // Raw monotonic tick (platform::GetTicks). Convert with
+  // platform::TicksToWallClock when displaying.
+  uint64_t ticks;
+  uint8_t data[RNR_LOG_ENTRY_DATA_SIZE];
+};
+
+static_assert(std::is_trivially_copyable<LogEntry>::value,
+              "LogEntry must stay POD to be copied in and out of the rings");
+
+// Chunks that fit in the history budget, which is also the most a single
+// thread can hold (~1 MB each)
+#define RNR_LOG_HISTORY_MAX_CHUNKS \
+  (RNR_LOG_HISTORY_BUDGET_BYTES / (RNR_LOG_HISTORY_CHUNK_ENTRIES * sizeof(::renoir::logging::LogEntry)))
+
+static_assert(RNR_LOG_HISTORY_MAX_CHUNKS >= 2,
+              "RNR_LOG_HISTORY_BUDGET_BYTES must fit at least two history chunks");
+
+/**
+ * Store of the last entries a thread logged, filled by the drain thread (the
+ * only writer) as it empties the ring.
+ * Entries live in fixed chunks referenced by a fixed table, used as a ring.
+ * Chunks come from the budget shared by every history: once it is used up,
+ * the history whose oldest chunk is the stalest (any thread's, including
+ * this one) drops it (its entries are counted in |discarded|) and the memory
+ * is reused. Indices are monotonic, the retained ones are [First(), Count()).
+ * Any thread can read entries without locking. Read copies the entry and
+ * then checks that it wasn't dropped meanwhile (seqlock-style validation),
+ * so a reader racing with the writer gets false instead of a torn entry.
+ */
+struct LogHistory {
+  // Null until the chunk is used, and again once it is taken by another
+  // history
+  std::atomic<LogEntry*> chunks[RNR_LOG_HISTORY_MAX_CHUNKS] = {};
+  std::atomic<uint64_t> count;
+  // Oldest retained index
+  std::atomic<uint64_t> first;
+  std::atomic<uint64_t> discarded;
 
+ public:
+  LogHistory() : count(0), first(0), discarded(0) {}
+  ~LogHistory();
+  DISABLE_COPY(LogHistory);
+  DISABLE_MOVE(LogHistory);
+
+ public:
+  // Writer (drain thread) only
+  void Append(const LogEntry& entry);
+  // Writer only. Ticks of the newest entry in the oldest chunk, or false if
+  // there is no chunk to drop.
+  bool GetOldestChunkTicks(uint64_t *ticks) const;
+  // Writer only. Drops the oldest chunk and returns its memory.
+  LogEntry *DropOldestChunk();
+
+  uint64_t Count() const {
+    return count.load(std::memory_order_acquire);
+  }
+
+  uint64_t First() const {
+    return first.load(std::memory_order_acquire);
+  }
+
+  // |index| must be below a value returned by Count(). Returns false if the
+  // entry was dropped, in which case |out| holds garbage.
+  bool Read(uint64_t index, LogEntry *out) const {
+    if (index < First()) {
+      return false;
+    }
+    const LogEntry *chunk =
+        chunks[(index / RNR_LOG_HISTORY_CHUNK_ENTRIES) % RNR_LOG_HISTORY_MAX_CHUNKS].load(
+            std::memory_order_acquire);
+    if (!chunk) {
+      return false;
+    }
+    *out = chunk[index % RNR_LOG_HISTORY_CHUNK_ENTRIES];
+    // Pairs with the fence in Append: if we copied anything the writer wrote
+    // over the entry, we see the |first| that dropped it.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return index >= first.load(std::memory_order_relaxed);
+  }
+};
+
+/**
+ * Single-producer/single-consumer ring of log entries.
+ * The owning thread is the only producer and the log drain thread is the
+ * only consumer. Indices are monotonic (never wrapped) and are masked into
+ * |entries| on access, so |write_index - read_index| is always the amount
+ * of pending entries.
+ *
+ * The producer publishes an entry with a release store of |write_index| and
+ * the consumer frees a slot by advancing |read_index|, so each side only
+ * needs an acquire load of the other side's index.
+ *
+ * With LOG_OVERFLOW_OVERWRITE_OLDEST the producer can also advance
+ * |read_index| (dropping the oldest entry), so both sides move it with a CAS.
+ * The consumer copies the entry out before its CAS; if the CAS fails the
+ * slot may have been rewritten mid-copy and the copy is thrown away
+ * (seqlock-style validation).
+ */
 struct ThreadLocalLogContext {
-  bool init = false;
+  // Only valid while |alive| is set. Use thread_name() for the name.
   platform::ThreadContext *thread_context;
-  size_t read_index;
-  size_t write_index;
+  size_t thread_uid;
+  // Cleared when the owning thread exits, under the global context mutex and
+  // before the thread context is destroyed. The context is kept around so
+  // the drain thread can empty it and the UI can still show it.
+  std::atomic<bool> alive;
+  // Name of the thread when it exited. Guarded by the global context mutex.
+  std::string exited_name;
+
+  // Each index is written by only one side, so we keep them in separate
+  // cache lines to avoid false sharing between producer and consumer.
+  // (Padding instead of alignas, as C++11 new ignores extended alignment)
+  char padding0[64];
+  std::atomic<uint64_t> write_index;
+  char padding1[64 - sizeof(std::atomic<uint64_t>)];
+  std::atomic<uint64_t> read_index;
+  char padding2[64 - sizeof(std::atomic<uint64_t>)];
   LogEntry entries[RNR_THREAD_LOG_ENTRIES];
 
+  // LogOverflowPolicy. Can be changed from any thread.
+  std::atomic<int> overflow_policy;
+  // Only the producer increments them, anyone can read them
+  std::atomic<uint64_t> dropped;
+  std::atomic<uint64_t> overwritten;
+
+  // Everything popped from the ring ends up here
+  LogHistory history;
+
  public:
-  // Registers the thread local log context
   ThreadLocalLogContext();
-};  
+  DISABLE_COPY(ThreadLocalLogContext);
+  DISABLE_MOVE(ThreadLocalLogContext);
+
+ public:
+  // Producer side. Returns the slot to fill in place or nullptr if the ring
+  // is full and the policy discarded the entry. The entry is only visible to
+  // the consumer after CommitPush.
+  LogEntry *BeginPush();
+  void CommitPush();
+  // Producer side. Returns false if the entry was discarded.
+  bool Push(const LogEntry& entry);
+  // Consumer side. Returns false if there are no pending entries.
+  bool Pop(LogEntry *out);
+
+  // The global context mutex must be held, it keeps the thread context alive
+  const char *thread_name() const {
+    return alive.load(std::memory_order_acquire) ? thread_context->name.c_str()
+                                                 : exited_name.c_str();
+  }
+
+  LogOverflowPolicy GetOverflowPolicy() const {
+    return (LogOverflowPolicy::InternalEnum)overflow_policy.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // BLOCK policy. Returns false if the drain didn't make room in time.
+  bool WaitForSpace(uint64_t write);
+};
+
+/**
+ * Destination for log entries. Sinks are only ever called from the log drain
+ * thread, so they can do blocking I/O without stalling the threads that log.
+ */
+class LogSink {
+ public:
+  virtual ~LogSink() = default;
+  virtual void Consume(const ThreadLocalLogContext& context, const LogEntry& entry) = 0;
+  // Called after every drain pass that consumed at least one entry.
+  virtual void Flush() {}
+};
 
 struct GlobalLogContext {
-  std::map<std::thread::id, ThreadLocalLogContext*> log_contexts;
+  // Keyed by ThreadContext::UID, as std::thread::id values can be reused
+  // once a thread exits.
+  std::map<size_t, ThreadLocalLogContext*> log_contexts;
+  // Guards |log_contexts|. Only held briefly, the UI takes it every frame.
   std::mutex mutex;
-};  
-
-inline ThreadLocalLogContext* GetLocalLogContext() {
-  thread_local ThreadLocalLogContext context = {};
-  return &context;
+  // Guards |sinks|. The drain holds it while the sinks do their I/O.
+  std::mutex sinks_mutex;
+  std::vector<LogSink*> sinks;
+  // Entries a sink couldn't write (eg. the log file failing to rotate)
+  std::atomic<uint64_t> sink_dropped{0};
 };
 
 GlobalLogContext *GetGlobalLogContext();
 
-inline LogEntry CreateLogEntry(const LogLevel& level, const char *filename, size_t line,
-                               const char *msg) {
-  LogEntry entry = {};
-  entry.level = level;
-  entry.filename = filename;
-  entry.line = line;
-  entry.msg = msg;
-
-  using Clock = std::chrono::system_clock;
-  auto now = Clock::now();
-  auto seconds = std::chrono::time_point_cast<std::chrono::seconds>(now);
-  entry.time = Clock::to_time_t(now);
-  entry.us = (size_t)std::chrono::duration_cast<std::chrono::microseconds>(now - seconds).count();
-
-  return entry;
+// Allocates and registers a new context in the global context.
+// Contexts are never freed, as the drain thread might still be reading them.
+ThreadLocalLogContext *RegisterThreadLocalLogContext();
+void UnregisterThreadLocalLogContext(ThreadLocalLogContext *context);
+
+namespace internal {
+
+// The thread local holder makes the ring live in stable memory and lets us
+// find out when the owning thread goes away.
+struct ThreadLocalLogContextHolder {
+  ThreadLocalLogContext *context;
+
+  ThreadLocalLogContextHolder() : context(RegisterThreadLocalLogContext()) {}
+  ~ThreadLocalLogContextHolder() { UnregisterThreadLocalLogContext(context); }
 };
 
-void Log(const LogLevel& level, const char *filename, size_t line, const char *fmt, ...);
+}   // namespace internal
+
+inline ThreadLocalLogContext* GetLocalLogContext() {
+  thread_local internal::ThreadLocalLogContextHolder holder;
+  return holder.context;
+};
+
+// Only affects the calling thread
+inline void SetLogOverflowPolicy(LogOverflowPolicy policy) {
+  GetLocalLogContext()->overflow_policy.store((int)policy, std::memory_order_relaxed);
+}
+
+// Fills everything but the data
+inline void InitLogEntry(LogEntry *entry, const LogLevel& level, const char *filename,
+                         size_t line, const char *fmt) {
+  entry->level = level;
+  entry->deferred = false;
+  entry->truncated = false;
+  entry->data_len = 0;
+  entry->filename = filename;
+  entry->line = line;
+  entry->fmt = fmt;
+  entry->ticks = platform::GetTicks();
+}
+
+// Stores the result of a snprintf-like call into |data_len| and |truncated|.
+inline void SetLogEntryMsgLength(LogEntry *entry, int written) {
+  if (written < 0) {
+    written = 0;
+  }
+  entry->truncated = (size_t)written >= sizeof(entry->data);
+  entry->data_len = (uint16_t)(entry->truncated ? sizeof(entry->data) - 1 : (size_t)written);
+}
+
+// Writes the final message of |entry| into |out|, formatting it if it was
+// deferred. Returns the amount of characters written.
+size_t FormatLogEntry(const LogEntry& entry, char *out, size_t out_size);
+
+// Like FormatLogEntry, but prefixed with the wall-clock time, thread, level
+// and source location. This is what sinks and the log window show.
+size_t FormatLogLine(size_t thread_uid, const LogEntry& entry, char *out, size_t out_size);
+
+// "FATAL", "ERROR", "WARN", "INFO" or "DEBUG"
+const char *GetLogLevelShortName(LogLevel level);
+
+/**
+ * Log front-end. |fmt| must be a string literal (it's stored as a pointer).
+ * With RNR_LOG_DEFERRED_FORMAT only the raw arguments are copied into the
+ * ring, so the cost on the calling thread is a few stores. Strings arguments
+ * are copied, so they don't need to outlive the call.
+ * What happens when the ring is full depends on the thread's
+ * LogOverflowPolicy; none of them blocks the calling thread for more than
+ * RNR_LOG_BLOCK_TIMEOUT_US.
+ */
+template <typename... Args>
+void Log(const LogLevel& level, const char *filename, size_t line, const char *fmt,
+         Args... args) {
+  ThreadLocalLogContext *context = GetLocalLogContext();
+  LogEntry *entry = context->BeginPush();
+  if (!entry) {
+    return;
+  }
+
+  // We write straight into the ring slot
+  InitLogEntry(entry, level, filename, line, fmt);
+#if RNR_LOG_DEFERRED_FORMAT
+  entry->deferred = true;
+  entry->data_len = (uint16_t)EncodeLogArgs(entry->data, sizeof(entry->data),
+                                            &entry->truncated, args...);
+#else
+  int written = snprintf((char*)entry->data, sizeof(entry->data), fmt, args...);
+  SetLogEntryMsgLength(entry, written);
+#endif
+
+  context->CommitPush();
+}
+
+// The drain thread owns all the sink I/O. Entries logged while it is not
+// running stay in the rings until it is started.
+// Starting the drain registers the default stderr sink, unless told not to
+// (eg. benchmarks, which don't want to measure the terminal).
+void StartLogDrainThread(bool log_to_stderr = true);
+// Drains every ring one last time and joins the thread.
+void StopLogDrainThread();
+
+// Sinks are not owned and must outlive the drain thread.
+void AddLogSink(LogSink *sink);
+void RemoveLogSink(LogSink *sink);
+
+// Never called. Only there so the compiler checks the format of the
+// RNR_LOG_* calls against their arguments.
+inline void PRINTF_FORMAT_ATTRIBUTE(1, 2) CheckLogFormat(const char *, ...) {}
 
 
 }   // namespace logging
 }   // namespace renoir
 
+/**
+ * LOG MACROS
+ *
+ * RNR_LOG_<LEVEL>(fmt, ...) logs into the RNR_LOG_MODULE module, which
+ * defaults to the global one. To log into another module, define it once in a
+ * .cc and set RNR_LOG_MODULE before including this header:
+ *
+ *  // renderer.cc
+ *  #define RNR_LOG_MODULE RNR_LOG_MODULE_NAME(renderer)
+ *  #include "logging/log.h"
+ *
+ *  RNR_LOG_DEFINE_MODULE(renderer, LOG_WARN);
+ *
+ * Levels above RNR_LOG_MIN_LEVEL compile to nothing. The rest cost a relaxed
+ * load and a compare when the module level filters them out.
+ */
+#define RNR_LOG_MODULE_NAME(module_name) COMBINE(g_log_module_, module_name)
+
+#define RNR_LOG_DEFINE_MODULE(module_name, level) \
+  ::renoir::logging::LogModule RNR_LOG_MODULE_NAME(module_name)( \
+      #module_name, ::renoir::logging::LogLevel::level)
+
+#define RNR_LOG_DECLARE_MODULE(module_name) \
+  extern ::renoir::logging::LogModule RNR_LOG_MODULE_NAME(module_name)
+
+#ifndef RNR_LOG_MODULE
+#define RNR_LOG_MODULE ::renoir::logging::g_default_log_module
+#endif
+
+#define RNR_LOG_IMPL(level, ...)                                              \
+  do {                                                                        \
+    if (RNR_LOG_MODULE.IsEnabled(::renoir::logging::LogLevel::level)) {       \
+      ::renoir::logging::Log(::renoir::logging::LogLevel::level,              \
+                             __FILE__, __LINE__, __VA_ARGS__);                \
+    }                                                                         \
+    if (false) {                                                              \
+      ::renoir::logging::CheckLogFormat(__VA_ARGS__);                         \
+    }                                                                         \
+  } while (false)
+
+#define RNR_LOG_DISABLED(...)                                                 \
+  do {                                                                        \
+    if (false) {                                                              \
+      ::renoir::logging::CheckLogFormat(__VA_ARGS__);                         \
+    }                                                                         \
+  } while (false)
+
+#define RNR_LOG_FATAL(...) RNR_LOG_IMPL(LOG_FATAL, __VA_ARGS__)
+
+#if RNR_LOG_MIN_LEVEL >= RNR_LOG_LEVEL_ERROR
+#define RNR_LOG_ERROR(...) RNR_LOG_IMPL(LOG_ERROR, __VA_ARGS__)
+#else
+#define RNR_LOG_ERROR(...) RNR_LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if RNR_LOG_MIN_LEVEL >= RNR_LOG_LEVEL_WARN
+#define RNR_LOG_WARN(...) RNR_LOG_IMPL(LOG_WARN, __VA_ARGS__)
+#else
+#define RNR_LOG_WARN(...) RNR_LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if RNR_LOG_MIN_LEVEL >= RNR_LOG_LEVEL_INFO
+#define RNR_LOG_INFO(...) RNR_LOG_IMPL(LOG_INFO, __VA_ARGS__)
+#else
+#define RNR_LOG_INFO(...) RNR_LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if RNR_LOG_MIN_LEVEL >= RNR_LOG_LEVEL_DEBUG
+#define RNR_LOG_DEBUG(...) RNR_LOG_IMPL(LOG_DEBUG, __VA_ARGS__)
+#else
+#define RNR_LOG_DEBUG(...) RNR_LOG_DISABLED(__VA_ARGS__)
+#endif
+
 
 
 #endif  // SRC_LOGGING_LOG_H
@@ -0,0 +1,303 @@
+/******************************************************************************
+ * @file: log_file.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-16
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include "logging/log_file.h"
+
+namespace renoir {
+namespace logging {
+
+using ::renoir::utils::CreateStatus;
+using ::renoir::utils::IsStatusOk;
+using ::renoir::utils::Status;
+using ::renoir::utils::StatusKind;
+
+namespace {
+
+inline size_t AlignRecordSize(size_t size) {
+  return (size + 7) & ~(size_t)7;
+}
+
+inline uint32_t Fnv1a(uint32_t hash, const void *data, size_t size) {
+  const uint8_t *bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Everything after |checksum| in the header, plus the payload
+uint32_t ComputeRecordChecksum(const LogRecordHeader *header) {
+  const uint8_t *begin = (const uint8_t*)header + offsetof(LogRecordHeader, ticks);
+  size_t payload = (size_t)header->filename_len + header->fmt_len + header->data_len;
+  return Fnv1a(2166136261u, begin, sizeof(LogRecordHeader) - offsetof(LogRecordHeader, ticks) +
+                                   payload);
+}
+
+std::string GetRotatedPath(const std::string& path, size_t index) {
+  if (index == 0) {
+    return path;
+  }
+  return path + "." + std::to_string(index);
+}
+
+bool FileExists(const std::string& path) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+  fclose(file);
+  return true;
+}
+
+}   // namespace
+
+/**
+ * FileLogSink
+ */
+
+FileLogSink::FileLogSink(std::string path, size_t file_size, size_t file_count)
+    : path_(std::move(path)),
+      file_size_(file_size),
+      file_count_(file_count > 0 ? file_count : 1) {}
+
+FileLogSink::~FileLogSink() {
+  Close();
+}
+
+Status FileLogSink::Open() {
+  if (file_size_ <= sizeof(LogFileHeader) + sizeof(LogRecordHeader)) {
+    return CreateStatus(StatusKind::STATUS_ERROR, "Log file size %zu is too small", file_size_);
+  }
+  if (file_.data) {
+    return {};
+  }
+  // Creating the file truncates it. The log of the last run (which might
+  // have crashed) moves to path.1 instead.
+  ShiftFiles();
+  return CreateFile();
+}
+
+void FileLogSink::Close() {
+  if (file_.data) {
+    platform::FlushMappedFile(&file_);
+    platform::CloseMappedFile(&file_);
+  }
+}
+
+Status FileLogSink::CreateFile() {
+  Status status = platform::CreateMappedFile(path_.c_str(), file_size_, &file_);
+  if (!IsStatusOk(status)) {
+    return status;
+  }
+
+  const platform::ClockCalibration& calibration = platform::GetClockCalibration();
+  LogFileHeader *header = (LogFileHeader*)file_.data;
+  header->magic = RNR_LOG_FILE_MAGIC;
+  header->version = RNR_LOG_FILE_VERSION;
+  header->file_size = file_size_;
+  header->base_ticks = calibration.base_ticks;
+  header->base_wall_ns = calibration.base_wall_ns;
+  header->ticks_per_second = calibration.ticks_per_second;
+  write_offset_ = sizeof(LogFileHeader);
+  return {};
+}
+
+void FileLogSink::ShiftFiles() {
+  // path.N-1 falls off, the rest move one up. Missing ones are skipped.
+  std::remove(GetRotatedPath(path_, file_count_ - 1).c_str());
+  for (size_t i = file_count_ - 1; i > 0; i--) {
+    std::rename(GetRotatedPath(path_, i - 1).c_str(), GetRotatedPath(path_, i).c_str());
+  }
+}
+
+bool FileLogSink::Rotate() {
+  Close();
+  ShiftFiles();
+  Status status = CreateFile();
+  if (!IsStatusOk(status)) {
+    fprintf(stderr, "Could not rotate log file: %s\n", status.context.msg.c_str());
+    retry_ticks_ = platform::GetTicks() +
+                   platform::NanosecondsToTicks(RNR_LOG_FILE_RETRY_MS * 1000000ull);
+    return false;
+  }
+  return true;
+}
+
+bool FileLogSink::RetryRotate() {
+  if (platform::GetTicks() < retry_ticks_) {
+    return false;
+  }
+  // If the file couldn't be moved out of the way last time, it still has to
+  // be. Otherwise creating it is all that's left.
+  if (FileExists(path_)) {
+    ShiftFiles();
+  }
+  Status status = CreateFile();
+  if (!IsStatusOk(status)) {
+    retry_ticks_ = platform::GetTicks() +
+                   platform::NanosecondsToTicks(RNR_LOG_FILE_RETRY_MS * 1000000ull);
+    return false;
+  }
+  retry_ticks_ = 0;
+  fprintf(stderr, "Log file rotated again, %llu records dropped so far\n",
+          (unsigned long long)dropped_.load(std::memory_order_relaxed));
+  return true;
+}
+
+void FileLogSink::Drop() {
+  dropped_.fetch_add(1, std::memory_order_relaxed);
+  GetGlobalLogContext()->sink_dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FileLogSink::Consume(const ThreadLocalLogContext& context, const LogEntry& entry) {
+  size_t filename_len = strnlen(entry.filename, UINT16_MAX);
+  // Formatted entries don't need the fmt to be read back
+  size_t fmt_len = entry.deferred ? strnlen(entry.fmt, UINT16_MAX) : 0;
+  size_t payload = filename_len + fmt_len + entry.data_len;
+  size_t record_size = AlignRecordSize(sizeof(LogRecordHeader) + payload);
+  if (record_size > file_size_ - sizeof(LogFileHeader)) {
+    Drop();
+    return;
+  }
+
+  if (file_.data && write_offset_ + record_size > file_.size) {
+    Rotate();
+  } else if (!file_.data && retry_ticks_ != 0) {
+    RetryRotate();
+  }
+  if (!file_.data) {
+    Drop();
+    return;
+  }
+
+  uint8_t *record = file_.data + write_offset_;
+  LogRecordHeader *header = (LogRecordHeader*)record;
+  header->ticks = entry.ticks;
+  header->thread_uid = context.thread_uid;
+  header->line = (uint32_t)entry.line;
+  header->level = (uint8_t)entry.level;
+  header->flags = (entry.deferred ? LOG_RECORD_DEFERRED : 0) |
+                  (entry.truncated ? LOG_RECORD_TRUNCATED : 0);
+  header->filename_len = (uint16_t)filename_len;
+  header->fmt_len = (uint16_t)fmt_len;
+  header->data_len = entry.data_len;
+
+  uint8_t *payload_ptr = record + sizeof(LogRecordHeader);
+  memcpy(payload_ptr, entry.filename, filename_len);
+  payload_ptr += filename_len;
+  memcpy(payload_ptr, entry.fmt, fmt_len);
+  payload_ptr += fmt_len;
+  memcpy(payload_ptr, entry.data, entry.data_len);
+  header->checksum = ComputeRecordChecksum(header);
+
+  // Commit. A reader (or a crash) before this point sees a size of 0.
+  std::atomic_thread_fence(std::memory_order_release);
+  *(volatile uint32_t*)&header->size = (uint32_t)record_size;
+  write_offset_ += record_size;
+}
+
+/**
+ * LogFileReader
+ */
+
+LogFileReader::~LogFileReader() {
+  platform::CloseMappedFile(&file_);
+}
+
+Status LogFileReader::Open(const char *path) {
+  platform::CloseMappedFile(&file_);
+  read_offset_ = 0;
+  corrupted_ = false;
+
+  Status status = platform::OpenMappedFile(path, &file_);
+  if (!IsStatusOk(status)) {
+    return status;
+  }
+
+  const LogFileHeader *file_header = (const LogFileHeader*)file_.data;
+  if (file_.size < sizeof(LogFileHeader) || file_header->magic != RNR_LOG_FILE_MAGIC) {
+    platform::CloseMappedFile(&file_);
+    return CreateStatus(StatusKind::STATUS_ERROR, "%s is not a renoir log file", path);
+  }
+  if (file_header->version != RNR_LOG_FILE_VERSION) {
+    uint32_t version = file_header->version;
+    platform::CloseMappedFile(&file_);
+    return CreateStatus(StatusKind::STATUS_ERROR, "%s has unsupported version %u", path,
+                        version);
+  }
+
+  read_offset_ = sizeof(LogFileHeader);
+  return {};
+}
+
+bool LogFileReader::Next(LogFileRecord *record) {
+  if (!file_.data || corrupted_) {
+    return false;
+  }
+  if (read_offset_ + sizeof(LogRecordHeader) > file_.size) {
+    return false;
+  }
+
+  const LogRecordHeader *header = (const LogRecordHeader*)(file_.data + read_offset_);
+  uint32_t size = *(const volatile uint32_t*)&header->size;
+  if (size == 0) {
+    return false;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  size_t payload = (size_t)header->filename_len + header->fmt_len + header->data_len;
+  if (size != AlignRecordSize(sizeof(LogRecordHeader) + payload) ||
+      read_offset_ + size > file_.size ||
+      header->checksum != ComputeRecordChecksum(header)) {
+    corrupted_ = true;
+    return false;
+  }
+
+  const uint8_t *payload_ptr = file_.data + read_offset_ + sizeof(LogRecordHeader);
+  record->header = header;
+  record->filename = (const char*)payload_ptr;
+  record->fmt = record->filename + header->filename_len;
+  record->data = (const uint8_t*)record->fmt + header->fmt_len;
+  read_offset_ += size;
+  return true;
+}
+
+size_t LogFileReader::FormatMessage(const LogFileRecord& record, char *out, size_t out_size) {
+  if (out_size == 0) {
+    return 0;
+  }
+  const LogRecordHeader *header = record.header;
+  if (header->flags & LOG_RECORD_DEFERRED) {
+    fmt_.assign(record.fmt, header->fmt_len);
+    return FormatLogArgs(fmt_.c_str(), record.data, header->data_len, out, out_size);
+  }
+
+  size_t len = header->data_len < out_size - 1 ? header->data_len : out_size - 1;
+  memcpy(out, record.data, len);
+  out[len] = '\0';
+  return len;
+}
+
+void LogFileReader::TicksToWallClock(uint64_t ticks, time_t *time, size_t *us) const {
+  platform::ClockCalibration calibration = {};
+  calibration.base_ticks = header().base_ticks;
+  calibration.base_wall_ns = header().base_wall_ns;
+  calibration.ticks_per_second = header().ticks_per_second;
+  calibration.ns_per_tick = 1000000000.0 / calibration.ticks_per_second;
+  platform::TicksToWallClock(calibration, ticks, time, us);
+}
+
+}   // namespace logging
+}   // namespace renoir
@@ -0,0 +1,175 @@
+/******************************************************************************
+ * @file: log_file.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-16
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Binary log files. The sink appends compact records (raw fmt + encoded
+ * arguments, no text formatting) into a pre-sized memory mapped file and
+ * rotates it when full. Reading and formatting happens offline (logcat).
+ *
+ * Layout: a LogFileHeader followed by LogRecordHeader + payload records,
+ * each 8-byte aligned. A record is committed by writing its |size| last, so
+ * a zero size marks the end of the log. As the file lives in the page cache,
+ * everything committed before a crash of the process is still there.
+ ******************************************************************************/
+
+#ifndef SRC_LOGGING_LOG_FILE_H
+#define SRC_LOGGING_LOG_FILE_H
+
+#include <string>
+
+#include "logging/log.h"
+#include "platform/mapped_file.h"
+#include "utils/status.h"
+
+#define RNR_LOG_FILE_MAGIC 0x474F4C52   // "RLOG"
+#define RNR_LOG_FILE_VERSION 1
+// Size of each file. It's allocated up front.
+#ifndef RNR_LOG_FILE_SIZE
+#define RNR_LOG_FILE_SIZE (16 * 1024 * 1024)
+#endif
+// Current file plus the rotated ones (path.1 is the most recent)
+#ifndef RNR_LOG_FILE_COUNT
+#define RNR_LOG_FILE_COUNT 4
+#endif
+// After a failed rotation, records are dropped for this long before the
+// sink tries to create the file again
+#define RNR_LOG_FILE_RETRY_MS 1000
+
+namespace renoir {
+namespace logging {
+
+struct LogFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t file_size;
+  // Clock calibration of the process that wrote the file, so the reader can
+  // translate the ticks into wall-clock time.
+  uint64_t base_ticks;
+  int64_t base_wall_ns;
+  double ticks_per_second;
+  uint8_t reserved[24];
+};
+
+enum LogRecordFlags : uint8_t {
+  LOG_RECORD_DEFERRED = 1 << 0,   // |data| are encoded arguments for |fmt|
+  LOG_RECORD_TRUNCATED = 1 << 1,
+};
+
+// Followed by the filename, the fmt and the data (none null terminated).
+struct LogRecordHeader {
+  // Whole record with padding. Written last, 0 means there are no more.
+  uint32_t size;
+  // FNV-1a of everything after this field (rest of the header and payload)
+  uint32_t checksum;
+  uint64_t ticks;
+  uint64_t thread_uid;
+  uint32_t line;
+  uint8_t level;
+  uint8_t flags;
+  uint16_t filename_len;
+  uint16_t fmt_len;
+  uint16_t data_len;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(LogFileHeader) == 64, "LogFileHeader is part of the file format");
+static_assert(sizeof(LogRecordHeader) == 40, "LogRecordHeader is part of the file format");
+
+/**
+ * Appends every entry into |path|. When a file fills up it is moved to
+ * |path|.1 (shifting the older ones, the oldest is deleted) and a new one is
+ * created. Opening rotates too, so the files of the previous run are kept.
+ * If a rotation fails, records are dropped (and counted, also in
+ * GlobalLogContext::sink_dropped) and it is retried every
+ * RNR_LOG_FILE_RETRY_MS.
+ * The writer never calls write(2); records are copied into the mapping and
+ * the OS writes the pages back on its own.
+ */
+class FileLogSink : public LogSink {
+ public:
+  FileLogSink(std::string path, size_t file_size = RNR_LOG_FILE_SIZE,
+              size_t file_count = RNR_LOG_FILE_COUNT);
+  ~FileLogSink();
+  DISABLE_COPY(FileLogSink);
+  DISABLE_MOVE(FileLogSink);
+
+ public:
+  // Must be called (and succeed) before adding the sink
+  utils::Status Open();
+  void Close();
+
+  void Consume(const ThreadLocalLogContext& context, const LogEntry& entry) override;
+
+ public:
+  // Records that didn't fit in an empty file or were lost to a failed rotation
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  utils::Status CreateFile();
+  // Moves path.i to path.i+1 and path to path.1
+  void ShiftFiles();
+  bool Rotate();
+  // Finishes a failed rotation, once |retry_ticks_| is reached
+  bool RetryRotate();
+  void Drop();
+
+ private:
+  std::string path_;
+  size_t file_size_;
+  size_t file_count_;
+  platform::MappedFile file_;
+  size_t write_offset_ = 0;
+  std::atomic<uint64_t> dropped_{0};
+  // Set while a rotation failed, to when it can be tried again
+  uint64_t retry_ticks_ = 0;
+};
+
+// Pointers into the mapping of a LogFileReader
+struct LogFileRecord {
+  const LogRecordHeader *header;
+  const char *filename;
+  const char *fmt;
+  const uint8_t *data;
+};
+
+class LogFileReader {
+ public:
+  LogFileReader() = default;
+  ~LogFileReader();
+  DISABLE_COPY(LogFileReader);
+  DISABLE_MOVE(LogFileReader);
+
+ public:
+  utils::Status Open(const char *path);
+
+  // Returns false at the end of the log or at the first invalid record
+  // (see corrupted()). Files that are still being written can be read.
+  bool Next(LogFileRecord *record);
+
+  // Formats the message of |record|. Returns the amount of characters written.
+  size_t FormatMessage(const LogFileRecord& record, char *out, size_t out_size);
+
+  // Uses the calibration of the process that wrote the file
+  void TicksToWallClock(uint64_t ticks, time_t *time, size_t *us) const;
+
+ public:
+  const LogFileHeader& header() const { return *(const LogFileHeader*)file_.data; }
+  // Whether reading stopped because of a bad record rather than the end
+  bool corrupted() const { return corrupted_; }
+
+ private:
+  platform::MappedFile file_;
+  size_t read_offset_ = 0;
+  bool corrupted_ = false;
+  // |fmt| is not terminated in the file
+  std::string fmt_;
+};
+
+}   // namespace logging
+}   // namespace renoir
+
+#endif  // SRC_LOGGING_LOG_FILE_H
@@ -0,0 +1,337 @@
+/******************************************************************************
+ * @file: log_format.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-12
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include <cstddef>
+#include <cstdio>
+
+#include "logging/log_format.h"
+
+namespace renoir {
+namespace logging {
+
+namespace {
+
+struct OutputBuffer {
+  char *out;
+  size_t size;
+  size_t pos = 0;
+
+ public:
+  OutputBuffer(char *out, size_t size) : out(out), size(size) {}
+
+ public:
+  size_t Available() const { return size - pos; }
+
+  void AppendChar(char c) {
+    if (pos + 1 < size) {
+      out[pos++] = c;
+    }
+  }
+
+  // Takes the return value of a snprintf into our remaining space
+  void Advance(int written) {
+    if (written <= 0) {
+      return;
+    }
+    pos += (size_t)written;
+    if (pos >= size) {
+      pos = size - 1;
+    }
+  }
+};
+
+struct ArgReader {
+  const uint8_t *args;
+  size_t len;
+  size_t pos = 0;
+
+ public:
+  ArgReader(const uint8_t *args, size_t len) : args(args), len(len) {}
+
+ public:
+  // Returns false if there are no more arguments. |size| is the size of the
+  // original integer argument (0 for the other types).
+  bool Next(LogArgType *type, size_t *size, uint64_t *scalar,
+            const char **str, size_t *str_len) {
+    if (pos >= len) {
+      return false;
+    }
+    uint8_t tag = args[pos++];
+    *type = (LogArgType)(tag & kLogArgTypeMask);
+    *size = tag >> kLogArgWidthShift;
+    if (*type == LogArgType::STRING) {
+      uint16_t len16;
+      if (pos + sizeof(len16) > len) {
+        return false;
+      }
+      memcpy(&len16, args + pos, sizeof(len16));
+      pos += sizeof(len16);
+      if (pos + len16 > len) {
+        return false;
+      }
+      *str = (const char*)(args + pos);
+      *str_len = len16;
+      pos += len16;
+      return true;
+    }
+
+    if (pos + sizeof(*scalar) > len) {
+      return false;
+    }
+    memcpy(scalar, args + pos, sizeof(*scalar));
+    pos += sizeof(*scalar);
+    return true;
+  }
+
+  // Used by '*' width and precision
+  bool NextInt(int *value) {
+    LogArgType type;
+    size_t size;
+    uint64_t scalar = 0;
+    const char *str;
+    size_t str_len;
+    if (!Next(&type, &size, &scalar, &str, &str_len) || type == LogArgType::STRING) {
+      return false;
+    }
+    *value = (int)(int64_t)scalar;
+    return true;
+  }
+};
+
+inline bool IsFlag(char c) {
+  return c == '-' || c == '+' || c == ' ' || c == '#' || c == '0';
+}
+
+inline bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+inline bool IsSupportedConversion(char c) {
+  return strchr("diuoxXceEfFgGaAsp", c) != nullptr;
+}
+
+// Keeps the low |size| bytes of |value|, sign extending them if |is_signed|.
+// This is what printf does when it reads an argument at that width.
+inline uint64_t ToWidth(uint64_t value, size_t size, bool is_signed) {
+  if (size == 0 || size >= sizeof(value)) {
+    return value;
+  }
+  int shift = (int)(8 * (sizeof(value) - size));
+  if (is_signed) {
+    return (uint64_t)((int64_t)(value << shift) >> shift);
+  }
+  return (value << shift) >> shift;
+}
+
+}   // namespace
+
+size_t FormatLogArgs(const char *fmt, const uint8_t *args, size_t args_len,
+                     char *out, size_t out_size) {
+  if (out_size == 0) {
+    return 0;
+  }
+
+  OutputBuffer output(out, out_size);
+  ArgReader reader(args, args_len);
+
+  const char *c = fmt;
+  while (*c) {
+    if (*c != '%') {
+      output.AppendChar(*c++);
+      continue;
+    }
+
+    const char *spec_start = c++;
+    if (*c == '%') {
+      output.AppendChar('%');
+      c++;
+      continue;
+    }
+
+    // We rebuild the spec without the length modifiers, as we know the real
+    // stored type of the argument.
+    char spec[64];
+    size_t spec_len = 0;
+    spec[spec_len++] = '%';
+    while (IsFlag(*c)) {
+      if (spec_len < 8) {
+        spec[spec_len++] = *c;
+      }
+      c++;
+    }
+
+    int width = -1;
+    if (*c == '*') {
+      if (!reader.NextInt(&width)) {
+        width = -1;
+      }
+      c++;
+    } else if (IsDigit(*c)) {
+      width = 0;
+      while (IsDigit(*c)) {
+        width = width * 10 + (*c++ - '0');
+      }
+    }
+
+    int precision = -1;
+    if (*c == '.') {
+      c++;
+      precision = 0;
+      if (*c == '*') {
+        if (!reader.NextInt(&precision)) {
+          precision = -1;
+        }
+        c++;
+      } else {
+        while (IsDigit(*c)) {
+          precision = precision * 10 + (*c++ - '0');
+        }
+      }
+    }
+
+    // Length modifiers, as the size printf would read the integer at.
+    // 0 means there was none.
+    size_t length = 0;
+    while (*c == 'h' || *c == 'l' || *c == 'L' || *c == 'q' ||
+           *c == 'j' || *c == 'z' || *c == 't') {
+      switch (*c) {
+        case 'h': length = (length == sizeof(short)) ? sizeof(char) : sizeof(short); break;
+        case 'l': length = (length == sizeof(long)) ? sizeof(long long) : sizeof(long); break;
+        case 'z': length = sizeof(size_t); break;
+        case 't': length = sizeof(ptrdiff_t); break;
+        default: length = sizeof(long long); break;
+      }
+      c++;
+    }
+
+    char conversion = *c;
+    if (!conversion) {
+      // Dangling spec at the end of the format. Output it as is.
+      for (const char *s = spec_start; s < c; s++) {
+        output.AppendChar(*s);
+      }
+      break;
+    }
+    c++;
+
+    if (!IsSupportedConversion(conversion)) {
+      // Unsupported conversion (eg. %n). We output the spec verbatim and
+      // leave the argument for the next one.
+      for (const char *s = spec_start; s < c; s++) {
+        output.AppendChar(*s);
+      }
+      continue;
+    }
+
+    if (width >= 0) {
+      spec_len += (size_t)snprintf(spec + spec_len, sizeof(spec) - spec_len, "%d", width);
+    }
+
+    LogArgType type;
+    size_t size = 0;
+    uint64_t scalar = 0;
+    const char *str = nullptr;
+    size_t str_len = 0;
+    if (!reader.Next(&type, &size, &scalar, &str, &str_len)) {
+      output.Advance(snprintf(out + output.pos, output.Available(), "<?>"));
+      continue;
+    }
+
+    switch (conversion) {
+      case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c': {
+        if (precision >= 0 && conversion != 'c') {
+          spec_len += (size_t)snprintf(spec + spec_len, sizeof(spec) - spec_len,
+                                       ".%d", precision);
+        }
+        bool is_signed = (conversion == 'd' || conversion == 'i');
+        if (conversion == 'c') {
+          spec[spec_len++] = 'c';
+          spec[spec_len] = '\0';
+          output.Advance(snprintf(out + output.pos, output.Available(), spec, (int)scalar));
+          break;
+        }
+        spec[spec_len++] = 'l';
+        spec[spec_len++] = 'l';
+        spec[spec_len++] = conversion;
+        spec[spec_len] = '\0';
+        if (type == LogArgType::DOUBLE) {
+          double d;
+          memcpy(&d, &scalar, sizeof(d));
+          scalar = (uint64_t)(int64_t)d;
+        }
+        // Without a length modifier printf reads the promoted argument, so
+        // at least an int. Wider arguments (and doubles or pointers, which
+        // don't store a size) are kept whole rather than cut.
+        if (length == 0 && size > 0) {
+          length = size < sizeof(int) ? sizeof(int) : size;
+        }
+        scalar = ToWidth(scalar, length, is_signed);
+        if (is_signed) {
+          long long v = (long long)(int64_t)scalar;
+          output.Advance(snprintf(out + output.pos, output.Available(), spec, v));
+        } else {
+          unsigned long long v = (unsigned long long)scalar;
+          output.Advance(snprintf(out + output.pos, output.Available(), spec, v));
+        }
+        break;
+      }
+      case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A': {
+        if (precision >= 0) {
+          spec_len += (size_t)snprintf(spec + spec_len, sizeof(spec) - spec_len,
+                                       ".%d", precision);
+        }
+        spec[spec_len++] = conversion;
+        spec[spec_len] = '\0';
+        double d;
+        if (type == LogArgType::DOUBLE) {
+          memcpy(&d, &scalar, sizeof(d));
+        } else if (type == LogArgType::INT) {
+          d = (double)(int64_t)scalar;
+        } else {
+          d = (double)scalar;
+        }
+        output.Advance(snprintf(out + output.pos, output.Available(), spec, d));
+        break;
+      }
+      case 's': {
+        if (type != LogArgType::STRING) {
+          output.Advance(snprintf(out + output.pos, output.Available(), "<?>"));
+          break;
+        }
+        // The stored string is not terminated, so we always bound it
+        int max_len = (int)str_len;
+        if (precision >= 0 && precision < max_len) {
+          max_len = precision;
+        }
+        spec[spec_len++] = '.';
+        spec[spec_len++] = '*';
+        spec[spec_len++] = 's';
+        spec[spec_len] = '\0';
+        output.Advance(snprintf(out + output.pos, output.Available(), spec, max_len, str));
+        break;
+      }
+      case 'p': {
+        spec[spec_len++] = 'p';
+        spec[spec_len] = '\0';
+        output.Advance(snprintf(out + output.pos, output.Available(), spec,
+                                (void*)(uintptr_t)scalar));
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  out[output.pos] = '\0';
+  return output.pos;
+}
+
+}   // namespace logging
+}   // namespace renoir
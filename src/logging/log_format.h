@@ -0,0 +1,167 @@
+/******************************************************************************
+ * @file: log_format.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-12
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Deferred log formatting. The producer only copies the raw arguments into
+ * a byte buffer (tagged by type) and the printf-style formatting is done
+ * later by whoever reads the entry (sinks, the log window, logcat).
+ ******************************************************************************/
+
+#ifndef SRC_LOGGING_LOG_FORMAT_H
+#define SRC_LOGGING_LOG_FORMAT_H
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace renoir {
+namespace logging {
+
+enum class LogArgType : uint8_t {
+  INT,      // Any signed integer, stored as int64_t
+  UINT,     // Any unsigned integer, stored as uint64_t
+  DOUBLE,   // float/double, stored as double
+  POINTER,  // Any non-string pointer, stored as uint64_t
+  STRING,   // uint16_t length followed by the (non-terminated) characters
+};
+
+// The tag byte keeps the type in the low nibble and, for integers, the size
+// in bytes of the original argument in the high one. The formatter needs it
+// to print like printf would (eg. -1 as an int under %x is ffffffff).
+constexpr uint8_t kLogArgTypeMask = 0x0f;
+constexpr int kLogArgWidthShift = 4;
+
+/**
+ * Writes tagged arguments into a fixed buffer.
+ * If an argument doesn't fit, it and every argument after it are dropped
+ * and |truncated| is set. The formatter prints missing arguments as "<?>".
+ */
+struct LogArgEncoder {
+  uint8_t *buffer;
+  size_t size;
+  size_t pos = 0;
+  bool truncated = false;
+
+ public:
+  LogArgEncoder(uint8_t *buffer, size_t size) : buffer(buffer), size(size) {}
+
+ public:
+  // |width| is the size of the original argument, when it differs from the
+  // stored |value_size| (integers are always stored as 64 bits)
+  void EncodeScalar(LogArgType type, const void *value, size_t value_size,
+                    size_t width = 0) {
+    if (truncated || pos + 1 + value_size > size) {
+      truncated = true;
+      return;
+    }
+    buffer[pos++] = (uint8_t)((uint8_t)type | (uint8_t)(width << kLogArgWidthShift));
+    memcpy(buffer + pos, value, value_size);
+    pos += value_size;
+  }
+
+  void EncodeString(const char *str) {
+    if (!str) {
+      str = "(null)";
+    }
+    if (truncated || pos + 1 + sizeof(uint16_t) > size) {
+      truncated = true;
+      return;
+    }
+    // Long strings get cut to whatever space is left
+    size_t available = size - pos - 1 - sizeof(uint16_t);
+    size_t len = strnlen(str, available);
+    uint16_t len16 = (uint16_t)len;
+    buffer[pos++] = (uint8_t)LogArgType::STRING;
+    memcpy(buffer + pos, &len16, sizeof(len16));
+    pos += sizeof(len16);
+    memcpy(buffer + pos, str, len);
+    pos += len;
+  }
+};
+
+namespace internal {
+
+// Overloads that route each argument type to the correct encoding.
+// Arguments are taken by value so arrays decay into pointers.
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+EncodeLogArg(LogArgEncoder *encoder, T value) {
+  int64_t v = value;
+  encoder->EncodeScalar(LogArgType::INT, &v, sizeof(v), sizeof(T));
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+EncodeLogArg(LogArgEncoder *encoder, T value) {
+  uint64_t v = value;
+  encoder->EncodeScalar(LogArgType::UINT, &v, sizeof(v), sizeof(T));
+}
+
+template <typename T>
+typename std::enable_if<std::is_enum<T>::value>::type
+EncodeLogArg(LogArgEncoder *encoder, T value) {
+  int64_t v = (int64_t)value;
+  encoder->EncodeScalar(LogArgType::INT, &v, sizeof(v), sizeof(T));
+}
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
+EncodeLogArg(LogArgEncoder *encoder, T value) {
+  double v = (double)value;
+  encoder->EncodeScalar(LogArgType::DOUBLE, &v, sizeof(v));
+}
+
+inline void EncodeLogArg(LogArgEncoder *encoder, const char *value) {
+  encoder->EncodeString(value);
+}
+
+inline void EncodeLogArg(LogArgEncoder *encoder, char *value) {
+  encoder->EncodeString(value);
+}
+
+template <typename T>
+void EncodeLogArg(LogArgEncoder *encoder, T *value) {
+  uint64_t v = (uint64_t)(uintptr_t)value;
+  encoder->EncodeScalar(LogArgType::POINTER, &v, sizeof(v));
+}
+
+inline void EncodeLogArgs(LogArgEncoder *) {}
+
+template <typename T, typename... Args>
+void EncodeLogArgs(LogArgEncoder *encoder, T value, Args... args) {
+  EncodeLogArg(encoder, value);
+  EncodeLogArgs(encoder, args...);
+}
+
+}   // namespace internal
+
+// Encodes |args| into |buffer|. Returns the amount of bytes used.
+template <typename... Args>
+size_t EncodeLogArgs(uint8_t *buffer, size_t size, bool *truncated, Args... args) {
+  LogArgEncoder encoder(buffer, size);
+  internal::EncodeLogArgs(&encoder, args...);
+  *truncated = encoder.truncated;
+  return encoder.pos;
+}
+
+/**
+ * Formats |fmt| printf-style using the arguments encoded by EncodeLogArgs.
+ * Supports the regular conversions (d i u o x X c e E f F g G a A s p %),
+ * flags, width, precision (including '*') and length modifiers.
+ * Integers are printed at the width of the length modifier, or of the
+ * (promoted) argument when there is none, so the output matches printf.
+ * Unsupported conversions are output verbatim and don't take an argument.
+ * Output is always null terminated and truncated to |out_size|.
+ * Returns the amount of characters written (without the terminator).
+ */
+size_t FormatLogArgs(const char *fmt, const uint8_t *args, size_t args_len,
+                     char *out, size_t out_size);
+
+}   // namespace logging
+}   // namespace renoir
+
+#endif  // SRC_LOGGING_LOG_FORMAT_H
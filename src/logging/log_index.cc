@@ -0,0 +1,81 @@
+/******************************************************************************
+ * @file: log_index.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-15
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+
+#include "logging/log_index.h"
+
+namespace renoir {
+namespace logging {
+
+void LogIndex::Add(size_t row, size_t thread_uid, const LogEntry& entry) {
+  level_bitmaps_[(int)entry.level].Set(row);
+  thread_bitmaps_[thread_uid].Set(row);
+  locations_[{entry.filename, entry.line}].push_back(row);
+  indexed_count_ = row + 1;
+}
+
+void LogIndex::Clear() {
+  indexed_count_ = 0;
+  for (LogBitmap& bitmap : level_bitmaps_) {
+    bitmap.Clear();
+  }
+  thread_bitmaps_.clear();
+  locations_.clear();
+}
+
+void LogIndex::DropBefore(size_t row) {
+  for (LogBitmap& bitmap : level_bitmaps_) {
+    bitmap.DropBefore(row);
+  }
+  for (auto& it : thread_bitmaps_) {
+    it.second.DropBefore(row);
+  }
+  // Empty locations are kept: there are as many as call sites, and when one
+  // logs again it reuses its rows' memory instead of allocating it again
+  for (auto& it : locations_) {
+    std::vector<size_t>& rows = it.second;
+    DropFront(&rows, std::lower_bound(rows.begin(), rows.end(), row) - rows.begin());
+  }
+}
+
+const LogBitmap *LogIndex::GetThreadBitmap(size_t thread_uid) const {
+  auto it = thread_bitmaps_.find(thread_uid);
+  if (it == thread_bitmaps_.end()) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+std::vector<size_t> LogIndex::GetLocationRows(const char *filename, size_t line) const {
+  std::vector<size_t> rows;
+  size_t lists = 0;
+  for (auto& it : locations_) {
+    const LogLocation& location = it.first;
+    if (location.line != line) {
+      continue;
+    }
+    if (location.filename != filename && strcmp(location.filename, filename) != 0) {
+      continue;
+    }
+    rows.insert(rows.end(), it.second.begin(), it.second.end());
+    lists++;
+  }
+
+  // Each list is sorted, but if we merged several they are interleaved
+  if (lists > 1) {
+    std::sort(rows.begin(), rows.end());
+  }
+  return rows;
+}
+
+}   // namespace logging
+}   // namespace renoir
@@ -0,0 +1,144 @@
+/******************************************************************************
+ * @file: log_index.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-15
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Incremental index over the rows of a merged log view. Rows are indexed
+ * as they are appended, keeping a bitmap per level and per thread and the
+ * list of rows per source location (filename:line), so filters can be
+ * evaluated a word (64 rows) at a time instead of entry by entry.
+ ******************************************************************************/
+
+#ifndef SRC_LOGGING_LOG_INDEX_H
+#define SRC_LOGGING_LOG_INDEX_H
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "logging/log.h"
+
+#define RNR_LOG_LEVEL_COUNT (RNR_LOG_LEVEL_DEBUG + 1)
+
+namespace renoir {
+namespace logging {
+
+/**
+ * Drops the first |count| values of a vector used as a sliding window. They
+ * hover around the same size, but timing decides how much they hold right
+ * before a drop, so we keep room for at least half a window more to not
+ * reallocate later.
+ */
+template <typename T>
+inline void DropFront(std::vector<T> *values, size_t count) {
+  size_t window = values->size();
+  values->erase(values->begin(), values->begin() + count);
+  if (values->capacity() < window + window / 2) {
+    values->reserve(2 * window);
+  }
+}
+
+// Bits below base() were dropped (see DropBefore) and read as zeroes
+class LogBitmap {
+ public:
+  void Set(size_t bit) {
+    size_t word = bit / 64;
+    if (word < base_) {
+      return;
+    }
+    word -= base_;
+    if (word >= words_.size()) {
+      words_.resize(word + 1, 0);
+    }
+    words_[word] |= (uint64_t)1 << (bit % 64);
+  }
+
+  bool Test(size_t bit) const {
+    return (GetWord(bit / 64) >> (bit % 64)) & 1;
+  }
+
+  // Missing words are all zeroes
+  uint64_t GetWord(size_t word) const {
+    if (word < base_ || word - base_ >= words_.size()) {
+      return 0;
+    }
+    return words_[word - base_];
+  }
+
+  // Forgets the words that only hold bits below |bit|
+  void DropBefore(size_t bit) {
+    size_t word = bit / 64;
+    if (word <= base_) {
+      return;
+    }
+    DropFront(&words_, std::min(word - base_, words_.size()));
+    base_ = word;
+  }
+
+  void Clear() {
+    words_.clear();
+  }
+
+  size_t base() const { return base_ * 64; }
+
+ private:
+  std::vector<uint64_t> words_;
+  // Word index of words_[0]
+  size_t base_ = 0;
+};
+
+// |filename| is the static __FILE__ pointer of the entry
+struct LogLocation {
+  const char *filename;
+  size_t line;
+
+ public:
+  bool operator==(const LogLocation& other) const {
+    return filename == other.filename && line == other.line;
+  }
+};
+
+struct LogLocationHash {
+  size_t operator()(const LogLocation& location) const {
+    return std::hash<const void*>()(location.filename) ^ (location.line * 0x9E3779B97F4A7C15ull);
+  }
+};
+
+class LogIndex {
+ public:
+  // Rows must be added in order
+  void Add(size_t row, size_t thread_uid, const LogEntry& entry);
+  void Clear();
+  // Forgets (most of) the rows below |row|, as they were dropped
+  void DropBefore(size_t row);
+
+ public:
+  size_t indexed_count() const { return indexed_count_; }
+
+  const LogBitmap& GetLevelBitmap(LogLevel level) const {
+    return level_bitmaps_[(int)level];
+  }
+
+  // nullptr if the thread has no rows
+  const LogBitmap *GetThreadBitmap(size_t thread_uid) const;
+
+  // Rows logged from |filename| (compared by content) at |line|, sorted.
+  // The same file can appear through different __FILE__ pointers, so this
+  // merges every location that matches.
+  std::vector<size_t> GetLocationRows(const char *filename, size_t line) const;
+
+ private:
+  size_t indexed_count_ = 0;
+  LogBitmap level_bitmaps_[RNR_LOG_LEVEL_COUNT];
+  std::map<size_t, LogBitmap> thread_bitmaps_;
+  std::unordered_map<LogLocation, std::vector<size_t>, LogLocationHash> locations_;
+};
+
+}   // namespace logging
+}   // namespace renoir
+
+#endif  // SRC_LOGGING_LOG_INDEX_H
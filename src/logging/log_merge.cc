@@ -0,0 +1,170 @@
+/******************************************************************************
+ * @file: log_merge.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-14
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include <algorithm>
+
+#include "logging/log_merge.h"
+
+namespace renoir {
+namespace logging {
+
+namespace {
+
+// std heap functions build a max-heap, so we invert the comparison
+template <typename T>
+bool HeapGreater(const T& a, const T& b) {
+  if (a.ticks != b.ticks) {
+    return a.ticks > b.ticks;
+  }
+  return a.source > b.source;
+}
+
+// Whether |context| has entries on their way to its history: in the ring, or
+// popped by the drain but not appended yet. If so, |ticks| is the newest
+// entry the history has (0 if none), which they can't be older than.
+bool GetPendingTicks(const ThreadLocalLogContext& context, uint64_t *ticks) {
+  // In this order, racing with the producer or the drain can only make us
+  // see more pending entries, never less
+  uint64_t overwritten = context.overwritten.load(std::memory_order_acquire);
+  uint64_t count = context.history.Count();
+  uint64_t written = context.write_index.load(std::memory_order_acquire);
+  if (written <= overwritten + count) {
+    return false;
+  }
+
+  LogEntry entry;
+  *ticks = (count > 0 && context.history.Read(count - 1, &entry)) ? entry.ticks : 0;
+  return true;
+}
+
+}   // namespace
+
+LogRowStore::~LogRowStore() {
+  for (LogRef *chunk : chunks_) {
+    delete[] chunk;
+  }
+}
+
+void LogRowStore::Append(const LogRef& ref) {
+  size_t row = count_.load(std::memory_order_relaxed);
+  size_t chunk_index = row / RNR_LOG_ROW_CHUNK_SIZE;
+  LogRef *&chunk = chunks_[chunk_index % RNR_LOG_ROW_MAX_CHUNKS];
+  if (row % RNR_LOG_ROW_CHUNK_SIZE == 0 && chunk_index >= RNR_LOG_ROW_MAX_CHUNKS) {
+    // Same as LogHistory::Append, readers see the oldest chunk dropped first
+    first_.store((chunk_index - RNR_LOG_ROW_MAX_CHUNKS + 1) * RNR_LOG_ROW_CHUNK_SIZE,
+                 std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  if (!chunk) {
+    chunk = new LogRef[RNR_LOG_ROW_CHUNK_SIZE];
+  }
+  chunk[row % RNR_LOG_ROW_CHUNK_SIZE] = ref;
+  count_.store(row + 1, std::memory_order_release);
+}
+
+void LogCursor::RefreshSources() {
+  GlobalLogContext *global_context = GetGlobalLogContext();
+  std::lock_guard<std::mutex> guard(global_context->mutex);
+  // Contexts are never removed, so a size change means new ones
+  if (global_context->log_contexts.size() == known_contexts_) {
+    return;
+  }
+
+  for (auto& it : global_context->log_contexts) {
+    const ThreadLocalLogContext *context = it.second;
+    auto source_it = std::find_if(sources_.begin(), sources_.end(),
+                                  [context](const Source& source) {
+                                    return source.context == context;
+                                  });
+    if (source_it == sources_.end()) {
+      sources_.push_back({context, 0, 0});
+    }
+  }
+  known_contexts_ = global_context->log_contexts.size();
+}
+
+bool LogCursor::PeekTicks(Source *source, uint64_t *ticks) {
+  const LogHistory& history = source->context->history;
+  LogEntry entry;
+  while (source->position < source->end) {
+    if (history.Read(source->position, &entry)) {
+      *ticks = entry.ticks;
+      return true;
+    }
+    // Dropped under us, continue from the oldest entry still there
+    source->position = history.First();
+  }
+  return false;
+}
+
+size_t LogCursor::MergeNew(std::vector<LogRef> *out, uint64_t watermark_ticks) {
+  RefreshSources();
+
+  auto compare = HeapGreater<HeapItem>;
+  heap_.clear();
+  discarded_ = 0;
+  for (size_t i = 0; i < sources_.size(); i++) {
+    Source& source = sources_[i];
+    source.end = source.context->history.Count();
+    discarded_ += source.context->history.discarded.load(std::memory_order_relaxed);
+    uint64_t ticks;
+    if (PeekTicks(&source, &ticks) && ticks <= watermark_ticks) {
+      heap_.push_back({ticks, i});
+    }
+  }
+  std::make_heap(heap_.begin(), heap_.end(), compare);
+
+  size_t merged = 0;
+  while (!heap_.empty()) {
+    std::pop_heap(heap_.begin(), heap_.end(), compare);
+    HeapItem item = heap_.back();
+    heap_.pop_back();
+
+    Source& source = sources_[item.source];
+    out->push_back({source.context, source.position});
+    source.position++;
+    merged++;
+
+    // Refill with the next entry of the same thread, if it's old enough
+    uint64_t ticks;
+    if (PeekTicks(&source, &ticks) && ticks <= watermark_ticks) {
+      heap_.push_back({ticks, item.source});
+      std::push_heap(heap_.begin(), heap_.end(), compare);
+    }
+  }
+  return merged;
+}
+
+size_t LogCursor::MergeNew(std::vector<LogRef> *out) {
+  uint64_t now = platform::GetTicks();
+  uint64_t slack = platform::NanosecondsToTicks(RNR_LOG_MERGE_SLACK_MS * 1000000ull);
+  uint64_t watermark = now > slack ? now - slack : 0;
+
+  RefreshSources();
+  for (const Source& source : sources_) {
+    uint64_t ticks;
+    if (GetPendingTicks(*source.context, &ticks)) {
+      // Strictly before, pending entries can share the newest one's ticks
+      watermark = std::min(watermark, ticks > 0 ? ticks - 1 : 0);
+    }
+  }
+  return MergeNew(out, watermark);
+}
+
+void LogCursor::Reset() {
+  for (Source& source : sources_) {
+    source.position = 0;
+    source.end = 0;
+  }
+}
+
+}   // namespace logging
+}   // namespace renoir
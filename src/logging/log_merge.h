@@ -0,0 +1,151 @@
+/******************************************************************************
+ * @file: log_merge.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-14
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Presents the histories of every logging thread as one stream ordered by
+ * timestamp. Each consumer owns a LogCursor that remembers how far into each
+ * thread it already merged, so a merge only touches the new entries
+ * (O(new entries * log threads)) instead of re-sorting everything.
+ ******************************************************************************/
+
+#ifndef SRC_LOGGING_LOG_MERGE_H
+#define SRC_LOGGING_LOG_MERGE_H
+
+#include <vector>
+
+#include "logging/log.h"
+
+// Entries younger than this are held back for the next merge. It only covers
+// entries their thread is still writing (timestamped but not in the ring
+// yet); the ones waiting for the drain hold the merge back by themselves
+// (see LogCursor::MergeNew).
+#define RNR_LOG_MERGE_SLACK_MS 2
+// Capacity of a LogRowStore (chunk size and max amount of chunks). Past that
+// the oldest chunk is dropped.
+#define RNR_LOG_ROW_CHUNK_SIZE 65536
+#ifndef RNR_LOG_ROW_MAX_CHUNKS
+#define RNR_LOG_ROW_MAX_CHUNKS 64
+#endif
+
+namespace renoir {
+namespace logging {
+
+// Points to an entry in a thread's history
+struct LogRef {
+  const ThreadLocalLogContext *context;
+  uint64_t index;
+
+ public:
+  // Returns false if the history already dropped the entry
+  bool Read(LogEntry *out) const {
+    return context->history.Read(index, out);
+  }
+
+  bool IsDropped() const {
+    return index < context->history.First();
+  }
+};
+
+/**
+ * List of merged rows. Like LogHistory, rows live in a ring of chunks and
+ * never move, and the oldest chunk is dropped once they are all used. Row
+ * numbers are monotonic, the retained ones are [First(), Count()).
+ * Other threads (eg. the search worker) can read rows while the owner keeps
+ * appending, with the same validation as LogHistory::Read.
+ */
+class LogRowStore {
+ public:
+  LogRowStore() : count_(0), first_(0) {}
+  ~LogRowStore();
+  DISABLE_COPY(LogRowStore);
+  DISABLE_MOVE(LogRowStore);
+
+ public:
+  // Single writer
+  void Append(const LogRef& ref);
+
+  size_t Count() const {
+    return count_.load(std::memory_order_acquire);
+  }
+
+  size_t First() const {
+    return first_.load(std::memory_order_acquire);
+  }
+
+  // |row| must be below a value returned by Count(). Returns false if the
+  // row was dropped.
+  bool Read(size_t row, LogRef *out) const {
+    if (row < First()) {
+      return false;
+    }
+    *out = chunks_[(row / RNR_LOG_ROW_CHUNK_SIZE) % RNR_LOG_ROW_MAX_CHUNKS]
+                  [row % RNR_LOG_ROW_CHUNK_SIZE];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return row >= first_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  LogRef *chunks_[RNR_LOG_ROW_MAX_CHUNKS] = {};
+  std::atomic<size_t> count_;
+  std::atomic<size_t> first_;
+};
+
+class LogCursor {
+ public:
+  LogCursor() = default;
+  DISABLE_COPY(LogCursor);
+  DEFAULT_MOVE(LogCursor);
+
+ public:
+  /**
+   * Appends every entry older than |watermark_ticks| that arrived since the
+   * last call into |out|, in tick order (ties are broken by thread).
+   * Returns the amount of entries appended.
+   */
+  size_t MergeNew(std::vector<LogRef> *out, uint64_t watermark_ticks);
+  // Uses now - RNR_LOG_MERGE_SLACK_MS as the watermark, but doesn't go past
+  // a thread that still has entries in its ring: it stops before the newest
+  // entry that thread's history has, as the rest can only be newer. A slow
+  // drain then delays the merge instead of breaking its order.
+  size_t MergeNew(std::vector<LogRef> *out);
+
+  // Starts from the oldest retained entry of every history again
+  void Reset();
+
+  // Entries every history dropped so far, as of the last merge
+  uint64_t discarded() const { return discarded_; }
+
+ private:
+  struct Source {
+    const ThreadLocalLogContext *context;
+    uint64_t position;
+    uint64_t end;   // Snapshot of the history count for the current merge
+  };
+
+ private:
+  // Picks up threads that registered since the last merge
+  void RefreshSources();
+  // Ticks of the entry at |source->position|, moving past whatever the
+  // history dropped. Returns false if the source has nothing left to merge.
+  bool PeekTicks(Source *source, uint64_t *ticks);
+
+  struct HeapItem {
+    uint64_t ticks;
+    size_t source;
+  };
+
+  std::vector<Source> sources_;
+  // Kept around to avoid allocating every merge
+  std::vector<HeapItem> heap_;
+  size_t known_contexts_ = 0;
+  uint64_t discarded_ = 0;
+};
+
+}   // namespace logging
+}   // namespace renoir
+
+#endif  // SRC_LOGGING_LOG_MERGE_H
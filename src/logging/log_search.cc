@@ -0,0 +1,160 @@
+/******************************************************************************
+ * @file: log_search.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-15
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+
+#include "logging/log_search.h"
+#include "utils/memory.h"
+
+namespace renoir {
+namespace logging {
+
+LogSearch::LogSearch(const LogRowStore *rows) : rows_(rows) {
+  matches_.reserve(RNR_LOG_SEARCH_MAX_PENDING_MATCHES);
+  thread_ = std::thread(&LogSearch::WorkerMain, this);
+}
+
+LogSearch::~LogSearch() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+void LogSearch::Start(const std::string& text, bool use_regex) {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    generation_++;
+    text_ = text;
+    use_regex_ = use_regex;
+    matches_.clear();
+    searched_ = 0;
+    error_.clear();
+    wake_ = true;
+  }
+  cv_.notify_one();
+}
+
+void LogSearch::Notify() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (text_.empty() || !error_.empty() || searched_ >= rows_->Count()) {
+      return;
+    }
+    wake_ = true;
+  }
+  cv_.notify_one();
+}
+
+size_t LogSearch::TakeMatches(std::vector<size_t> *matches, std::string *error) {
+  bool full;
+  size_t searched;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    matches->insert(matches->end(), matches_.begin(), matches_.end());
+    full = matches_.size() + RNR_LOG_SEARCH_BATCH_ROWS > RNR_LOG_SEARCH_MAX_PENDING_MATCHES;
+    matches_.clear();
+    *error = error_;
+    searched = searched_;
+    // The worker stopped to wait for us
+    if (full) {
+      wake_ = true;
+    }
+  }
+  if (full) {
+    cv_.notify_one();
+  }
+  return searched;
+}
+
+void LogSearch::WorkerMain() {
+  platform::GetThreadContext()->name = "Log search";
+  utils::SetThreadMemoryTag(utils::MEMORY_TAG_LOGGING);
+
+  std::vector<size_t> batch_matches;
+  batch_matches.reserve(RNR_LOG_SEARCH_BATCH_ROWS);
+  // Reused, so waking up for new rows doesn't allocate
+  std::string text;
+  char msg[1024];
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this]() { return stop_ || wake_; });
+    if (stop_) {
+      break;
+    }
+    wake_ = false;
+    if (text_.empty()) {
+      continue;
+    }
+
+    uint64_t generation = generation_;
+    text.assign(text_);
+    bool use_regex = use_regex_;
+    size_t row = searched_;
+    lock.unlock();
+
+    if (use_regex && (!regex_compiled_ || regex_pattern_ != text)) {
+      regex_pattern_.assign(text);
+      regex_error_.clear();
+      regex_compiled_ = true;
+      try {
+        regex_ = std::regex(text);
+      } catch (const std::regex_error& e) {
+        regex_error_ = e.what();
+      }
+    }
+    bool valid = !use_regex || regex_error_.empty();
+
+    size_t end = rows_->Count();
+    LogRef ref;
+    LogEntry entry;
+    while (valid && row < end) {
+      batch_matches.clear();
+      // Dropped rows can't match
+      row = std::max(row, rows_->First());
+      size_t batch_end = std::min(row + RNR_LOG_SEARCH_BATCH_ROWS, end);
+      for (; row < batch_end; row++) {
+        if (!rows_->Read(row, &ref) || !ref.Read(&entry)) {
+          continue;
+        }
+        FormatLogEntry(entry, msg, sizeof(msg));
+        bool match = use_regex ? std::regex_search(msg, regex_)
+                               : strstr(msg, text.c_str()) != nullptr;
+        if (match) {
+          batch_matches.push_back(row);
+        }
+      }
+
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (generation_ != generation) {
+        // A new search started, these results are stale
+        break;
+      }
+      matches_.insert(matches_.end(), batch_matches.begin(), batch_matches.end());
+      searched_ = row;
+      // Another batch might not fit, TakeMatches wakes us up
+      if (matches_.size() + RNR_LOG_SEARCH_BATCH_ROWS > RNR_LOG_SEARCH_MAX_PENDING_MATCHES) {
+        break;
+      }
+    }
+
+    lock.lock();
+    if (!valid && generation_ == generation) {
+      error_ = regex_error_;
+    }
+  }
+}
+
+}   // namespace logging
+}   // namespace renoir
@@ -0,0 +1,90 @@
+/******************************************************************************
+ * @file: log_search.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-15
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Substring/regex search over the rows of a LogRowStore, run on a worker
+ * thread so that formatting and matching a big history never stalls a frame.
+ * Matches are streamed back in row order as the worker progresses, and the
+ * worker keeps searching new rows as they get appended.
+ ******************************************************************************/
+
+#ifndef SRC_LOGGING_LOG_SEARCH_H
+#define SRC_LOGGING_LOG_SEARCH_H
+
+#include <condition_variable>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "logging/log_merge.h"
+
+// Rows searched between checks for cancellation/publishing results
+#define RNR_LOG_SEARCH_BATCH_ROWS 4096
+// Matches the worker holds until they are taken. It waits for the next
+// TakeMatches instead of going past it, so neither side has to grow.
+#define RNR_LOG_SEARCH_MAX_PENDING_MATCHES (16 * RNR_LOG_SEARCH_BATCH_ROWS)
+
+namespace renoir {
+namespace logging {
+
+class LogSearch {
+ public:
+  explicit LogSearch(const LogRowStore *rows);
+  ~LogSearch();
+  DISABLE_COPY(LogSearch);
+  DISABLE_MOVE(LogSearch);
+
+ public:
+  // Cancels the current search and starts a new one from the first row.
+  // An empty |text| just stops searching.
+  void Start(const std::string& text, bool use_regex);
+  // Lets the worker know that new rows were appended. Does nothing after
+  // the search failed, until the next Start.
+  void Notify();
+
+  /**
+   * Moves the matches found since the last call into |matches| (in row
+   * order) and returns up to which row the search has gone so far.
+   * Those are at most RNR_LOG_SEARCH_MAX_PENDING_MATCHES.
+   * |error| is set if the regex was invalid.
+   */
+  size_t TakeMatches(std::vector<size_t> *matches, std::string *error);
+
+ private:
+  void WorkerMain();
+
+ private:
+  const LogRowStore *rows_;
+  std::thread thread_;
+
+  // Everything below is guarded by |mutex_|.
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  bool wake_ = false;
+  // Bumped on every Start, so the worker can drop stale results
+  uint64_t generation_ = 0;
+  std::string text_;
+  bool use_regex_ = false;
+  std::vector<size_t> matches_;
+  size_t searched_ = 0;
+  std::string error_;
+
+  // Only touched by the worker. The last pattern compiled, and why it
+  // failed (empty if it didn't), so an invalid one isn't compiled again.
+  std::regex regex_;
+  std::string regex_pattern_;
+  std::string regex_error_;
+  bool regex_compiled_ = false;
+};
+
+}   // namespace logging
+}   // namespace renoir
+
+#endif  // SRC_LOGGING_LOG_SEARCH_H
@@ -0,0 +1,232 @@
+/******************************************************************************
+ * @file: log_view.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-15
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "logging/log_view.h"
+#include "platform/jobs.h"
+#include "profiling/profiler.h"
+
+namespace renoir {
+namespace logging {
+
+namespace {
+
+inline int CountTrailingZeros(uint64_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return (int)index;
+#else
+  return __builtin_ctzll(value);
+#endif
+}
+
+}   // namespace
+
+LogView::LogView() : search_(&rows_) {
+  // What a frame usually merges, and the most the search hands us at once
+  merge_scratch_.reserve(2 * RNR_LOG_HISTORY_CHUNK_ENTRIES);
+  text_matches_scratch_.reserve(RNR_LOG_SEARCH_MAX_PENDING_MATCHES);
+}
+
+void LogView::Update() {
+  RNR_PROFILE_SCOPE("LogView::Update");
+  merge_scratch_.clear();
+  cursor_.MergeNew(&merge_scratch_);
+  LogEntry entry;
+  for (const LogRef& ref : merge_scratch_) {
+    // Dropped since the merge
+    if (!ref.Read(&entry)) {
+      continue;
+    }
+    size_t row = rows_.Count();
+    rows_.Append(ref);
+    index_.Add(row, ref.context->thread_uid, entry);
+    if (filter_.use_location && MatchesLocation(entry)) {
+      location_bitmap_.Set(row);
+    }
+  }
+  SkipDroppedRows();
+
+  size_t end = rows_.Count();
+  if (!filter_.text.empty()) {
+    if (!merge_scratch_.empty()) {
+      search_.Notify();
+    }
+    text_matches_scratch_.clear();
+    searched_ = search_.TakeMatches(&text_matches_scratch_, &search_error_);
+    for (size_t row : text_matches_scratch_) {
+      text_bitmap_.Set(row);
+    }
+    // We can't know about rows the search hasn't reached
+    end = std::min(end, searched_);
+  }
+
+  ExtendFilteredRows(end);
+}
+
+void LogView::SetFilter(const LogFilter& filter) {
+  bool text_changed = filter.text != filter_.text || filter.use_regex != filter_.use_regex;
+  filter_ = filter;
+
+  location_bitmap_.Clear();
+  if (filter_.use_location) {
+    for (size_t row : index_.GetLocationRows(filter_.filename, filter_.line)) {
+      location_bitmap_.Set(row);
+    }
+  }
+
+  if (text_changed) {
+    text_bitmap_.Clear();
+    searched_ = 0;
+    search_error_.clear();
+    search_.Start(filter_.text, filter_.use_regex);
+  }
+
+  filtered_rows_.clear();
+  filtered_begin_ = 0;
+  filtered_upto_ = first_row_;
+  Update();
+}
+
+bool LogView::ReadRow(size_t row, LogEntry *out, const ThreadLocalLogContext **context) const {
+  LogRef ref;
+  if (!rows_.Read(row, &ref) || !ref.Read(out)) {
+    return false;
+  }
+  *context = ref.context;
+  return true;
+}
+
+void LogView::SkipDroppedRows() {
+  // Rows are in time order, not in drop order (every thread drops on its
+  // own), so this stops at the first row still there. The few dropped ones
+  // after it just show as dropped.
+  size_t count = rows_.Count();
+  size_t row = std::max(first_row_, rows_.First());
+  LogRef ref;
+  while (row < count && (!rows_.Read(row, &ref) || ref.IsDropped())) {
+    row++;
+  }
+  if (row == first_row_) {
+    return;
+  }
+  first_row_ = row;
+
+  while (filtered_begin_ < filtered_rows_.size() && filtered_rows_[filtered_begin_] < row) {
+    filtered_begin_++;
+  }
+
+  if (first_row_ - pruned_row_ < RNR_LOG_VIEW_PRUNE_ROWS) {
+    return;
+  }
+  index_.DropBefore(first_row_);
+  location_bitmap_.DropBefore(first_row_);
+  text_bitmap_.DropBefore(first_row_);
+  DropFront(&filtered_rows_, filtered_begin_);
+  filtered_begin_ = 0;
+  pruned_row_ = first_row_;
+}
+
+bool LogView::MatchesLocation(const LogEntry& entry) const {
+  if (entry.line != filter_.line) {
+    return false;
+  }
+  return entry.filename == filter_.filename || strcmp(entry.filename, filter_.filename) == 0;
+}
+
+uint64_t LogView::GetFilterWord(size_t word) const {
+  // We evaluate the filter 64 rows at a time by combining the bitmaps
+  uint64_t mask = 0;
+  for (int level = 0; level < RNR_LOG_LEVEL_COUNT; level++) {
+    if (filter_.level_mask & (1u << level)) {
+      mask |= index_.GetLevelBitmap((LogLevel::InternalEnum)level).GetWord(word);
+    }
+  }
+
+  if (mask && !filter_.threads.empty()) {
+    uint64_t threads = 0;
+    for (size_t thread_uid : filter_.threads) {
+      const LogBitmap *bitmap = index_.GetThreadBitmap(thread_uid);
+      if (bitmap) {
+        threads |= bitmap->GetWord(word);
+      }
+    }
+    mask &= threads;
+  }
+
+  if (filter_.use_location) {
+    mask &= location_bitmap_.GetWord(word);
+  }
+  if (!filter_.text.empty()) {
+    mask &= text_bitmap_.GetWord(word);
+  }
+  return mask;
+}
+
+void LogView::FilterRows(size_t begin, size_t end, std::vector<size_t> *out) const {
+  size_t row = begin;
+  while (row < end) {
+    size_t word = row / 64;
+    size_t word_end = (word + 1) * 64;
+
+    uint64_t mask = ~(uint64_t)0 << (row % 64);
+    if (end < word_end) {
+      mask &= ((uint64_t)1 << (end % 64)) - 1;
+    }
+    mask &= GetFilterWord(word);
+
+    while (mask) {
+      out->push_back(word * 64 + CountTrailingZeros(mask));
+      mask &= mask - 1;
+    }
+    row = std::min(word_end, end);
+  }
+}
+
+void LogView::ExtendFilteredRows(size_t end) {
+  size_t begin = std::max(filtered_upto_, first_row_);
+  if (end <= begin) {
+    return;
+  }
+
+  const size_t piece_rows = RNR_LOG_FILTER_PARALLEL_WORDS * 64;
+  if (end - begin <= piece_rows) {
+    FilterRows(begin, end, &filtered_rows_);
+  } else {
+    // Each piece filters into its own list, then we stitch them in order.
+    // Only the index and the bitmaps are read, which nobody touches meanwhile.
+    size_t piece_count = (end - begin + piece_rows - 1) / piece_rows;
+    filter_pieces_.resize(piece_count);
+    platform::ParallelFor(0, piece_count, 1, [this, begin, end, piece_rows](size_t first,
+                                                                             size_t last) {
+      RNR_PROFILE_SCOPE("Filter log rows");
+      for (size_t piece = first; piece < last; piece++) {
+        size_t piece_begin = begin + piece * piece_rows;
+        size_t piece_end = std::min(piece_begin + piece_rows, end);
+        filter_pieces_[piece].clear();
+        FilterRows(piece_begin, piece_end, &filter_pieces_[piece]);
+      }
+    });
+    for (const std::vector<size_t>& piece : filter_pieces_) {
+      filtered_rows_.insert(filtered_rows_.end(), piece.begin(), piece.end());
+    }
+  }
+  filtered_upto_ = end;
+}
+
+}   // namespace logging
+}   // namespace renoir
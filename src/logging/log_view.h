@@ -0,0 +1,127 @@
+/******************************************************************************
+ * @file: log_view.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-15
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Everything a log consumer (eg. the log window) needs, without the UI:
+ * the merged rows, their index, the text search and the filtered row list.
+ * Update() is meant to run once per frame and only does work proportional
+ * to the amount of new entries (plus whatever the search streamed back).
+ * Rows are numbered from the start of the session. Once the histories (or
+ * the row store) drop the oldest entries, the view starts at first_row().
+ ******************************************************************************/
+
+#ifndef SRC_LOGGING_LOG_VIEW_H
+#define SRC_LOGGING_LOG_VIEW_H
+
+#include <string>
+#include <vector>
+
+#include "logging/log_index.h"
+#include "logging/log_merge.h"
+#include "logging/log_search.h"
+
+// Filtering more bitmap words than this (eg. on a filter change over a big
+// history) is split across the job threads, in pieces of this many words
+#define RNR_LOG_FILTER_PARALLEL_WORDS 1024
+// Dropped rows are skipped right away, but the index and the filtered rows
+// only forget them once this many accumulate, so the erasing is amortized
+#define RNR_LOG_VIEW_PRUNE_ROWS RNR_LOG_ROW_CHUNK_SIZE
+
+namespace renoir {
+namespace logging {
+
+struct LogFilter {
+  // Bit per LogLevel
+  uint32_t level_mask = (1u << RNR_LOG_LEVEL_COUNT) - 1;
+  // Thread UIDs to show. Empty means every thread.
+  std::vector<size_t> threads;
+  // Only show the rows logged from filename:line
+  bool use_location = false;
+  const char *filename = nullptr;
+  size_t line = 0;
+  // Substring (or regex) the message must contain. Empty means no search.
+  std::string text;
+  bool use_regex = false;
+};
+
+class LogView {
+ public:
+  LogView();
+  DISABLE_COPY(LogView);
+  DISABLE_MOVE(LogView);
+
+ public:
+  // Merges the new entries, indexes them and extends the filtered rows
+  void Update();
+  void SetFilter(const LogFilter& filter);
+
+ public:
+  const LogFilter& filter() const { return filter_; }
+  const LogIndex& index() const { return index_; }
+
+  size_t row_count() const { return rows_.Count() - first_row_; }
+  size_t first_row() const { return first_row_; }
+  // Returns false if the row or its entry were dropped
+  bool ReadRow(size_t row, LogEntry *out, const ThreadLocalLogContext **context) const;
+
+  // Entries the thread histories dropped, shown or not
+  uint64_t dropped_count() const { return cursor_.discarded(); }
+  // Rows the view itself dropped, with their entries possibly still around
+  size_t dropped_rows() const { return rows_.First(); }
+
+  // Rows (in time order) that pass the current filter
+  size_t filtered_row_count() const { return filtered_rows_.size() - filtered_begin_; }
+  size_t GetFilteredRow(size_t i) const { return filtered_rows_[filtered_begin_ + i]; }
+
+  // How far the text search has gone, and why it failed (if it did)
+  bool searching() const { return !filter_.text.empty() && searched_ < rows_.Count(); }
+  // Out of row_count()
+  size_t searched_rows() const { return searched_ > first_row_ ? searched_ - first_row_ : 0; }
+  const std::string& search_error() const { return search_error_; }
+
+ private:
+  // Adds the rows in [filtered_upto_, end) that pass the filter
+  void ExtendFilteredRows(size_t end);
+  // Appends the rows in [begin, end) that pass the filter to |out|
+  void FilterRows(size_t begin, size_t end, std::vector<size_t> *out) const;
+  // Rows of |word| (64 rows) that pass the filter, as a bitmask
+  uint64_t GetFilterWord(size_t word) const;
+  bool MatchesLocation(const LogEntry& entry) const;
+  // Moves |first_row_| past the rows whose entries are gone
+  void SkipDroppedRows();
+
+ private:
+  LogCursor cursor_;
+  std::vector<LogRef> merge_scratch_;
+  LogRowStore rows_;
+  LogIndex index_;
+  LogSearch search_;
+
+  LogFilter filter_;
+  LogBitmap location_bitmap_;
+  LogBitmap text_bitmap_;
+  std::vector<size_t> text_matches_scratch_;
+  size_t searched_ = 0;
+  std::string search_error_;
+
+  // Everything below |first_row_| was dropped. The index, bitmaps and
+  // |filtered_rows_| forget them up to |pruned_row_|.
+  size_t first_row_ = 0;
+  size_t pruned_row_ = 0;
+
+  // The ones before |filtered_begin_| were dropped
+  std::vector<size_t> filtered_rows_;
+  size_t filtered_begin_ = 0;
+  size_t filtered_upto_ = 0;
+  // Per-piece results of a parallel filter pass
+  std::vector<std::vector<size_t>> filter_pieces_;
+};
+
+}   // namespace logging
+}   // namespace renoir
+
+#endif  // SRC_LOGGING_LOG_VIEW_H
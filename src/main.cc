@@ -8,7 +8,11 @@
  * @description: TODO(Cristian): Add description
  ******************************************************************************/
 
+#include <cmath>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
 #include <external/GL/gl3w.h>
 #include <SDL.h>
 
@@ -17,7 +21,20 @@
 #include <external/imgui_impl_sdl_gl3.h>
 
 #include "utils/printable_enum.h"
+#include "graphics/gl_state.h"
+#include "graphics/headless_context.h"
 #include "logging/log.h"
+#include "logging/log_file.h"
+#include "platform/clock.h"
+#include "platform/frame_pacer.h"
+#include "platform/frame_scheduler.h"
+#include "platform/jobs.h"
+#include "platform/task_graph.h"
+#include "profiling/frame_bench.h"
+#include "profiling/gpu_profiler.h"
+#include "profiling/profiler.h"
+#include "profiling/trace_export.h"
+#include "utils/memory.h"
 
 #include "editor/ui.h"
 
@@ -30,6 +47,137 @@ PRINTABLE_ENUM(Test, uno, dos);
 
 ImGui::DockContext *global_dock_context = NULL;
 
+// renoir_bench is this same program, headless by default
+#ifdef RNR_BENCH
+#define RNR_HEADLESS_BY_DEFAULT true
+#else
+#define RNR_HEADLESS_BY_DEFAULT false
+#endif
+
+namespace {
+
+struct RunOptions {
+  // Render into an offscreen framebuffer, run the benchmark and exit
+  bool headless = RNR_HEADLESS_BY_DEFAULT;
+  int width = 1280;
+  int height = 720;
+  // Headless only
+  uint64_t warmup_frames = 60;
+  uint64_t frames = 600;
+  std::string report_path = "renoir_bench.json";
+  // Fail if a measured frame does more heap allocations, -1 to not check
+  int64_t max_frame_allocations = -1;
+};
+
+void PrintUsage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [--headless] [--size WIDTHxHEIGHT] [--warmup N] [--frames N] "
+          "[--report PATH] [--max-frame-allocs N]\n",
+          program);
+}
+
+bool ParseRunOptions(int argc, char **argv, RunOptions *options) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (strcmp(arg, "--headless") == 0) {
+      options->headless = true;
+      continue;
+    }
+    if (!value) {
+      return false;
+    }
+    if (strcmp(arg, "--size") == 0) {
+      if (sscanf(value, "%dx%d", &options->width, &options->height) != 2 ||
+          options->width <= 0 || options->height <= 0) {
+        return false;
+      }
+    } else if (strcmp(arg, "--warmup") == 0) {
+      options->warmup_frames = strtoull(value, nullptr, 10);
+    } else if (strcmp(arg, "--frames") == 0) {
+      options->frames = strtoull(value, nullptr, 10);
+    } else if (strcmp(arg, "--report") == 0) {
+      options->report_path = value;
+    } else if (strcmp(arg, "--max-frame-allocs") == 0) {
+      options->max_frame_allocations = strtoll(value, nullptr, 10);
+    } else {
+      return false;
+    }
+    i++;
+  }
+  return true;
+}
+
+// The benchmark's input: the mouse sweeps the whole display, so hovering,
+// highlighting and tooltips are exercised, and scrolls from time to time.
+// Nothing is clicked, so every run goes through the same UI.
+void ScriptBenchInput(uint64_t frame, ImGuiIO& io) {
+  float t = (float)frame / 60.0f;
+  io.MousePos = ImVec2(io.DisplaySize.x * (0.5f + 0.45f * sinf(t * 1.3f)),
+                       io.DisplaySize.y * (0.5f + 0.45f * sinf(t * 0.7f)));
+  for (bool& down : io.MouseDown) {
+    down = false;
+  }
+  io.MouseWheel = (frame % 120) < 10 ? -1.0f : ((frame % 120) < 20 ? 1.0f : 0.0f);
+}
+
+// Glue between the frame scheduler and SDL. |wake_event_type| is registered
+// at startup, pushing one from any thread interrupts the wait.
+Uint32 wake_event_type = (Uint32)-1;
+
+bool WaitForSDLEvent(int timeout_ms) {
+  return SDL_WaitEventTimeout(nullptr, timeout_ms) != 0;
+}
+
+void WakeSDLEventLoop() {
+  SDL_Event event = {};
+  event.type = wake_event_type;
+  SDL_PushEvent(&event);
+}
+
+// ImGui's allocations are small and long lived, the pools fit them. They are
+// charged to ImGui unless a caller (the docks, the backend) claimed them.
+void *ImGuiAllocate(size_t size, void *) {
+  ::renoir::utils::MemoryTag tag = ::renoir::utils::GetThreadMemoryTag();
+  RNR_MEMORY_TAG(tag == ::renoir::utils::MEMORY_TAG_GENERAL ? ::renoir::utils::MEMORY_TAG_IMGUI
+                                                            : tag);
+  return ::renoir::utils::PoolAllocate(size);
+}
+
+void ImGuiFree(void *ptr, void *) {
+  ::renoir::utils::PoolFree(ptr);
+}
+
+bool SetSDLSwapInterval(int interval) {
+  return SDL_GL_SetSwapInterval(interval) == 0;
+}
+
+// New entries have to show up in the log window even while idle
+class WakeOnLogSink : public ::renoir::logging::LogSink {
+ public:
+  void Consume(const ::renoir::logging::ThreadLocalLogContext&,
+               const ::renoir::logging::LogEntry&) override {}
+  void Flush() override { ::renoir::platform::WakeFrameScheduler(); }
+};
+
+// ImGui keeps changing a few things without any input
+void ScheduleUIFrames(const ImGuiIO& io) {
+  // Blinking text caret
+  if (io.WantTextInput) {
+    ::renoir::platform::RequestFrameAt(::renoir::platform::GetTicks() +
+                                       ::renoir::platform::NanosecondsToTicks(250 * 1000000ull));
+  }
+  // Held buttons repeat (scroll arrows, sliders, drags)
+  for (bool down : io.MouseDown) {
+    if (down) {
+      ::renoir::platform::RequestFrames(1);
+      break;
+    }
+  }
+}
+
+}   // namespace
+
 
 
 SDL_Window *SetupSDL() {
@@ -50,27 +198,73 @@ SDL_Window *SetupSDL() {
   return window;
 }
 
-int main(int, char**) {
-  if (SDL_Init(SDL_INIT_VIDEO|SDL_INIT_TIMER) != 0) {
+int main(int argc, char **argv) {
+  RunOptions options;
+  if (!ParseRunOptions(argc, argv, &options)) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  // Headless only uses SDL for its timer
+  if (SDL_Init(options.headless ? SDL_INIT_TIMER : SDL_INIT_VIDEO|SDL_INIT_TIMER) != 0) {
     fprintf(stderr, "SDL_Init Error: %s", SDL_GetError());
     return 1;
   }
 
-  SDL_Window *window = SetupSDL();
-  SDL_GLContext gl_context = SDL_GL_CreateContext(window);
-  (void)(gl_context);
-  SDL_GL_SetSwapInterval(1);  // Enable vsync
-  gl3wInit();
+  // Declared first so the GL context outlives everything using it
+  ::renoir::graphics::HeadlessContext headless_context;
+  SDL_Window *window = nullptr;
+  if (options.headless) {
+    auto headless_status = headless_context.Init(options.width, options.height);
+    if (!::renoir::utils::IsStatusOk(headless_status)) {
+      fprintf(stderr, "Could not create the headless context: %s\n",
+              headless_status.context.msg.c_str());
+      return 1;
+    }
+  } else {
+    window = SetupSDL();
+    SDL_GLContext gl_context = SDL_GL_CreateContext(window);
+    (void)(gl_context);
+    gl3wInit();
+  }
+
+  // Adaptive vsync when the driver has it. Headless has nothing to swap.
+  if (!::renoir::platform::InitFramePacer(options.headless ? nullptr : SetSDLSwapInterval)) {
+    fprintf(stderr, "GL fences not supported, input latency is not measured\n");
+  }
+  SCOPED_TRIGGER((void)0, ::renoir::platform::ShutdownFramePacer());
+  if (!options.headless) {
+    auto swap_mode = ::renoir::platform::SetSwapMode(
+        ::renoir::platform::SwapMode::SWAP_ADAPTIVE_VSYNC);
+    if (swap_mode != ::renoir::platform::SwapMode::SWAP_ADAPTIVE_VSYNC) {
+      fprintf(stderr, "Adaptive vsync not supported, using %s\n",
+              ::renoir::platform::SwapMode::ToString(swap_mode).c_str());
+    }
+  }
 
+  // Before the context, which is allocated with them
+  ImGui::SetAllocatorFunctions(ImGuiAllocate, ImGuiFree);
   ImGui::CreateContext();
   ImGuiIO& io = ImGui::GetIO();
   ImGui::StyleColorsDark();
+  if (options.headless) {
+    // Every run starts from the same layout, and doesn't overwrite the user's
+    io.IniFilename = nullptr;
+    io.DisplaySize = ImVec2((float)options.width, (float)options.height);
+  }
   // Mainly sets up the HDC and SDL Keyboard/Mouse stuf
-  ImGui_ImplSdlGL3_Init(window);
+  // The GL objects it creates live until the shutdown
+  SCOPED_TRIGGER(ImGui_ImplSdlGL3_Init(window), ImGui_ImplSdlGL3_Shutdown());
 
-  global_dock_context = ImGui::CreateDockContext();
+  global_dock_context = ::renoir::editor::CreateDockContext();
   SCOPED_TRIGGER(ImGui::SetCurrentDockContext(global_dock_context),
-                 ImGui::DestroyDockContext(global_dock_context));
+                 ::renoir::editor::DestroyDockContext(global_dock_context));
+
+  // Without timer queries the GPU zones are just not recorded
+  if (!::renoir::profiling::InitGpuProfiler()) {
+    fprintf(stderr, "GL timer queries not supported, GPU profiling disabled\n");
+  }
+  SCOPED_TRIGGER((void)0, ::renoir::profiling::ShutdownGpuProfiler());
 
 #ifdef _WIN32
   // TODO(Cristian): For some reason, we need this for stdout logging in windows
@@ -78,15 +272,47 @@ int main(int, char**) {
   fflush(stderr);
 
   // Maximize the window
-  ShowWindow((HWND)io.ImeWindowHandle, SW_MAXIMIZE);
+  if (window) {
+    ShowWindow((HWND)io.ImeWindowHandle, SW_MAXIMIZE);
+  }
 #endif
 
   auto *thread_context = ::renoir::platform::GetThreadContext();
   thread_context->name = "Main thread";
 
+  // The main thread is job thread 0, it runs jobs whenever it waits on them
+  SCOPED_TRIGGER(::renoir::platform::StartJobSystem(),
+                 ::renoir::platform::StopJobSystem());
+
+  SCOPED_TRIGGER(::renoir::logging::StartLogDrainThread(),
+                 ::renoir::logging::StopLogDrainThread());
 
-  renoir::logging::Log(renoir::logging::LogLevel::LOG_INFO, __FILE__, __LINE__,
-                       "Super test of \"%s\"", "string");
+  // Declared after the drain so it's removed before the drain stops
+  ::renoir::logging::FileLogSink file_log_sink("renoir.rlog");
+  auto file_log_status = file_log_sink.Open();
+  if (::renoir::utils::IsStatusOk(file_log_status)) {
+    ::renoir::logging::AddLogSink(&file_log_sink);
+  } else {
+    fprintf(stderr, "Could not open the log file: %s\n", file_log_status.context.msg.c_str());
+  }
+  SCOPED_TRIGGER((void)0, ::renoir::logging::RemoveLogSink(&file_log_sink));
+
+  // The loop sleeps while nothing changes. Headless always runs at full rate.
+  WakeOnLogSink wake_on_log_sink;
+  if (!options.headless) {
+    wake_event_type = SDL_RegisterEvents(1);
+    if (wake_event_type != (Uint32)-1) {
+      ::renoir::platform::SetFrameSchedulerFunctions(WaitForSDLEvent, WakeSDLEventLoop);
+    }
+    ::renoir::logging::AddLogSink(&wake_on_log_sink);
+  }
+  SCOPED_TRIGGER((void)0, ::renoir::logging::RemoveLogSink(&wake_on_log_sink));
+
+  // F12 or a hitch dumps the last frames as a Chrome trace
+  SCOPED_TRIGGER(::renoir::profiling::StartTraceExporter(".", RNR_TRACE_SPIKE_THRESHOLD_MS),
+                 ::renoir::profiling::StopTraceExporter());
+
+  RNR_LOG_INFO("Super test of \"%s\"", "string");
 
   /* fprintf(stderr, "OpenGL Vendor: %s", glGetString(GL_VENDOR)); */
   /* fprintf(stderr, "OpenGL Renderer: %s", glGetString(GL_RENDERER)); */
@@ -96,24 +322,50 @@ int main(int, char**) {
   /* fprintf(stderr, "OpenGL Extension: %s", glGetString(GL_EXTENSIONS)); */
 
 
+  // The frame as a task graph. Tasks touching SDL, ImGui or GL stay on the
+  // main thread (it owns |gl_context|); the rest overlaps with them on the
+  // job threads. Resources are identified by the address of what they guard.
   bool done = false;
-  while (!done) {
+  ImGuiContext *imgui_context = ImGui::GetCurrentContext();
+  ::renoir::logging::LogView *log_view = ::renoir::editor::GetLogWindowView();
+  using ::renoir::platform::TaskAffinity;
+
+  ::renoir::platform::TaskGraph frame_graph;
+  frame_graph.AddTask("Poll events", [&]() {
+      RNR_PROFILE_SCOPE("Poll events");
       // You can read the io.WantCaptureMouse, io.WantCaptureKeyboard flags to tell if dear imgui wants to use your inputs.
       // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
       // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application.
       // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
+      if (options.headless) {
+        ScriptBenchInput(::renoir::profiling::GetCurrentProfileFrameIndex(), io);
+        return;
+      }
       SDL_Event event;
       while (SDL_PollEvent(&event))
       {
           ImGui_ImplSdlGL3_ProcessEvent(&event);
           if (event.type == SDL_QUIT)
               done = true;
+          if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F12 && !event.key.repeat)
+              ::renoir::profiling::RequestTraceCapture();
       }
+  }, {}, {imgui_context, &done}, TaskAffinity::MAIN_THREAD);
+
+  // Merging and indexing the new log entries doesn't need the main thread
+  frame_graph.AddTask("Update log view", [&]() {
+      RNR_PROFILE_SCOPE("Update log view");
+      RNR_MEMORY_TAG(::renoir::utils::MEMORY_TAG_LOGGING);
+      log_view->Update();
+  }, {}, {log_view});
+
+  frame_graph.AddTask("Build UI", [&]() {
+      RNR_PROFILE_SCOPE("Build UI");
       ImGui_ImplSdlGL3_NewFrame(window);
 
-			if (io.KeysDown[io.KeyMap[ImGuiKey_Escape]]) {
-				done = true;
-			}
+      if (io.KeysDown[io.KeyMap[ImGuiKey_Escape]]) {
+        done = true;
+      }
 
 
       static bool show_demo = true;
@@ -122,15 +374,129 @@ int main(int, char**) {
 
       ::renoir::editor::LogWindow({10, 10}, {500, 200});
       ::renoir::editor::TestWindow();
+  }, {}, {imgui_context, log_view, &done}, TaskAffinity::MAIN_THREAD);
 
-
-      glViewport(0, 0, (int)ImGui::GetIO().DisplaySize.x, (int)ImGui::GetIO().DisplaySize.y);
-      glClear(GL_COLOR_BUFFER_BIT);
+  frame_graph.AddTask("Render", [&]() {
+      RNR_PROFILE_SCOPE("Render");
+      ::renoir::profiling::BeginGpuFrame(::renoir::profiling::GetCurrentProfileFrameIndex());
+      {
+        RNR_GPU_PROFILE_SCOPE("Clear");
+        ::renoir::graphics::GetGLStateCache()->Viewport(0, 0, (int)ImGui::GetIO().DisplaySize.x,
+                                                        (int)ImGui::GetIO().DisplaySize.y);
+        glClear(GL_COLOR_BUFFER_BIT);
+      }
 
 
       ImGui::Render();
-      ImGui_ImplSdlGL3_RenderDrawData(ImGui::GetDrawData());
-      SDL_GL_SwapWindow(window);
+      {
+        RNR_GPU_PROFILE_SCOPE("ImGui");
+        ImGui_ImplSdlGL3_RenderDrawData(ImGui::GetDrawData());
+      }
+      ::renoir::profiling::EndGpuFrame();
+      ::renoir::graphics::GetGLStateCache()->EndFrame();
+      ::renoir::platform::SubmitPacedFrame();
+      // Headless frames stay in the framebuffer, nothing to present
+      if (window) {
+        SDL_GL_SwapWindow(window);
+      }
+      ::renoir::platform::PresentPacedFrame();
+  }, {imgui_context}, {}, TaskAffinity::MAIN_THREAD);
+
+  // Headless runs a fixed amount of frames and reports their times
+  ::renoir::profiling::FrameBenchReport bench_report;
+  bench_report.width = options.width;
+  bench_report.height = options.height;
+  bench_report.warmup_frames = options.warmup_frames;
+  bench_report.renderer = (const char*)glGetString(GL_RENDERER);
+  // So the bookkeeping doesn't allocate during the measured frames
+  bench_report.cpu_ms.reserve(options.frames);
+  bench_report.gpu_ms.reserve(options.frames);
+  bench_report.heap_allocations.reserve(options.frames);
+  uint64_t frames_run = 0;
+  uint64_t first_measured_frame = UINT64_MAX;
+  uint64_t last_gpu_frame = 0;
+
+  while (!done) {
+    // Closes the previous frame's profile
+    RNR_PROFILE_FRAME();
+    ::renoir::profiling::UpdateTraceExporter();
+    // Blocks until there is something to do, then sleeps so the input is
+    // sampled as late as the frame allows. None of that is frame time.
+    ::renoir::platform::WaitForNextFrame();
+    ::renoir::platform::BeginPacedFrame(::renoir::profiling::GetCurrentProfileFrameIndex());
+    RNR_PROFILE_RESTART_FRAME();
+    ::renoir::utils::BeginMemoryFrame();
+    uint64_t frame_start = ::renoir::platform::GetTicks();
+    uint64_t frame_start_allocations = ::renoir::utils::GetHeapAllocationCount();
+    {
+      RNR_PROFILE_SCOPE("Frame");
+      frame_graph.Run();
+    }
+    ScheduleUIFrames(io);
+    uint64_t frame_allocations =
+        ::renoir::utils::GetHeapAllocationCount() - frame_start_allocations;
+    if (!options.headless) {
+      continue;
+    }
+
+    uint64_t frame_index = ::renoir::profiling::GetCurrentProfileFrameIndex();
+    if (frames_run++ == options.warmup_frames) {
+      first_measured_frame = frame_index;
+    }
+    if (frame_index >= first_measured_frame) {
+      bench_report.cpu_ms.push_back(
+          ::renoir::platform::TicksToMilliseconds(::renoir::platform::GetTicks() - frame_start));
+      bench_report.heap_allocations.push_back(frame_allocations);
+    }
+    // GPU frames resolve a few frames late and in order
+    uint64_t newest_gpu_frame = last_gpu_frame;
+    for (size_t age = 0;; age++) {
+      const ::renoir::profiling::GpuFrame *gpu_frame = ::renoir::profiling::GetGpuFrame(age);
+      if (!gpu_frame || gpu_frame->index <= last_gpu_frame) {
+        break;
+      }
+      if (gpu_frame->index >= first_measured_frame) {
+        bench_report.gpu_ms.push_back(gpu_frame->duration_ms);
+      }
+      if (gpu_frame->index > newest_gpu_frame) {
+        newest_gpu_frame = gpu_frame->index;
+      }
+    }
+    last_gpu_frame = newest_gpu_frame;
+    if (frames_run >= options.warmup_frames + options.frames) {
+      done = true;
+    }
+  }
+
+  if (options.headless) {
+    auto report_status = ::renoir::profiling::WriteFrameBenchReport(
+        bench_report, options.report_path.c_str());
+    if (!::renoir::utils::IsStatusOk(report_status)) {
+      fprintf(stderr, "Could not write the bench report: %s\n",
+              report_status.context.msg.c_str());
+      return 1;
+    }
+    auto cpu = ::renoir::profiling::ComputeFrameTimePercentiles(bench_report.cpu_ms);
+    auto gpu = ::renoir::profiling::ComputeFrameTimePercentiles(bench_report.gpu_ms);
+    printf("%zu frames at %dx%d on %s\n", cpu.count, options.width, options.height,
+           bench_report.renderer.c_str());
+    printf("CPU ms: p50 %.3f | p95 %.3f | p99 %.3f | max %.3f\n", cpu.p50_ms, cpu.p95_ms,
+           cpu.p99_ms, cpu.max_ms);
+    printf("GPU ms: p50 %.3f | p95 %.3f | p99 %.3f | max %.3f (%zu frames)\n", gpu.p50_ms,
+           gpu.p95_ms, gpu.p99_ms, gpu.max_ms, gpu.count);
+    auto allocations = ::renoir::profiling::ComputeFrameAllocationStats(
+        bench_report.heap_allocations);
+    printf("Heap allocations: %llu total | %llu max per frame | %zu frames allocated\n",
+           (unsigned long long)allocations.total, (unsigned long long)allocations.max_per_frame,
+           allocations.frames_with_allocations);
+    printf("Report written to %s\n", options.report_path.c_str());
+    if (options.max_frame_allocations >= 0 &&
+        allocations.max_per_frame > (uint64_t)options.max_frame_allocations) {
+      fprintf(stderr, "A frame did %llu heap allocations, the limit is %lld\n",
+              (unsigned long long)allocations.max_per_frame,
+              (long long)options.max_frame_allocations);
+      return 2;
+    }
   }
 
 
@@ -0,0 +1,76 @@
+/******************************************************************************
+ * @file: clock.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-13
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include <thread>
+
+#include "platform/clock.h"
+
+namespace renoir {
+namespace platform {
+
+namespace {
+
+int64_t GetWallClockNanoseconds() {
+  auto now = std::chrono::system_clock::now().time_since_epoch();
+  return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+ClockCalibration Calibrate() {
+  ClockCalibration calibration = {};
+#if RNR_CLOCK_USE_RDTSC
+  // Measure the TSC frequency against steady_clock
+  using SteadyClock = std::chrono::steady_clock;
+  auto steady_start = SteadyClock::now();
+  uint64_t tsc_start = GetTicks();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  auto steady_end = SteadyClock::now();
+  uint64_t tsc_end = GetTicks();
+  double seconds = std::chrono::duration<double>(steady_end - steady_start).count();
+  calibration.ticks_per_second = (double)(tsc_end - tsc_start) / seconds;
+#else
+  calibration.ticks_per_second = 1000000000.0;
+#endif
+  calibration.ns_per_tick = 1000000000.0 / calibration.ticks_per_second;
+
+  calibration.base_ticks = GetTicks();
+  calibration.base_wall_ns = GetWallClockNanoseconds();
+  return calibration;
+}
+
+}   // namespace
+
+const ClockCalibration& GetClockCalibration() {
+  static ClockCalibration calibration = Calibrate();
+  return calibration;
+}
+
+void TicksToWallClock(uint64_t ticks, time_t *time, size_t *us) {
+  TicksToWallClock(GetClockCalibration(), ticks, time, us);
+}
+
+void TicksToWallClock(const ClockCalibration& calibration, uint64_t ticks,
+                      time_t *time, size_t *us) {
+  // Ticks taken before the calibration are valid too
+  double delta_ns = ((double)ticks - (double)calibration.base_ticks) * calibration.ns_per_tick;
+  int64_t wall_ns = calibration.base_wall_ns + (int64_t)delta_ns;
+
+  int64_t seconds = wall_ns / 1000000000;
+  int64_t remainder_ns = wall_ns % 1000000000;
+  if (remainder_ns < 0) {
+    seconds--;
+    remainder_ns += 1000000000;
+  }
+  *time = (time_t)seconds;
+  *us = (size_t)(remainder_ns / 1000);
+}
+
+
+}   // namespace platform
+}   // namespace renoir
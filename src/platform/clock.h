@@ -0,0 +1,92 @@
+/******************************************************************************
+ * @file: clock.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-13
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Cheap monotonic ticks for timestamping (logs, profiling).
+ * Reading the clock is all the hot path pays. Conversion to seconds or to
+ * wall-clock time goes through a per-process calibration record and is meant
+ * to happen only when the timestamp is displayed or written out.
+ ******************************************************************************/
+
+#ifndef SRC_PLATFORM_CLOCK_H
+#define SRC_PLATFORM_CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+// Use the CPU timestamp counter instead of steady_clock. Only safe on
+// machines with an invariant TSC, so it's opt-in.
+#ifndef RNR_CLOCK_USE_RDTSC
+#define RNR_CLOCK_USE_RDTSC 0
+#endif
+
+#if RNR_CLOCK_USE_RDTSC
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace renoir {
+namespace platform {
+
+// Raw monotonic tick. Only meaningful relative to other ticks of the same
+// process. With steady_clock ticks are nanoseconds.
+inline uint64_t GetTicks() {
+#if RNR_CLOCK_USE_RDTSC
+  return (uint64_t)__rdtsc();
+#else
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+#endif
+}
+
+/**
+ * Taken once per process (on the first call to GetClockCalibration).
+ * Pairs a tick with the wall clock at the same instant so any tick can be
+ * translated into wall-clock time afterwards.
+ */
+struct ClockCalibration {
+  uint64_t base_ticks;
+  // Nanoseconds since the epoch of system_clock at |base_ticks|
+  int64_t base_wall_ns;
+  double ticks_per_second;
+  double ns_per_tick;
+};
+
+const ClockCalibration& GetClockCalibration();
+
+inline double TicksToSeconds(uint64_t ticks) {
+  return (double)ticks / GetClockCalibration().ticks_per_second;
+}
+
+inline double TicksToMilliseconds(uint64_t ticks) {
+  return (double)ticks * GetClockCalibration().ns_per_tick / 1000000.0;
+}
+
+inline uint64_t TicksToNanoseconds(uint64_t ticks) {
+  return (uint64_t)((double)ticks * GetClockCalibration().ns_per_tick);
+}
+
+inline uint64_t NanosecondsToTicks(uint64_t ns) {
+  return (uint64_t)((double)ns / GetClockCalibration().ns_per_tick);
+}
+
+// Wall-clock time of |ticks|, split into seconds since the epoch and the
+// microseconds within that second.
+void TicksToWallClock(uint64_t ticks, time_t *time, size_t *us);
+// Same, with the calibration of another process (eg. read from a log file)
+void TicksToWallClock(const ClockCalibration& calibration, uint64_t ticks,
+                      time_t *time, size_t *us);
+
+
+}   // namespace platform
+}   // namespace renoir
+
+#endif  // SRC_PLATFORM_CLOCK_H
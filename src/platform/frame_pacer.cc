@@ -0,0 +1,462 @@
+/******************************************************************************
+ * @file: frame_pacer.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-25
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include "platform/frame_pacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#include "Windows.h"
+#endif
+
+#include <external/GL/gl3w.h>
+
+#include "platform/clock.h"
+#include "platform/thread.h"
+
+namespace renoir {
+namespace platform {
+
+namespace {
+
+// How often the GPU clock is matched against ours again (they drift)
+#define RNR_FRAME_PACER_CALIBRATION_MS 1000
+// Present intervals needed before trusting the refresh estimate
+#define RNR_FRAME_PACER_MIN_INTERVALS 8
+
+struct PacedFrameSlot {
+  GLsync fence = nullptr;
+  GLuint query = 0;
+  uint64_t frame_index = 0;
+  uint64_t begin_ticks = 0;
+  uint64_t input_ticks = 0;
+  uint64_t submit_ticks = 0;
+  uint64_t present_ticks = 0;
+  // Present the frame aimed for, 0 if it wasn't paced
+  uint64_t target_ticks = 0;
+  bool missed = false;
+  // Presented and waiting on its fence
+  bool pending = false;
+};
+
+struct FramePacer {
+  bool initialized = false;
+  // timeBeginPeriod(1) succeeded, so it has to be undone
+  bool timer_period = false;
+  bool fences = false;
+  bool gpu_timestamps = false;
+  FramePacerSwapIntervalFunction swap_interval = nullptr;
+  SwapMode requested_mode = SwapMode::SWAP_VSYNC;
+  SwapMode active_mode = SwapMode::SWAP_IMMEDIATE;
+  double budget_ms = 0;
+  bool late_sampling = true;
+  double margin_ms = RNR_FRAME_PACER_SAFETY_MARGIN_MS;
+
+  PacedFrameSlot slots[RNR_FRAME_PACER_IN_FLIGHT];
+  // Frames begun so far. The next one uses |frame_count| % slots.
+  uint64_t frame_count = 0;
+  // Between BeginPacedFrame and PresentPacedFrame
+  PacedFrameSlot *current = nullptr;
+
+  uint64_t last_present_ticks = 0;
+  uint64_t last_target_ticks = 0;
+  uint64_t last_begin_ticks = 0;
+
+  double present_intervals_ms[RNR_FRAME_PACER_HISTORY];
+  size_t interval_count = 0;
+  double work_ms[RNR_FRAME_PACER_HISTORY];
+  size_t work_count = 0;
+  FramePacerLatency latencies[RNR_FRAME_PACER_HISTORY];
+  size_t resolved_count = 0;
+  uint64_t missed = 0;
+  uint64_t dropped = 0;
+
+  // The same instant in both clocks
+  uint64_t calibration_ticks = 0;
+  GLint64 calibration_gpu_ns = 0;
+};
+
+FramePacer *GetFramePacer() {
+  static FramePacer pacer;
+  return &pacer;
+}
+
+uint64_t MillisecondsToTicks(double ms) {
+  return ms <= 0 ? 0 : NanosecondsToTicks((uint64_t)(ms * 1000000.0));
+}
+
+// |to| - |from|, which can be negative
+double TicksDeltaMs(uint64_t from, uint64_t to) {
+  return to >= from ? TicksToMilliseconds(to - from) : -TicksToMilliseconds(from - to);
+}
+
+// The OS sleep overshoots, so the last stretch is spun
+void SleepUntil(uint64_t ticks) {
+  uint64_t spin_ticks = MillisecondsToTicks(RNR_FRAME_PACER_SPIN_MS);
+  for (uint64_t now = GetTicks(); now < ticks; now = GetTicks()) {
+    uint64_t left = ticks - now;
+    if (left > spin_ticks) {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(TicksToNanoseconds(left - spin_ticks)));
+    } else {
+      CpuPause();
+    }
+  }
+}
+
+void Calibrate(FramePacer *pacer) {
+  // The GPU time is read between two ticks, we take the middle
+  uint64_t before = GetTicks();
+  GLint64 gpu_ns = 0;
+  glGetInteger64v(GL_TIMESTAMP, &gpu_ns);
+  uint64_t after = GetTicks();
+  pacer->calibration_ticks = before + (after - before) / 2;
+  pacer->calibration_gpu_ns = gpu_ns;
+}
+
+// Milliseconds from |ticks| to the GPU timestamp |gpu_ns|
+double GpuTimestampFromTicksMs(const FramePacer *pacer, uint64_t ticks, GLuint64 gpu_ns) {
+  int64_t gpu_delta_ns = (int64_t)gpu_ns - (int64_t)pacer->calibration_gpu_ns;
+  return TicksDeltaMs(ticks, pacer->calibration_ticks) + (double)gpu_delta_ns / 1000000.0;
+}
+
+double MedianRefreshMs(const FramePacer *pacer) {
+  size_t count = std::min<size_t>(pacer->interval_count, RNR_FRAME_PACER_HISTORY);
+  if (count < RNR_FRAME_PACER_MIN_INTERVALS) {
+    return 0;
+  }
+  // Misses (two refreshes) and idle gaps are outliers, the median skips them
+  double intervals[RNR_FRAME_PACER_HISTORY];
+  std::copy(pacer->present_intervals_ms, pacer->present_intervals_ms + count, intervals);
+  std::nth_element(intervals, intervals + count / 2, intervals + count);
+  return intervals[count / 2];
+}
+
+double GetPeriodMs(const FramePacer *pacer) {
+  if (pacer->budget_ms > 0) {
+    return pacer->budget_ms;
+  }
+  if (pacer->active_mode != SwapMode::SWAP_IMMEDIATE) {
+    return MedianRefreshMs(pacer);
+  }
+  return 0;
+}
+
+double PredictedWorkMs(const FramePacer *pacer) {
+  size_t count = std::min<size_t>(pacer->work_count, RNR_FRAME_PACER_HISTORY);
+  double predicted = 0;
+  for (size_t i = 0; i < count; i++) {
+    predicted = pacer->work_ms[i] > predicted ? pacer->work_ms[i] : predicted;
+  }
+  return predicted;
+}
+
+void RecordLatency(FramePacer *pacer, PacedFrameSlot *slot, double input_to_gpu_ms) {
+  FramePacerLatency& latency =
+      pacer->latencies[pacer->resolved_count++ % RNR_FRAME_PACER_HISTORY];
+  latency.frame_index = slot->frame_index;
+  latency.sleep_ms = TicksToMilliseconds(slot->input_ticks - slot->begin_ticks);
+  latency.input_to_submit_ms = TicksToMilliseconds(slot->submit_ticks - slot->input_ticks);
+  latency.input_to_gpu_ms = input_to_gpu_ms;
+  double input_to_swap_ms = TicksToMilliseconds(slot->present_ticks - slot->input_ticks);
+  latency.input_to_present_ms =
+      input_to_gpu_ms > input_to_swap_ms ? input_to_gpu_ms : input_to_swap_ms;
+  latency.missed = slot->missed;
+}
+
+void ReleaseSlot(PacedFrameSlot *slot) {
+  if (slot->fence) {
+    glDeleteSync(slot->fence);
+    slot->fence = nullptr;
+  }
+  slot->pending = false;
+}
+
+// Non-blocking. Frames finish in order, so it stops at the first that didn't.
+void ResolveFrames(FramePacer *pacer) {
+  uint64_t first = pacer->frame_count > RNR_FRAME_PACER_IN_FLIGHT
+                       ? pacer->frame_count - RNR_FRAME_PACER_IN_FLIGHT
+                       : 0;
+  for (uint64_t i = first; i < pacer->frame_count; i++) {
+    PacedFrameSlot *slot = &pacer->slots[i % RNR_FRAME_PACER_IN_FLIGHT];
+    if (!slot->pending) {
+      continue;
+    }
+    GLenum status = glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+      return;
+    }
+    double input_to_gpu_ms = 0;
+    if (pacer->gpu_timestamps) {
+      // Issued before the fence, so it's available already
+      GLuint64 gpu_ns = 0;
+      glGetQueryObjectui64v(slot->query, GL_QUERY_RESULT, &gpu_ns);
+      input_to_gpu_ms = GpuTimestampFromTicksMs(pacer, slot->input_ticks, gpu_ns);
+    } else {
+      input_to_gpu_ms = TicksToMilliseconds(GetTicks() - slot->input_ticks);
+    }
+    RecordLatency(pacer, slot, input_to_gpu_ms);
+    ReleaseSlot(slot);
+  }
+}
+
+}   // namespace
+
+bool InitFramePacer(FramePacerSwapIntervalFunction swap_interval) {
+  FramePacer *pacer = GetFramePacer();
+  if (pacer->initialized) {
+    return pacer->fences;
+  }
+  pacer->swap_interval = swap_interval;
+#ifdef _WIN32
+  // Otherwise SleepUntil wakes up to 15.6 ms late, way past the spin
+  pacer->timer_period = timeBeginPeriod(1) == TIMERR_NOERROR;
+#endif
+  pacer->fences = gl3wIsSupported(3, 2) && glFenceSync && glClientWaitSync && glDeleteSync;
+
+  // Same requirements as the GPU profiler
+  pacer->gpu_timestamps = false;
+  if (pacer->fences && gl3wIsSupported(3, 3) && glQueryCounter && glGetQueryObjectui64v) {
+    GLint bits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+    pacer->gpu_timestamps = bits != 0;
+  }
+  if (pacer->gpu_timestamps) {
+    for (PacedFrameSlot& slot : pacer->slots) {
+      glGenQueries(1, &slot.query);
+    }
+    Calibrate(pacer);
+  }
+
+  pacer->initialized = true;
+  SetSwapMode(pacer->requested_mode);
+  return pacer->fences;
+}
+
+void ShutdownFramePacer() {
+  FramePacer *pacer = GetFramePacer();
+  if (!pacer->initialized) {
+    return;
+  }
+  for (PacedFrameSlot& slot : pacer->slots) {
+    ReleaseSlot(&slot);
+    if (slot.query) {
+      glDeleteQueries(1, &slot.query);
+      slot.query = 0;
+    }
+  }
+  pacer->current = nullptr;
+#ifdef _WIN32
+  if (pacer->timer_period) {
+    timeEndPeriod(1);
+  }
+#endif
+  pacer->timer_period = false;
+  pacer->initialized = false;
+}
+
+SwapMode SetSwapMode(SwapMode mode) {
+  FramePacer *pacer = GetFramePacer();
+  pacer->requested_mode = mode;
+  if (!pacer->initialized) {
+    return pacer->active_mode;
+  }
+
+  SwapMode active = SwapMode::SWAP_IMMEDIATE;
+  FramePacerSwapIntervalFunction swap_interval = pacer->swap_interval;
+  if (swap_interval) {
+    if (mode == SwapMode::SWAP_ADAPTIVE_VSYNC && swap_interval(-1)) {
+      active = SwapMode::SWAP_ADAPTIVE_VSYNC;
+    } else if (mode != SwapMode::SWAP_IMMEDIATE && swap_interval(1)) {
+      active = SwapMode::SWAP_VSYNC;
+    } else {
+      swap_interval(0);
+    }
+  }
+  if (active != pacer->active_mode) {
+    // The refresh has to be measured again, and the presents re-anchored
+    pacer->interval_count = 0;
+    pacer->last_present_ticks = 0;
+    pacer->last_target_ticks = 0;
+    pacer->active_mode = active;
+  }
+  return active;
+}
+
+void SetFrameBudget(double budget_ms) {
+  GetFramePacer()->budget_ms = budget_ms > 0 ? budget_ms : 0;
+}
+
+double GetFrameBudget() {
+  return GetFramePacer()->budget_ms;
+}
+
+void SetLateInputSampling(bool enabled) {
+  GetFramePacer()->late_sampling = enabled;
+}
+
+bool IsLateInputSampling() {
+  return GetFramePacer()->late_sampling;
+}
+
+void SetFramePacerMargin(double margin_ms) {
+  GetFramePacer()->margin_ms = margin_ms > 0 ? margin_ms : 0;
+}
+
+double GetFramePacerMargin() {
+  return GetFramePacer()->margin_ms;
+}
+
+void BeginPacedFrame(uint64_t frame_index) {
+  FramePacer *pacer = GetFramePacer();
+  if (!pacer->initialized) {
+    return;
+  }
+  ResolveFrames(pacer);
+
+  PacedFrameSlot *slot = &pacer->slots[pacer->frame_count % RNR_FRAME_PACER_IN_FLIGHT];
+  if (slot->pending) {
+    ReleaseSlot(slot);
+    pacer->dropped++;
+  }
+  uint64_t now = GetTicks();
+  slot->frame_index = frame_index;
+  slot->begin_ticks = now;
+  slot->submit_ticks = 0;
+  slot->present_ticks = 0;
+  slot->target_ticks = 0;
+  slot->missed = false;
+
+  uint64_t wake_ticks = 0;
+  uint64_t period_ticks = MillisecondsToTicks(GetPeriodMs(pacer));
+  if (period_ticks > 0 && pacer->late_sampling) {
+    // With vsync the presents land on the vblanks, so they give the phase.
+    // Otherwise the previous target does, the present is just the swap call.
+    bool display_paced = pacer->active_mode != SwapMode::SWAP_IMMEDIATE && pacer->budget_ms == 0;
+    uint64_t anchor = display_paced ? pacer->last_present_ticks : pacer->last_target_ticks;
+    uint64_t lead_ticks = MillisecondsToTicks(PredictedWorkMs(pacer) + pacer->margin_ms);
+    uint64_t target = (anchor ? anchor : now) + period_ticks;
+    // Too late for that slot (or back from idle), aim at the first that fits
+    if (target < now + lead_ticks) {
+      uint64_t behind = now + lead_ticks - target;
+      target += (behind + period_ticks - 1) / period_ticks * period_ticks;
+    }
+    slot->target_ticks = target;
+    wake_ticks = target - lead_ticks;
+    pacer->last_target_ticks = target;
+  } else if (period_ticks > 0 && pacer->budget_ms > 0 && pacer->last_begin_ticks) {
+    // Plain frame limiter
+    wake_ticks = pacer->last_begin_ticks + period_ticks;
+  }
+
+  if (wake_ticks > now) {
+    SleepUntil(wake_ticks);
+    pacer->last_begin_ticks = wake_ticks;
+  } else {
+    pacer->last_begin_ticks = now;
+  }
+  slot->input_ticks = GetTicks();
+  pacer->current = slot;
+  pacer->frame_count++;
+}
+
+void SubmitPacedFrame() {
+  FramePacer *pacer = GetFramePacer();
+  PacedFrameSlot *slot = pacer->current;
+  if (!slot) {
+    return;
+  }
+  slot->submit_ticks = GetTicks();
+  pacer->work_ms[pacer->work_count++ % RNR_FRAME_PACER_HISTORY] =
+      TicksToMilliseconds(slot->submit_ticks - slot->input_ticks);
+  if (pacer->gpu_timestamps) {
+    glQueryCounter(slot->query, GL_TIMESTAMP);
+  }
+  if (pacer->fences) {
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+}
+
+void PresentPacedFrame() {
+  FramePacer *pacer = GetFramePacer();
+  PacedFrameSlot *slot = pacer->current;
+  if (!slot) {
+    return;
+  }
+  pacer->current = nullptr;
+  uint64_t now = GetTicks();
+  slot->present_ticks = now;
+  if (!slot->submit_ticks) {
+    slot->submit_ticks = now;
+  }
+
+  if (pacer->active_mode != SwapMode::SWAP_IMMEDIATE && pacer->last_present_ticks) {
+    pacer->present_intervals_ms[pacer->interval_count++ % RNR_FRAME_PACER_HISTORY] =
+        TicksToMilliseconds(now - pacer->last_present_ticks);
+  }
+  pacer->last_present_ticks = now;
+
+  // Landing in the next slot is a miss, anything before it isn't
+  uint64_t period_ticks = MillisecondsToTicks(GetPeriodMs(pacer));
+  if (slot->target_ticks && now > slot->target_ticks + period_ticks / 2) {
+    slot->missed = true;
+    pacer->missed++;
+  }
+
+  if (slot->fence) {
+    slot->pending = true;
+  } else {
+    RecordLatency(pacer, slot, TicksToMilliseconds(slot->submit_ticks - slot->input_ticks));
+  }
+
+  if (pacer->gpu_timestamps &&
+      TicksToMilliseconds(now - pacer->calibration_ticks) > RNR_FRAME_PACER_CALIBRATION_MS) {
+    Calibrate(pacer);
+  }
+  ResolveFrames(pacer);
+}
+
+FramePacerStats GetFramePacerStats() {
+  const FramePacer *pacer = GetFramePacer();
+  FramePacerStats stats;
+  stats.requested_mode = pacer->requested_mode;
+  stats.active_mode = pacer->active_mode;
+  stats.refresh_interval_ms = MedianRefreshMs(pacer);
+  stats.period_ms = GetPeriodMs(pacer);
+  stats.predicted_work_ms = PredictedWorkMs(pacer);
+  stats.gpu_timestamps = pacer->gpu_timestamps;
+  stats.missed_frames = pacer->missed;
+  stats.dropped_frames = pacer->dropped;
+
+  size_t count = std::min<size_t>(pacer->resolved_count, RNR_FRAME_PACER_HISTORY);
+  for (size_t i = 0; i < count; i++) {
+    double latency = pacer->latencies[i].input_to_present_ms;
+    stats.avg_input_to_present_ms += latency;
+    if (latency > stats.max_input_to_present_ms) {
+      stats.max_input_to_present_ms = latency;
+    }
+  }
+  if (count > 0) {
+    stats.avg_input_to_present_ms /= (double)count;
+  }
+  return stats;
+}
+
+const FramePacerLatency *GetFramePacerLatency(size_t age) {
+  const FramePacer *pacer = GetFramePacer();
+  if (age >= pacer->resolved_count || age >= RNR_FRAME_PACER_HISTORY) {
+    return nullptr;
+  }
+  return &pacer->latencies[(pacer->resolved_count - 1 - age) % RNR_FRAME_PACER_HISTORY];
+}
+
+}   // namespace platform
+}   // namespace renoir
@@ -0,0 +1,138 @@
+/******************************************************************************
+ * @file: frame_pacer.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-25
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Decides when, within its frame slot, a frame starts. Polling input at the
+ * start of the loop and then blocking in the vsync'd swap means the input is
+ * almost a whole refresh old by the time it is shown. Instead the pacer
+ * sleeps *before* the input is sampled, until the predicted work of the frame
+ * (plus a safety margin) just fits before the next present:
+ *
+ *   |  sleep  | input | UI + render | swap | <- vblank
+ *
+ * The slot is the display refresh (measured from the presents while vsync
+ * is on) or a frame budget set by hand, which also works as a frame limiter
+ * without vsync.
+ *
+ * Every frame gets a GL fence (and a GL_TIMESTAMP query when timer queries
+ * are supported) right before the swap. Once signaled, they tell when the
+ * GPU finished the frame, which against the time the input was sampled gives
+ * the input to photon latency. The display adds its own scan out delay on
+ * top, which we can't see.
+ *
+ * The pacer doesn't know about SDL: the swap interval is set through the
+ * function given to InitFramePacer. Everything must be called from the
+ * thread that owns the GL context.
+ ******************************************************************************/
+
+#ifndef SRC_PLATFORM_FRAME_PACER_H
+#define SRC_PLATFORM_FRAME_PACER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "utils/printable_enum.h"
+
+// Frames whose fences can be waiting at the same time. A frame whose slot
+// comes around again before it signaled is dropped from the measurements.
+#define RNR_FRAME_PACER_IN_FLIGHT 4
+// Frames the work prediction, the refresh estimate and the averages look at
+#define RNR_FRAME_PACER_HISTORY 32
+// Default slack left between the predicted end of the frame and the present.
+// It has to cover the GPU work, which the prediction (CPU side) doesn't.
+#define RNR_FRAME_PACER_SAFETY_MARGIN_MS 2.0
+// The end of every sleep is spun instead, OS sleeps overshoot. On Windows
+// the pacer raises the timer resolution to 1 ms while it's initialized, it
+// sleeps in 15.6 ms steps otherwise.
+#define RNR_FRAME_PACER_SPIN_MS 1.0
+
+namespace renoir {
+namespace platform {
+
+// Swap intervals 0, 1 and -1. Adaptive vsync waits for the vblank like
+// vsync, but a frame that misses it is shown right away (tearing) instead of
+// a whole refresh later.
+PRINTABLE_ENUM(SwapMode, SWAP_IMMEDIATE, SWAP_VSYNC, SWAP_ADAPTIVE_VSYNC);
+
+// Sets the swap interval (0, 1 or -1). Returns false if the driver refuses.
+typedef bool (*FramePacerSwapIntervalFunction)(int interval);
+
+// One frame, once its fence signaled
+struct FramePacerLatency {
+  uint64_t frame_index = 0;
+  // Slept before sampling the input
+  double sleep_ms = 0;
+  // From the input sample to the swap call (CPU work)
+  double input_to_submit_ms = 0;
+  // To the GPU finishing the frame
+  double input_to_gpu_ms = 0;
+  // To the image being handed to the display: the later of the GPU finishing
+  // and the swap returning. Drivers that queue the swap return before the
+  // flip, so it's a lower bound there.
+  double input_to_present_ms = 0;
+  // Presented after the slot it aimed for
+  bool missed = false;
+};
+
+struct FramePacerStats {
+  SwapMode requested_mode = SwapMode::SWAP_VSYNC;
+  // What the driver accepted
+  SwapMode active_mode = SwapMode::SWAP_IMMEDIATE;
+  // Median time between presents while vsync is on, 0 while unknown
+  double refresh_interval_ms = 0;
+  // Slot the frames are paced to, 0 if they are not
+  double period_ms = 0;
+  // Longest CPU work (input to swap) in the history
+  double predicted_work_ms = 0;
+  // GPU finish times come from timestamp queries, otherwise from the time
+  // the fence was seen signaled (later than the real one)
+  bool gpu_timestamps = false;
+
+  // Over the history
+  double avg_input_to_present_ms = 0;
+  double max_input_to_present_ms = 0;
+  uint64_t missed_frames = 0;
+  // Frames whose fence didn't signal in time
+  uint64_t dropped_frames = 0;
+};
+
+// Needs a current GL context with sync objects (GL 3.2). |swap_interval| can
+// be nullptr when there is nothing to present (headless), the mode stays
+// SWAP_IMMEDIATE then. Returns false if fences are not supported; frames are
+// still paced but not measured.
+bool InitFramePacer(FramePacerSwapIntervalFunction swap_interval);
+void ShutdownFramePacer();
+
+// Falls back from adaptive vsync to vsync, and from vsync to immediate, if
+// the driver refuses. Returns the mode that ended up active.
+SwapMode SetSwapMode(SwapMode mode);
+// In milliseconds, 0 paces to the refresh (or not at all without vsync)
+void SetFrameBudget(double budget_ms);
+double GetFrameBudget();
+// Off, the sleep only enforces the frame budget and the frame starts right
+// after the previous one otherwise
+void SetLateInputSampling(bool enabled);
+bool IsLateInputSampling();
+void SetFramePacerMargin(double margin_ms);
+double GetFramePacerMargin();
+
+// Sleeps until the frame should start. Input must be sampled right after.
+void BeginPacedFrame(uint64_t frame_index);
+// Right before the swap, after every GL command of the frame
+void SubmitPacedFrame();
+// Right after the swap returns. Reads back whatever frames finished.
+void PresentPacedFrame();
+
+FramePacerStats GetFramePacerStats();
+// Measured frames, from the most recent (|age| 0) backwards. Returns nullptr
+// past the last RNR_FRAME_PACER_HISTORY.
+const FramePacerLatency *GetFramePacerLatency(size_t age);
+
+}   // namespace platform
+}   // namespace renoir
+
+#endif  // SRC_PLATFORM_FRAME_PACER_H
@@ -0,0 +1,201 @@
+/******************************************************************************
+ * @file: frame_scheduler.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-24
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include "platform/frame_scheduler.h"
+
+#include <atomic>
+
+#ifdef _WIN32
+#include "Windows.h"
+#else
+#include <ctime>
+#endif
+
+#include "platform/clock.h"
+
+namespace renoir {
+namespace platform {
+
+namespace {
+
+struct FrameScheduler {
+  std::atomic<FrameSchedulerWaitFunction> wait;
+  std::atomic<FrameSchedulerWakeFunction> wake;
+  std::atomic<bool> enabled;
+  std::atomic<bool> woken;
+  std::atomic<uint32_t> requested_frames;
+
+  // Main thread only from here on
+  uint64_t deadline = 0;
+  uint32_t active_frames = 0;
+  FrameSchedulerStats stats;
+
+  // Current measurement window
+  uint64_t window_begin = 0;
+  uint64_t window_cpu_ns = 0;
+  uint64_t window_frames = 0;
+  uint64_t window_idle_ticks = 0;
+
+  FrameScheduler()
+      : wait(nullptr), wake(nullptr), enabled(true), woken(false), requested_frames(0) {}
+};
+
+FrameScheduler *GetFrameScheduler() {
+  static FrameScheduler scheduler;
+  return &scheduler;
+}
+
+// CPU time of the whole process (every thread)
+uint64_t GetProcessCpuNanoseconds() {
+#ifdef _WIN32
+  FILETIME creation, exit, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+    return 0;
+  }
+  // In 100 ns units
+  uint64_t kernel_time = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+  uint64_t user_time = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+  return (kernel_time + user_time) * 100;
+#else
+  timespec time;
+  if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0) {
+    return 0;
+  }
+  return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+#endif
+}
+
+void UpdateStats(FrameScheduler *scheduler, uint64_t now) {
+  if (scheduler->window_begin == 0) {
+    scheduler->window_begin = now;
+    scheduler->window_cpu_ns = GetProcessCpuNanoseconds();
+    return;
+  }
+  double elapsed_ms = TicksToMilliseconds(now - scheduler->window_begin);
+  if (elapsed_ms < RNR_FRAME_SCHEDULER_CPU_WINDOW_MS) {
+    return;
+  }
+
+  uint64_t cpu_ns = GetProcessCpuNanoseconds();
+  FrameSchedulerStats& stats = scheduler->stats;
+  stats.frames_per_second = (double)scheduler->window_frames * 1000.0 / elapsed_ms;
+  stats.idle_ratio = TicksToMilliseconds(scheduler->window_idle_ticks) / elapsed_ms;
+  stats.cpu_percent = (double)(cpu_ns - scheduler->window_cpu_ns) / 1000000.0 / elapsed_ms * 100.0;
+
+  scheduler->window_begin = now;
+  scheduler->window_cpu_ns = cpu_ns;
+  scheduler->window_frames = 0;
+  scheduler->window_idle_ticks = 0;
+}
+
+// Consumes whatever allows the next frame to run. Returns false if nothing
+// does, and how long we can wait for something in |timeout_ms|.
+bool ShouldRunFrame(FrameScheduler *scheduler, int *timeout_ms) {
+  if (scheduler->woken.exchange(false)) {
+    scheduler->active_frames = RNR_FRAME_SCHEDULER_ACTIVE_FRAMES;
+  }
+  // Only this thread decrements, so it can't go below 0 in between
+  if (scheduler->requested_frames.load() > 0) {
+    scheduler->requested_frames--;
+    return true;
+  }
+  if (scheduler->active_frames > 0) {
+    scheduler->active_frames--;
+    return true;
+  }
+
+  *timeout_ms = RNR_FRAME_SCHEDULER_MAX_WAIT_MS;
+  if (scheduler->deadline != 0) {
+    uint64_t now = GetTicks();
+    if (now >= scheduler->deadline) {
+      scheduler->deadline = 0;
+      return true;
+    }
+    // Rounded up, waking early would just wait again
+    double left_ms = TicksToMilliseconds(scheduler->deadline - now);
+    if (left_ms < RNR_FRAME_SCHEDULER_MAX_WAIT_MS) {
+      *timeout_ms = (int)left_ms + 1;
+    }
+  }
+  return false;
+}
+
+}   // namespace
+
+void SetFrameSchedulerFunctions(FrameSchedulerWaitFunction wait, FrameSchedulerWakeFunction wake) {
+  FrameScheduler *scheduler = GetFrameScheduler();
+  scheduler->wait = wait;
+  scheduler->wake = wake;
+}
+
+void SetFrameSchedulerEnabled(bool enabled) {
+  GetFrameScheduler()->enabled = enabled;
+}
+
+bool IsFrameSchedulerEnabled() {
+  return GetFrameScheduler()->enabled;
+}
+
+void WakeFrameScheduler() {
+  FrameScheduler *scheduler = GetFrameScheduler();
+  // Only the first wake up since the last frame needs to interrupt the wait
+  if (scheduler->woken.exchange(true)) {
+    return;
+  }
+  FrameSchedulerWakeFunction wake = scheduler->wake;
+  if (wake) {
+    wake();
+  }
+}
+
+void RequestFrames(uint32_t count) {
+  GetFrameScheduler()->requested_frames += count;
+}
+
+void RequestFrameAt(uint64_t ticks) {
+  FrameScheduler *scheduler = GetFrameScheduler();
+  if (scheduler->deadline == 0 || ticks < scheduler->deadline) {
+    scheduler->deadline = ticks;
+  }
+}
+
+void WaitForNextFrame() {
+  FrameScheduler *scheduler = GetFrameScheduler();
+  UpdateStats(scheduler, GetTicks());
+
+  FrameSchedulerWaitFunction wait = scheduler->wait;
+  if (scheduler->enabled && wait) {
+    int timeout_ms = 0;
+    bool waited = false;
+    while (!ShouldRunFrame(scheduler, &timeout_ms)) {
+      uint64_t begin = GetTicks();
+      if (wait(timeout_ms)) {
+        scheduler->active_frames = RNR_FRAME_SCHEDULER_ACTIVE_FRAMES;
+      }
+      uint64_t end = GetTicks();
+      scheduler->window_idle_ticks += end - begin;
+      UpdateStats(scheduler, end);
+      waited = true;
+    }
+    if (waited) {
+      scheduler->stats.wake_ups++;
+    }
+  }
+
+  scheduler->stats.frames++;
+  scheduler->window_frames++;
+}
+
+FrameSchedulerStats GetFrameSchedulerStats() {
+  return GetFrameScheduler()->stats;
+}
+
+}   // namespace platform
+}   // namespace renoir
@@ -0,0 +1,85 @@
+/******************************************************************************
+ * @file: frame_scheduler.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-24
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Decides when the main loop runs a frame. An untouched editor doesn't need
+ * to rebuild and redraw the UI, so between frames the main thread blocks
+ * waiting for events and only runs one when:
+ *  - an event arrives (input, window changes...),
+ *  - another thread wakes it up (eg. new log entries),
+ *  - a requested deadline passes (animations, the text caret), or
+ *  - frames were requested explicitly.
+ * After any of these a few more frames run (RNR_FRAME_SCHEDULER_ACTIVE_FRAMES)
+ * so ImGui can settle hover and focus changes, which makes interaction run
+ * at full rate right away.
+ *
+ * The scheduler doesn't know about SDL: the main loop hands it a function
+ * that blocks for events, and the waking function that interrupts it.
+ ******************************************************************************/
+
+#ifndef SRC_PLATFORM_FRAME_SCHEDULER_H
+#define SRC_PLATFORM_FRAME_SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Frames run after every wake up
+#define RNR_FRAME_SCHEDULER_ACTIVE_FRAMES 3
+// Longest single wait. Nothing renders when it expires, it only bounds how
+// stale the idle statistics can get.
+#define RNR_FRAME_SCHEDULER_MAX_WAIT_MS 1000
+// Process CPU usage we aim for while idle, in percent of one core. Measured
+// with the job system (8 workers), the log drain and the log search all
+// blocked: ~0.001% (it was ~98% while the workers polled every 1 ms).
+#define RNR_FRAME_SCHEDULER_IDLE_CPU_TARGET 1.0
+// Window over which the CPU usage is measured
+#define RNR_FRAME_SCHEDULER_CPU_WINDOW_MS 1000
+
+namespace renoir {
+namespace platform {
+
+// Blocks until there is an event or |timeout_ms| passes. Returns true if
+// there was an event.
+typedef bool (*FrameSchedulerWaitFunction)(int timeout_ms);
+// Makes a FrameSchedulerWaitFunction in progress return. Called from any
+// thread.
+typedef void (*FrameSchedulerWakeFunction)();
+
+struct FrameSchedulerStats {
+  uint64_t frames = 0;
+  // Times the main thread went idle and came back
+  uint64_t wake_ups = 0;
+  // Over the last measurement window
+  double frames_per_second = 0;
+  // Fraction of the wall time the main thread spent waiting
+  double idle_ratio = 0;
+  // Process CPU time over wall time, in percent of one core
+  double cpu_percent = 0;
+};
+
+void SetFrameSchedulerFunctions(FrameSchedulerWaitFunction wait, FrameSchedulerWakeFunction wake);
+// Disabled, every call to WaitForNextFrame returns right away (full rate)
+void SetFrameSchedulerEnabled(bool enabled);
+bool IsFrameSchedulerEnabled();
+
+// Any thread. Runs the next frames, interrupting the wait if needed.
+void WakeFrameScheduler();
+// Any thread. Runs at least |count| more frames.
+void RequestFrames(uint32_t count);
+// Main thread. Runs a frame once |ticks| (platform::GetTicks) is reached.
+void RequestFrameAt(uint64_t ticks);
+
+// Main thread, once per loop before the frame. Blocks until the next frame
+// should run.
+void WaitForNextFrame();
+
+FrameSchedulerStats GetFrameSchedulerStats();
+
+}   // namespace platform
+}   // namespace renoir
+
+#endif  // SRC_PLATFORM_FRAME_SCHEDULER_H
@@ -0,0 +1,528 @@
+/******************************************************************************
+ * @file: jobs.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-17
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include <cassert>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "platform/jobs.h"
+#include "platform/thread.h"
+
+namespace renoir {
+namespace platform {
+
+namespace {
+
+// Spins looking for work before a worker goes to sleep (only after running
+// something, an idle worker stays asleep until a job is pushed)
+const int kIdleSpinCount = 2048;
+
+/**
+ * Chase-Lev work-stealing deque. Same orderings as Lê et al. (2013), but
+ * with seq_cst operations instead of standalone fences, which also keeps
+ * ThreadSanitizer able to follow it. Fixed capacity: Push fails instead of
+ * growing.
+ * Push and Pop are owner only, Steal can be called from any thread.
+ */
+class JobDeque {
+ public:
+  JobDeque() : top_(0), bottom_(0) {
+    for (auto& job : buffer_) {
+      job.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+ public:
+  bool Push(Job *job) {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    int64_t top = top_.load(std::memory_order_acquire);
+    if (bottom - top >= RNR_JOB_DEQUE_SIZE) {
+      return false;
+    }
+    buffer_[bottom & (RNR_JOB_DEQUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+    bottom_.store(bottom + 1, std::memory_order_release);
+    return true;
+  }
+
+  Job *Pop() {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    // The store has to be visible before we read |top_| (StoreLoad)
+    bottom_.store(bottom, std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_seq_cst);
+    if (top > bottom) {
+      // Empty
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    Job *job = buffer_[bottom & (RNR_JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+    if (top == bottom) {
+      // Last one, we race the thieves for it
+      if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        job = nullptr;
+      }
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+  }
+
+  Job *Steal() {
+    int64_t top = top_.load(std::memory_order_seq_cst);
+    int64_t bottom = bottom_.load(std::memory_order_seq_cst);
+    if (top >= bottom) {
+      return nullptr;
+    }
+
+    Job *job = buffer_[top & (RNR_JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      // Lost against the owner or another thief
+      return nullptr;
+    }
+    return job;
+  }
+
+ private:
+  // Thieves and the owner touch different ends
+  std::atomic<int64_t> top_;
+  char padding_[64 - sizeof(std::atomic<int64_t>)];
+  std::atomic<int64_t> bottom_;
+  std::atomic<Job*> buffer_[RNR_JOB_DEQUE_SIZE];
+};
+
+struct JobPool {
+  Job jobs[RNR_JOB_POOL_SIZE];
+  size_t next = 0;
+
+ public:
+  JobPool() {
+    for (Job& job : jobs) {
+      job.generation.store(0, std::memory_order_relaxed);
+      job.unfinished.store(0, std::memory_order_relaxed);
+      job.dependencies.store(0, std::memory_order_relaxed);
+      job.done.store(true, std::memory_order_relaxed);
+      job.released.store(true, std::memory_order_relaxed);
+      job.lock.clear();
+    }
+  }
+};
+
+struct JobSystem {
+  std::vector<std::thread> threads;
+  // One per job thread. Index 0 belongs to the thread that started the system.
+  std::vector<JobDeque*> deques;
+  std::atomic<bool> running;
+
+  // Jobs run from threads that are not job threads
+  std::mutex queue_mutex;
+  std::deque<Job*> queue;
+  std::atomic<size_t> queue_size;
+
+  // Idle workers sleep here, with no timeout. Every push bumps
+  // |work_epoch| before checking |sleeping|, and a worker bumps |sleeping|
+  // before checking |work_epoch| (all seq_cst), so either the worker sees
+  // the new job or the pusher sees the worker and notifies it.
+  std::mutex sleep_mutex;
+  std::condition_variable sleep_cv;
+  std::atomic<int> sleeping;
+  std::atomic<uint64_t> work_epoch;
+
+ public:
+  JobSystem() : running(false), queue_size(0), sleeping(0), work_epoch(0) {}
+};
+
+JobSystem *GetJobSystem() {
+  static JobSystem job_system;
+  return &job_system;
+}
+
+thread_local int g_job_thread_index = -1;
+
+// Jobs might be referenced after their thread exits (handles, children), so
+// pools are never freed. They are only created for threads that make jobs.
+JobPool *GetLocalJobPool() {
+  thread_local JobPool *pool = new JobPool();
+  return pool;
+}
+
+// Cheap per-thread random for picking steal victims
+uint32_t NextRandom() {
+  thread_local uint32_t state = 0x9E3779B9u ^ (uint32_t)(uintptr_t)&state;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+// For misuse we can't recover from. Unlike an assert, it stays in release.
+void AbortJobSystem(const char *msg) {
+  fprintf(stderr, "Job system: %s\n", msg);
+  fflush(stderr);
+  abort();
+}
+
+void LockJob(Job *job) {
+  while (job->lock.test_and_set(std::memory_order_acquire)) {
+    CpuPause();
+  }
+}
+
+void UnlockJob(Job *job) {
+  job->lock.clear(std::memory_order_release);
+}
+
+void WakeWorkers() {
+  JobSystem *job_system = GetJobSystem();
+  job_system->work_epoch.fetch_add(1, std::memory_order_seq_cst);
+  if (job_system->sleeping.load(std::memory_order_seq_cst) > 0) {
+    // Under the mutex, so it can't land between a worker's check and its wait
+    std::lock_guard<std::mutex> guard(job_system->sleep_mutex);
+    job_system->sleep_cv.notify_one();
+  }
+}
+
+void ExecuteJob(Job *job);
+
+void PushJob(Job *job) {
+  JobSystem *job_system = GetJobSystem();
+  int index = g_job_thread_index;
+  if (index >= 0) {
+    if (!job_system->deques[index]->Push(job)) {
+      // Deque full, so we just do the work ourselves
+      ExecuteJob(job);
+      return;
+    }
+  } else {
+    std::lock_guard<std::mutex> guard(job_system->queue_mutex);
+    job_system->queue.push_back(job);
+    job_system->queue_size.fetch_add(1, std::memory_order_release);
+  }
+  WakeWorkers();
+}
+
+// Own deque first, then the shared queue, then steal from a random victim
+Job *FindJob() {
+  JobSystem *job_system = GetJobSystem();
+  int index = g_job_thread_index;
+  if (index >= 0) {
+    if (Job *job = job_system->deques[index]->Pop()) {
+      return job;
+    }
+  }
+
+  if (job_system->queue_size.load(std::memory_order_acquire) > 0) {
+    std::lock_guard<std::mutex> guard(job_system->queue_mutex);
+    if (!job_system->queue.empty()) {
+      Job *job = job_system->queue.front();
+      job_system->queue.pop_front();
+      job_system->queue_size.fetch_sub(1, std::memory_order_relaxed);
+      return job;
+    }
+  }
+
+  size_t count = job_system->deques.size();
+  if (count == 0) {
+    return nullptr;
+  }
+  size_t start = NextRandom() % count;
+  for (size_t i = 0; i < count; i++) {
+    size_t victim = (start + i) % count;
+    if ((int)victim == index) {
+      continue;
+    }
+    if (Job *job = job_system->deques[victim]->Steal()) {
+      return job;
+    }
+  }
+  return nullptr;
+}
+
+void ScheduleIfReady(Job *job) {
+  if (job->dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    PushJob(job);
+  }
+}
+
+// Called once for the job itself and once for each child
+void FinishJob(Job *job) {
+  if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+
+  // After |finished| is set no continuation can be added, so we can walk
+  // them without the lock.
+  LockJob(job);
+  job->finished = true;
+  UnlockJob(job);
+  for (uint32_t i = 0; i < job->continuation_count; i++) {
+    ScheduleIfReady(job->continuations[i]);
+  }
+
+  Job *parent = job->parent;
+  job->done.store(true, std::memory_order_release);
+  if (parent) {
+    FinishJob(parent);
+  }
+}
+
+void ExecuteJob(Job *job) {
+  job->function(job, job->data);
+  FinishJob(job);
+}
+
+// Still running means this thread has RNR_JOB_POOL_SIZE jobs in flight. We
+// help until the oldest is done, like WaitForJob.
+void WaitForJobSlot(Job *job) {
+  while (!job->done.load(std::memory_order_acquire)) {
+    if (!job->released.load(std::memory_order_acquire)) {
+      AbortJobSystem("Job pool exhausted: its oldest job was never passed to RunJob, "
+                     "so it can't finish (see RNR_JOB_POOL_SIZE)");
+    }
+    if (Job *other = FindJob()) {
+      ExecuteJob(other);
+    } else {
+      CpuPause();
+    }
+  }
+}
+
+Job *AllocateJob(JobFunction function, const void *data, size_t data_size) {
+  assert(data_size <= RNR_JOB_DATA_SIZE);
+  JobPool *pool = GetLocalJobPool();
+  Job *job = &pool->jobs[pool->next++ & (RNR_JOB_POOL_SIZE - 1)];
+  WaitForJobSlot(job);
+
+  job->function = function;
+  job->parent = nullptr;
+  job->generation.fetch_add(1, std::memory_order_relaxed);
+  job->unfinished.store(1, std::memory_order_relaxed);
+  job->dependencies.store(1, std::memory_order_relaxed);
+  job->done.store(false, std::memory_order_relaxed);
+  job->released.store(false, std::memory_order_relaxed);
+  job->finished = false;
+  job->continuation_count = 0;
+  if (data_size > 0) {
+    memcpy(job->data, data, data_size);
+  }
+  return job;
+}
+
+JobHandle GetHandle(Job *job) {
+  JobHandle handle;
+  handle.job = job;
+  handle.generation = job->generation.load(std::memory_order_relaxed);
+  return handle;
+}
+
+struct ParallelForJob {
+  size_t begin;
+  size_t end;
+  size_t grain;
+  ParallelForFunction function;
+  const void *context;
+};
+
+void RunParallelForJob(Job *job, const void *data) {
+  ParallelForJob range = *(const ParallelForJob*)data;
+  JobHandle self;
+  self.job = job;
+  self.generation = job->generation.load(std::memory_order_relaxed);
+
+  // Keep the first half and hand out the second one, until we are small
+  // enough. The pieces are our children, so whoever waits on the root job
+  // waits for all of them.
+  while (range.end - range.begin > range.grain) {
+    size_t mid = range.begin + (range.end - range.begin) / 2;
+    ParallelForJob half = range;
+    half.begin = mid;
+    RunJob(CreateChildJob(self, RunParallelForJob, &half, sizeof(half)));
+    range.end = mid;
+  }
+  range.function(range.context, range.begin, range.end);
+}
+
+void WorkerMain(int index) {
+  GetThreadContext()->name = "Job worker " + std::to_string(index);
+  g_job_thread_index = index;
+
+  JobSystem *job_system = GetJobSystem();
+  int idle = 0;
+  while (job_system->running.load(std::memory_order_acquire)) {
+    // Taken before looking, so any job pushed after our last look changes it
+    uint64_t epoch = job_system->work_epoch.load(std::memory_order_seq_cst);
+    if (Job *job = FindJob()) {
+      ExecuteJob(job);
+      idle = 0;
+      continue;
+    }
+
+    if (++idle < kIdleSpinCount) {
+      CpuPause();
+      continue;
+    }
+
+    // Nothing for a while, sleep until someone pushes (see JobSystem)
+    std::unique_lock<std::mutex> lock(job_system->sleep_mutex);
+    job_system->sleeping.fetch_add(1, std::memory_order_seq_cst);
+    job_system->sleep_cv.wait(lock, [job_system, epoch]() {
+      return !job_system->running.load(std::memory_order_acquire) ||
+             job_system->work_epoch.load(std::memory_order_seq_cst) != epoch;
+    });
+    job_system->sleeping.fetch_sub(1, std::memory_order_seq_cst);
+    idle = 0;
+  }
+  g_job_thread_index = -1;
+}
+
+}   // namespace
+
+void StartJobSystem(size_t worker_count) {
+  JobSystem *job_system = GetJobSystem();
+  if (job_system->running.load()) {
+    return;
+  }
+
+  if (worker_count == (size_t)-1) {
+    size_t cores = std::thread::hardware_concurrency();
+    worker_count = cores > 1 ? cores - 1 : 0;
+  }
+
+  for (size_t i = 0; i < worker_count + 1; i++) {
+    job_system->deques.push_back(new JobDeque());
+  }
+  job_system->running.store(true, std::memory_order_release);
+
+  g_job_thread_index = 0;
+  for (size_t i = 0; i < worker_count; i++) {
+    job_system->threads.emplace_back(WorkerMain, (int)(i + 1));
+  }
+}
+
+void StopJobSystem() {
+  JobSystem *job_system = GetJobSystem();
+  if (!job_system->running.load()) {
+    return;
+  }
+
+  {
+    // Same as WakeWorkers, the store can't land between a check and a wait
+    std::lock_guard<std::mutex> guard(job_system->sleep_mutex);
+    job_system->running.store(false, std::memory_order_release);
+  }
+  job_system->sleep_cv.notify_all();
+  for (std::thread& thread : job_system->threads) {
+    thread.join();
+  }
+  job_system->threads.clear();
+
+  for (JobDeque *deque : job_system->deques) {
+    delete deque;
+  }
+  job_system->deques.clear();
+  job_system->queue.clear();
+  job_system->queue_size.store(0);
+  g_job_thread_index = -1;
+}
+
+size_t GetJobThreadCount() {
+  return GetJobSystem()->deques.size();
+}
+
+int GetJobThreadIndex() {
+  return g_job_thread_index;
+}
+
+JobHandle CreateJob(JobFunction function, const void *data, size_t data_size) {
+  return GetHandle(AllocateJob(function, data, data_size));
+}
+
+JobHandle CreateChildJob(JobHandle parent, JobFunction function, const void *data,
+                         size_t data_size) {
+  Job *job = AllocateJob(function, data, data_size);
+  if (parent.valid()) {
+    parent.job->unfinished.fetch_add(1, std::memory_order_relaxed);
+    job->parent = parent.job;
+  }
+  return GetHandle(job);
+}
+
+void AddJobDependency(JobHandle job, JobHandle dependency) {
+  Job *dependency_job = dependency.job;
+  if (!dependency_job) {
+    return;
+  }
+
+  LockJob(dependency_job);
+  bool pending = !dependency_job->finished &&
+                 dependency_job->generation.load(std::memory_order_relaxed) ==
+                     dependency.generation;
+  if (pending) {
+    if (dependency_job->continuation_count == RNR_JOB_MAX_CONTINUATIONS) {
+      UnlockJob(dependency_job);
+      AbortJobSystem("A job has more than RNR_JOB_MAX_CONTINUATIONS dependents");
+    }
+    job.job->dependencies.fetch_add(1, std::memory_order_relaxed);
+    dependency_job->continuations[dependency_job->continuation_count++] = job.job;
+  }
+  UnlockJob(dependency_job);
+}
+
+void RunJob(JobHandle job) {
+  job.job->released.store(true, std::memory_order_release);
+  ScheduleIfReady(job.job);
+}
+
+bool IsJobDone(JobHandle job) {
+  if (job.job->done.load(std::memory_order_acquire)) {
+    return true;
+  }
+  // The slot got reused, so our job finished long ago
+  return job.job->generation.load(std::memory_order_relaxed) != job.generation;
+}
+
+void ParallelFor(size_t begin, size_t end, size_t grain, ParallelForFunction function,
+                 const void *context) {
+  if (begin >= end) {
+    return;
+  }
+  if (grain == 0) {
+    grain = 1;
+  }
+  // Not worth a job
+  if (end - begin <= grain) {
+    function(context, begin, end);
+    return;
+  }
+
+  ParallelForJob range = {begin, end, grain, function, context};
+  JobHandle root = CreateJob(RunParallelForJob, &range, sizeof(range));
+  RunJob(root);
+  WaitForJob(root);
+}
+
+void WaitForJob(JobHandle job) {
+  while (!IsJobDone(job)) {
+    if (Job *other = FindJob()) {
+      ExecuteJob(other);
+    } else {
+      CpuPause();
+    }
+  }
+}
+
+}   // namespace platform
+}   // namespace renoir
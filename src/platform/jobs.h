@@ -0,0 +1,164 @@
+/******************************************************************************
+ * @file: jobs.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-17
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Work-stealing job system. There is one worker thread per core (the thread
+ * that starts the system counts as one) and each of them owns a Chase-Lev
+ * deque: the owner pushes and pops at the bottom, idle workers steal from
+ * the top of the others.
+ *
+ * Jobs are fixed-size structs allocated from a per-thread ring, so creating one
+ * never touches the heap. A job is finished once its function and all its
+ * children have run; a job can also depend on others and will only be
+ * scheduled once they finished.
+ *
+ *  JobHandle root = CreateJob([]() {});
+ *  for (size_t i = 0; i < count; i++) {
+ *    RunJob(CreateChildJob(root, [i, &items]() { Process(&items[i]); }));
+ *  }
+ *  RunJob(root);
+ *  WaitForJob(root);   // Runs jobs while waiting
+ ******************************************************************************/
+
+#ifndef SRC_PLATFORM_JOBS_H
+#define SRC_PLATFORM_JOBS_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Inline storage for the job arguments (or the lambda captures)
+#define RNR_JOB_DATA_SIZE 64
+// Jobs that can depend on a single job. Going over it aborts.
+#define RNR_JOB_MAX_CONTINUATIONS 16
+// Jobs each thread can have in flight. Slots are reused in order: when the
+// next one is still in flight, creating a job runs others until it's done.
+// If that job was never passed to RunJob it can't finish, so that aborts.
+#define RNR_JOB_POOL_SIZE 4096
+// Capacity of each worker deque. Jobs pushed into a full deque run inline.
+#define RNR_JOB_DEQUE_SIZE 4096
+
+namespace renoir {
+namespace platform {
+
+static_assert((RNR_JOB_POOL_SIZE & (RNR_JOB_POOL_SIZE - 1)) == 0,
+              "RNR_JOB_POOL_SIZE must be a power of two");
+static_assert((RNR_JOB_DEQUE_SIZE & (RNR_JOB_DEQUE_SIZE - 1)) == 0,
+              "RNR_JOB_DEQUE_SIZE must be a power of two");
+
+struct Job;
+using JobFunction = void (*)(Job *job, const void *data);
+
+struct Job {
+  JobFunction function;
+  Job *parent;
+  // Bumped every time the slot is reused, so stale handles read as done
+  std::atomic<uint32_t> generation;
+  // The job itself plus its unfinished children
+  std::atomic<int32_t> unfinished;
+  // Dependencies left, plus one held until RunJob
+  std::atomic<int32_t> dependencies;
+  // Set once |unfinished| got to 0 and the continuations and the parent were
+  // notified. Only then the slot can be reused.
+  std::atomic<bool> done;
+  // Set by RunJob. Until then the job can't finish.
+  std::atomic<bool> released;
+
+  // Guards the continuations and |finished|
+  std::atomic_flag lock;
+  bool finished;
+  uint32_t continuation_count;
+  Job *continuations[RNR_JOB_MAX_CONTINUATIONS];
+
+  alignas(16) uint8_t data[RNR_JOB_DATA_SIZE];
+};
+
+struct JobHandle {
+  Job *job = nullptr;
+  uint32_t generation = 0;
+
+ public:
+  bool valid() const { return job != nullptr; }
+};
+
+// |worker_count| threads are spawned besides the calling one, which becomes
+// worker 0. By default it's one per core.
+void StartJobSystem(size_t worker_count = (size_t)-1);
+// Waits for the workers to exit. Pending jobs are not run.
+void StopJobSystem();
+
+// Threads that run jobs, including the one that started the system
+size_t GetJobThreadCount();
+// Index of the calling thread among them, or -1 if it's not one of them
+int GetJobThreadIndex();
+
+// The job doesn't run until RunJob. |data| is copied into the job.
+JobHandle CreateJob(JobFunction function, const void *data = nullptr, size_t data_size = 0);
+// Waiting for |parent| also waits for this job
+JobHandle CreateChildJob(JobHandle parent, JobFunction function, const void *data = nullptr,
+                         size_t data_size = 0);
+// |job| won't start until |dependency| finished. Must be called before
+// RunJob(job). Aborts if |dependency| already has RNR_JOB_MAX_CONTINUATIONS.
+void AddJobDependency(JobHandle job, JobHandle dependency);
+
+// Schedules the job (once its dependencies finished)
+void RunJob(JobHandle job);
+bool IsJobDone(JobHandle job);
+// Runs other jobs until |job| is done, so waiting never idles a core
+void WaitForJob(JobHandle job);
+
+using ParallelForFunction = void (*)(const void *context, size_t begin, size_t end);
+
+// Runs |function| over [begin, end) in pieces of at most |grain| elements.
+// The range is split in halves recursively, so idle threads can steal big
+// pieces. Returns once every piece ran (the caller helps).
+void ParallelFor(size_t begin, size_t end, size_t grain, ParallelForFunction function,
+                 const void *context);
+
+namespace internal {
+
+template <typename Fn>
+void RunLambdaJob(Job *, const void *data) {
+  (*(const Fn*)data)();
+}
+
+template <typename Fn>
+void RunParallelForLambda(const void *context, size_t begin, size_t end) {
+  (*(const Fn*)context)(begin, end);
+}
+
+}   // namespace internal
+
+// |fn| is called as fn(size_t begin, size_t end). It isn't copied, so it can
+// capture anything.
+template <typename Fn>
+void ParallelFor(size_t begin, size_t end, size_t grain, const Fn& fn) {
+  ParallelFor(begin, end, grain, internal::RunParallelForLambda<Fn>, &fn);
+}
+
+// Lambda versions. The captures are copied into the job, so they have to fit
+// in RNR_JOB_DATA_SIZE and be trivially copyable (capture pointers or
+// references, not std::strings).
+template <typename Fn>
+JobHandle CreateJob(const Fn& fn) {
+  static_assert(sizeof(Fn) <= RNR_JOB_DATA_SIZE, "Job lambda captures too much");
+  static_assert(std::is_trivially_copyable<Fn>::value, "Job lambda must be trivially copyable");
+  return CreateJob(internal::RunLambdaJob<Fn>, &fn, sizeof(Fn));
+}
+
+template <typename Fn>
+JobHandle CreateChildJob(JobHandle parent, const Fn& fn) {
+  static_assert(sizeof(Fn) <= RNR_JOB_DATA_SIZE, "Job lambda captures too much");
+  static_assert(std::is_trivially_copyable<Fn>::value, "Job lambda must be trivially copyable");
+  return CreateChildJob(parent, internal::RunLambdaJob<Fn>, &fn, sizeof(Fn));
+}
+
+}   // namespace platform
+}   // namespace renoir
+
+#endif  // SRC_PLATFORM_JOBS_H
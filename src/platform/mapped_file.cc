@@ -0,0 +1,185 @@
+/******************************************************************************
+ * @file: mapped_file.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-16
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include "platform/mapped_file.h"
+
+#ifdef _WIN32
+#include "Windows.h"
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace renoir {
+namespace platform {
+
+using ::renoir::utils::CreateStatus;
+using ::renoir::utils::Status;
+using ::renoir::utils::StatusKind;
+
+#ifdef _WIN32
+
+namespace {
+
+Status MapHandle(HANDLE file_handle, size_t size, bool writable, MappedFile *out) {
+  DWORD protect = writable ? PAGE_READWRITE : PAGE_READONLY;
+  HANDLE mapping = CreateFileMappingA(file_handle, NULL, protect,
+                                      (DWORD)((uint64_t)size >> 32),
+                                      (DWORD)((uint64_t)size & 0xFFFFFFFF), NULL);
+  if (!mapping) {
+    CloseHandle(file_handle);
+    return CreateStatus(StatusKind::STATUS_ERROR, "CreateFileMapping failed: %lu",
+                        GetLastError());
+  }
+
+  DWORD access = writable ? FILE_MAP_WRITE : FILE_MAP_READ;
+  void *data = MapViewOfFile(mapping, access, 0, 0, size);
+  if (!data) {
+    CloseHandle(mapping);
+    CloseHandle(file_handle);
+    return CreateStatus(StatusKind::STATUS_ERROR, "MapViewOfFile failed: %lu",
+                        GetLastError());
+  }
+
+  out->data = (uint8_t*)data;
+  out->size = size;
+  out->writable = writable;
+  out->file_handle = file_handle;
+  out->mapping_handle = mapping;
+  return {};
+}
+
+}   // namespace
+
+Status CreateMappedFile(const char *path, size_t size, MappedFile *out) {
+  HANDLE file_handle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                                   CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file_handle == INVALID_HANDLE_VALUE) {
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not create %s: %lu", path,
+                        GetLastError());
+  }
+  // Mapping a new file with a given size extends it with zeroes
+  return MapHandle(file_handle, size, true, out);
+}
+
+Status OpenMappedFile(const char *path, MappedFile *out) {
+  HANDLE file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                   NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file_handle == INVALID_HANDLE_VALUE) {
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not open %s: %lu", path,
+                        GetLastError());
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file_handle, &size) || size.QuadPart == 0) {
+    CloseHandle(file_handle);
+    return CreateStatus(StatusKind::STATUS_ERROR, "%s is empty", path);
+  }
+  return MapHandle(file_handle, (size_t)size.QuadPart, false, out);
+}
+
+void FlushMappedFile(MappedFile *file) {
+  if (file->data) {
+    FlushViewOfFile(file->data, 0);
+  }
+}
+
+void CloseMappedFile(MappedFile *file) {
+  if (file->data) {
+    UnmapViewOfFile(file->data);
+  }
+  if (file->mapping_handle) {
+    CloseHandle((HANDLE)file->mapping_handle);
+  }
+  if (file->file_handle) {
+    CloseHandle((HANDLE)file->file_handle);
+  }
+  *file = {};
+}
+
+#else
+
+Status CreateMappedFile(const char *path, size_t size, MappedFile *out) {
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not create %s: %s", path,
+                        strerror(errno));
+  }
+  // Extending with ftruncate gives us zeroed pages
+  if (ftruncate(fd, (off_t)size) != 0) {
+    close(fd);
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not resize %s: %s", path,
+                        strerror(errno));
+  }
+
+  void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    close(fd);
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not map %s: %s", path,
+                        strerror(errno));
+  }
+
+  out->data = (uint8_t*)data;
+  out->size = size;
+  out->writable = true;
+  out->fd = fd;
+  return {};
+}
+
+Status OpenMappedFile(const char *path, MappedFile *out) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not open %s: %s", path,
+                        strerror(errno));
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    close(fd);
+    return CreateStatus(StatusKind::STATUS_ERROR, "%s is empty", path);
+  }
+
+  size_t size = (size_t)file_stat.st_size;
+  void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    close(fd);
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not map %s: %s", path,
+                        strerror(errno));
+  }
+
+  out->data = (uint8_t*)data;
+  out->size = size;
+  out->writable = false;
+  out->fd = fd;
+  return {};
+}
+
+void FlushMappedFile(MappedFile *file) {
+  if (file->data && file->writable) {
+    msync(file->data, file->size, MS_ASYNC);
+  }
+}
+
+void CloseMappedFile(MappedFile *file) {
+  if (file->data) {
+    munmap(file->data, file->size);
+  }
+  if (file->fd >= 0) {
+    close(file->fd);
+  }
+  *file = {};
+}
+
+#endif
+
+}   // namespace platform
+}   // namespace renoir
@@ -0,0 +1,50 @@
+/******************************************************************************
+ * @file: mapped_file.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-16
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: Memory mapped files (POSIX mmap / Win32 file mappings).
+ ******************************************************************************/
+
+#ifndef SRC_PLATFORM_MAPPED_FILE_H
+#define SRC_PLATFORM_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "utils/status.h"
+
+namespace renoir {
+namespace platform {
+
+struct MappedFile {
+  uint8_t *data = nullptr;
+  size_t size = 0;
+  bool writable = false;
+
+#ifdef _WIN32
+  void *file_handle = nullptr;
+  void *mapping_handle = nullptr;
+#else
+  int fd = -1;
+#endif
+};
+
+// Creates (or truncates) |path| to |size| zeroed bytes and maps it
+// read/write. Writes to the mapping survive a crash of the process.
+utils::Status CreateMappedFile(const char *path, size_t size, MappedFile *out);
+
+// Maps the whole of an existing file, read only.
+utils::Status OpenMappedFile(const char *path, MappedFile *out);
+
+// Asks the OS to start writing the dirty pages back (doesn't wait).
+void FlushMappedFile(MappedFile *file);
+
+void CloseMappedFile(MappedFile *file);
+
+}   // namespace platform
+}   // namespace renoir
+
+#endif  // SRC_PLATFORM_MAPPED_FILE_H
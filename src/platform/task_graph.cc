@@ -0,0 +1,147 @@
+/******************************************************************************
+ * @file: task_graph.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-18
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include <algorithm>
+
+#include "platform/task_graph.h"
+
+namespace renoir {
+namespace platform {
+
+namespace {
+
+void EmptyJob(Job*, const void*) {}
+
+struct TaskJobData {
+  const std::function<void()> *function;
+};
+
+void AddUnique(std::vector<size_t> *values, size_t value) {
+  if (std::find(values->begin(), values->end(), value) == values->end()) {
+    values->push_back(value);
+  }
+}
+
+}   // namespace
+
+size_t TaskGraph::AddTask(const char *name, std::function<void()> function,
+                          std::initializer_list<TaskResource> reads,
+                          std::initializer_list<TaskResource> writes,
+                          TaskAffinity affinity) {
+  Task task;
+  task.name = name;
+  task.function = std::move(function);
+  task.reads = reads;
+  task.writes = writes;
+  task.affinity = affinity;
+  tasks_.push_back(std::move(task));
+  return tasks_.size() - 1;
+}
+
+void TaskGraph::Clear() {
+  tasks_.clear();
+  resources_.clear();
+}
+
+void TaskGraph::BuildDependencies() {
+  for (auto& it : resources_) {
+    it.second.last_writer = -1;
+    it.second.readers.clear();
+  }
+
+  for (size_t i = 0; i < tasks_.size(); i++) {
+    Task& task = tasks_[i];
+    task.dependencies.clear();
+
+    for (TaskResource resource : task.reads) {
+      ResourceState& state = resources_[resource];
+      if (state.last_writer >= 0) {
+        AddUnique(&task.dependencies, (size_t)state.last_writer);
+      }
+    }
+    for (TaskResource resource : task.writes) {
+      ResourceState& state = resources_[resource];
+      if (state.last_writer >= 0) {
+        AddUnique(&task.dependencies, (size_t)state.last_writer);
+      }
+      // Write after read
+      for (size_t reader : state.readers) {
+        if (reader != i) {
+          AddUnique(&task.dependencies, reader);
+        }
+      }
+    }
+
+    // Only now, so a task that reads and writes the same resource doesn't
+    // depend on itself
+    for (TaskResource resource : task.reads) {
+      resources_[resource].readers.push_back(i);
+    }
+    for (TaskResource resource : task.writes) {
+      ResourceState& state = resources_[resource];
+      state.last_writer = (long)i;
+      state.readers.clear();
+    }
+  }
+}
+
+void TaskGraph::RunTaskJob(Job *, const void *data) {
+  const TaskJobData *task_data = (const TaskJobData*)data;
+  (*task_data->function)();
+}
+
+void TaskGraph::Run() {
+  if (tasks_.empty()) {
+    return;
+  }
+  BuildDependencies();
+
+  // Every task is a child of |root|, so waiting on it waits for the frame.
+  // Main thread tasks get an empty job that we run once the task is done,
+  // so that the tasks that depend on them can use regular job dependencies.
+  JobHandle root = CreateJob(EmptyJob);
+  for (Task& task : tasks_) {
+    if (task.affinity == TaskAffinity::MAIN_THREAD) {
+      task.job = CreateChildJob(root, EmptyJob);
+    } else {
+      TaskJobData data = {&task.function};
+      task.job = CreateChildJob(root, RunTaskJob, &data, sizeof(data));
+    }
+  }
+
+  for (Task& task : tasks_) {
+    if (task.affinity == TaskAffinity::MAIN_THREAD) {
+      continue;
+    }
+    for (size_t dependency : task.dependencies) {
+      AddJobDependency(task.job, tasks_[dependency].job);
+    }
+    RunJob(task.job);
+  }
+
+  // Dependencies always point to earlier tasks, so going in order can't
+  // wait on a main thread task we haven't run yet.
+  for (Task& task : tasks_) {
+    if (task.affinity != TaskAffinity::MAIN_THREAD) {
+      continue;
+    }
+    for (size_t dependency : task.dependencies) {
+      WaitForJob(tasks_[dependency].job);
+    }
+    task.function();
+    RunJob(task.job);
+  }
+
+  RunJob(root);
+  WaitForJob(root);
+}
+
+}   // namespace platform
+}   // namespace renoir
@@ -0,0 +1,99 @@
+/******************************************************************************
+ * @file: task_graph.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-18
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Frame-level task graph on top of the job system. Each task declares the
+ * resources it reads and writes (any pointer that identifies the data) and
+ * Run() derives the dependencies from them in the order the tasks were added:
+ * a task runs after the last writer of everything it touches, and a writer
+ * also runs after the readers that came before it. Independent tasks overlap
+ * across the job threads.
+ *
+ * Main thread tasks (eg. anything touching the GL context or ImGui) run on
+ * the thread that calls Run(), in the order they were added. While they wait
+ * for their dependencies that thread runs jobs.
+ ******************************************************************************/
+
+#ifndef SRC_PLATFORM_TASK_GRAPH_H
+#define SRC_PLATFORM_TASK_GRAPH_H
+
+#include <functional>
+#include <initializer_list>
+#include <unordered_map>
+#include <vector>
+
+#include "platform/jobs.h"
+#include "utils/macros.h"
+
+namespace renoir {
+namespace platform {
+
+using TaskResource = const void*;
+
+enum class TaskAffinity {
+  ANY_THREAD,
+  MAIN_THREAD,
+};
+
+class TaskGraph {
+ public:
+  TaskGraph() = default;
+  DISABLE_COPY(TaskGraph);
+  DISABLE_MOVE(TaskGraph);
+
+ public:
+  // |name| must be a string literal. Returns the index of the task.
+  size_t AddTask(const char *name, std::function<void()> function,
+                 std::initializer_list<TaskResource> reads,
+                 std::initializer_list<TaskResource> writes,
+                 TaskAffinity affinity = TaskAffinity::ANY_THREAD);
+  void Clear();
+
+  // Runs every task once and returns when all of them are done.
+  // Can be called every frame with the same tasks.
+  void Run();
+
+ public:
+  size_t task_count() const { return tasks_.size(); }
+  const char *GetTaskName(size_t index) const { return tasks_[index].name; }
+  // Indices of the tasks |index| waited on in the last Run
+  const std::vector<size_t>& GetTaskDependencies(size_t index) const {
+    return tasks_[index].dependencies;
+  }
+
+ private:
+  struct Task {
+    const char *name;
+    std::function<void()> function;
+    std::vector<TaskResource> reads;
+    std::vector<TaskResource> writes;
+    TaskAffinity affinity;
+
+    // Rebuilt on every Run
+    std::vector<size_t> dependencies;
+    JobHandle job;
+  };
+
+  struct ResourceState {
+    // -1 if nobody wrote it yet
+    long last_writer = -1;
+    // Tasks that read it since the last write
+    std::vector<size_t> readers;
+  };
+
+  void BuildDependencies();
+  static void RunTaskJob(Job *job, const void *data);
+
+ private:
+  std::vector<Task> tasks_;
+  std::unordered_map<TaskResource, ResourceState> resources_;
+};
+
+}   // namespace platform
+}   // namespace renoir
+
+#endif  // SRC_PLATFORM_TASK_GRAPH_H
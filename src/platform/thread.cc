@@ -11,6 +11,7 @@
 #include <atomic>
 
 #include "platform/thread.h"
+#include "utils/memory.h"
 
 namespace renoir {
 namespace platform {
@@ -23,7 +24,9 @@ std::atomic<size_t> UID_BASE(1);
 
 ThreadContext::ThreadContext() 
   : thread_id(std::this_thread::get_id()),
-    UID(std::atomic_fetch_add(&UID_BASE, 1))  {}
+    UID(std::atomic_fetch_add(&UID_BASE, 1))  {
+  utils::SetThreadMemoryUID(UID);
+}
 
 }   // namespace platform
 }   // namespace renoir
@@ -11,8 +11,13 @@
 #ifndef SRC_PLATFORM_THREAD_H
 #define SRC_PLATFORM_THREAD_H
 
+#include <string>
 #include <thread>
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
 namespace renoir {
 namespace platform {
 
@@ -31,6 +36,17 @@ inline ThreadContext *GetThreadContext() {
   return &context;
 }
 
+// Hint for busy-wait loops (lets the sibling hyperthread run)
+inline void CpuPause() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
 
 }   // namespace platform
 }   // namespace renoir
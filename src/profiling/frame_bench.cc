@@ -0,0 +1,106 @@
+/******************************************************************************
+ * @file: frame_bench.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-23
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "profiling/frame_bench.h"
+#include "profiling/trace_export.h"
+
+namespace renoir {
+namespace profiling {
+
+using ::renoir::utils::CreateStatus;
+using ::renoir::utils::Status;
+using ::renoir::utils::StatusKind;
+
+namespace {
+
+// Smallest sample with at least |percent| of the samples at or below it
+double NearestRank(const std::vector<double>& sorted, double percent) {
+  size_t rank = (size_t)std::ceil(percent / 100.0 * (double)sorted.size());
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+void WritePercentiles(FILE *file, const char *name, const FrameTimePercentiles& p) {
+  fprintf(file, "  \"%s\": {\"count\": %zu, \"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, "
+                "\"p90\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+          name, p.count, p.min_ms, p.mean_ms, p.p50_ms, p.p90_ms, p.p95_ms, p.p99_ms,
+          p.max_ms);
+}
+
+}   // namespace
+
+FrameTimePercentiles ComputeFrameTimePercentiles(std::vector<double> samples_ms) {
+  FrameTimePercentiles percentiles;
+  if (samples_ms.empty()) {
+    return percentiles;
+  }
+  std::sort(samples_ms.begin(), samples_ms.end());
+  double total = 0;
+  for (double sample : samples_ms) {
+    total += sample;
+  }
+  percentiles.count = samples_ms.size();
+  percentiles.min_ms = samples_ms.front();
+  percentiles.mean_ms = total / (double)samples_ms.size();
+  percentiles.p50_ms = NearestRank(samples_ms, 50);
+  percentiles.p90_ms = NearestRank(samples_ms, 90);
+  percentiles.p95_ms = NearestRank(samples_ms, 95);
+  percentiles.p99_ms = NearestRank(samples_ms, 99);
+  percentiles.max_ms = samples_ms.back();
+  return percentiles;
+}
+
+FrameAllocationStats ComputeFrameAllocationStats(const std::vector<uint64_t>& allocations) {
+  FrameAllocationStats stats;
+  for (uint64_t count : allocations) {
+    stats.total += count;
+    if (count > stats.max_per_frame) {
+      stats.max_per_frame = count;
+    }
+    if (count > 0) {
+      stats.frames_with_allocations++;
+    }
+  }
+  return stats;
+}
+
+Status WriteFrameBenchReport(const FrameBenchReport& report, const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not open %s", path);
+  }
+
+  fputs("{\n  \"renderer\": \"", file);
+  WriteJsonString(file, report.renderer.c_str());
+  fprintf(file, "\",\n  \"width\": %d,\n  \"height\": %d,\n", report.width, report.height);
+  fprintf(file, "  \"warmup_frames\": %zu,\n  \"frames\": %zu,\n", report.warmup_frames,
+          report.cpu_ms.size());
+  WritePercentiles(file, "cpu_ms", ComputeFrameTimePercentiles(report.cpu_ms));
+  fputs(",\n", file);
+  WritePercentiles(file, "gpu_ms", ComputeFrameTimePercentiles(report.gpu_ms));
+  FrameAllocationStats allocations = ComputeFrameAllocationStats(report.heap_allocations);
+  fprintf(file, ",\n  \"heap_allocations\": {\"total\": %llu, \"max_per_frame\": %llu, "
+                "\"frames_with_allocations\": %zu}",
+          (unsigned long long)allocations.total, (unsigned long long)allocations.max_per_frame,
+          allocations.frames_with_allocations);
+  fputs("\n}\n", file);
+
+  bool failed = ferror(file) != 0;
+  if (fclose(file) != 0 || failed) {
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not write %s", path);
+  }
+  return {};
+}
+
+}   // namespace profiling
+}   // namespace renoir
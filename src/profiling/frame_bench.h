@@ -0,0 +1,67 @@
+/******************************************************************************
+ * @file: frame_bench.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-23
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Frame times of a benchmark run (renoir_bench, renoir --headless) and
+ * their percentiles, written out as JSON so the build farm can track them.
+ ******************************************************************************/
+
+#ifndef SRC_PROFILING_FRAME_BENCH_H
+#define SRC_PROFILING_FRAME_BENCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "utils/status.h"
+
+namespace renoir {
+namespace profiling {
+
+struct FrameTimePercentiles {
+  size_t count = 0;
+  double min_ms = 0;
+  double mean_ms = 0;
+  double p50_ms = 0;
+  double p90_ms = 0;
+  double p95_ms = 0;
+  double p99_ms = 0;
+  double max_ms = 0;
+};
+
+// Nearest-rank percentiles. Takes a copy, as it sorts it.
+FrameTimePercentiles ComputeFrameTimePercentiles(std::vector<double> samples_ms);
+
+struct FrameAllocationStats {
+  uint64_t total = 0;
+  uint64_t max_per_frame = 0;
+  size_t frames_with_allocations = 0;
+};
+
+FrameAllocationStats ComputeFrameAllocationStats(const std::vector<uint64_t>& allocations);
+
+struct FrameBenchReport {
+  std::string renderer;
+  int width = 0;
+  int height = 0;
+  // Frames run before the measured ones (caches, shader compiles...)
+  size_t warmup_frames = 0;
+  // CPU time of each measured frame
+  std::vector<double> cpu_ms;
+  // GPU time of the measured frames whose timer queries came back
+  std::vector<double> gpu_ms;
+  // Heap allocations (utils::GetHeapAllocationCount) of each measured frame
+  std::vector<uint64_t> heap_allocations;
+};
+
+utils::Status WriteFrameBenchReport(const FrameBenchReport& report, const char *path);
+
+}   // namespace profiling
+}   // namespace renoir
+
+#endif  // SRC_PROFILING_FRAME_BENCH_H
@@ -0,0 +1,228 @@
+/******************************************************************************
+ * @file: gpu_profiler.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-20
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include <cstdint>
+
+#include <external/GL/gl3w.h>
+
+#include "profiling/gpu_profiler.h"
+
+namespace renoir {
+namespace profiling {
+
+namespace {
+
+// One more slot than the latency, so the frame being recorded never reuses
+// the queries of a frame we are still waiting on
+#define RNR_GPU_PROFILE_SLOTS (RNR_GPU_PROFILE_LATENCY + 1)
+
+struct GpuQueryZone {
+  const char *name;
+  uint32_t depth;
+  bool ended;
+};
+
+// The queries of one recorded frame. Zone i uses queries 2i and 2i + 1.
+struct GpuQuerySlot {
+  GLuint queries[RNR_GPU_PROFILE_MAX_ZONES * 2];
+  GpuQueryZone zones[RNR_GPU_PROFILE_MAX_ZONES];
+  uint32_t zone_count = 0;
+  // Last query issued, -1 if none
+  int last_query = -1;
+  uint64_t frame_index = 0;
+  // Recorded and not read back yet
+  bool pending = false;
+};
+
+struct GpuProfiler {
+  bool initialized = false;
+  GpuQuerySlot slots[RNR_GPU_PROFILE_SLOTS];
+  // Frames started so far. The next one records into |frame_count| % slots.
+  uint64_t frame_count = 0;
+  // Slot being recorded, nullptr between frames
+  GpuQuerySlot *current = nullptr;
+  uint32_t depth = 0;
+  uint64_t dropped = 0;
+
+  GpuFrame frames[RNR_PROFILE_FRAME_COUNT];
+  size_t resolved_count = 0;
+};
+
+GpuProfiler *GetGpuProfiler() {
+  static GpuProfiler profiler;
+  return &profiler;
+}
+
+// Non-blocking. Returns false if the results are not there yet.
+bool ResolveSlot(GpuProfiler *profiler, GpuQuerySlot *slot) {
+  if (slot->last_query >= 0) {
+    // Queries complete in order, so the last one tells for the whole frame
+    GLuint available = 0;
+    glGetQueryObjectuiv(slot->queries[slot->last_query], GL_QUERY_RESULT_AVAILABLE,
+                        &available);
+    if (!available) {
+      return false;
+    }
+  }
+
+  GpuFrame& frame = profiler->frames[profiler->resolved_count % RNR_PROFILE_FRAME_COUNT];
+  frame.index = slot->frame_index;
+  frame.duration_ms = 0;
+  frame.zones.clear();
+
+  GLuint64 begins[RNR_GPU_PROFILE_MAX_ZONES];
+  GLuint64 ends[RNR_GPU_PROFILE_MAX_ZONES];
+  GLuint64 frame_begin = UINT64_MAX;
+  GLuint64 frame_end = 0;
+  for (uint32_t i = 0; i < slot->zone_count; i++) {
+    if (!slot->zones[i].ended) {
+      continue;
+    }
+    glGetQueryObjectui64v(slot->queries[i * 2], GL_QUERY_RESULT, &begins[i]);
+    glGetQueryObjectui64v(slot->queries[i * 2 + 1], GL_QUERY_RESULT, &ends[i]);
+    frame_begin = begins[i] < frame_begin ? begins[i] : frame_begin;
+    frame_end = ends[i] > frame_end ? ends[i] : frame_end;
+  }
+
+  for (uint32_t i = 0; i < slot->zone_count; i++) {
+    const GpuQueryZone& zone = slot->zones[i];
+    if (zone.ended) {
+      frame.zones.push_back({zone.name, zone.depth, (double)(begins[i] - frame_begin) / 1e6,
+                             (double)(ends[i] - begins[i]) / 1e6});
+    }
+  }
+  if (!frame.zones.empty()) {
+    frame.duration_ms = (double)(frame_end - frame_begin) / 1e6;
+  }
+
+  slot->pending = false;
+  profiler->resolved_count++;
+  return true;
+}
+
+}   // namespace
+
+bool InitGpuProfiler() {
+  GpuProfiler *profiler = GetGpuProfiler();
+  if (profiler->initialized) {
+    return true;
+  }
+  if (!gl3wIsSupported(3, 3) || !glQueryCounter || !glGetQueryObjectui64v) {
+    return false;
+  }
+  // Some drivers expose the queries with 0 bits, which means no timing
+  GLint bits = 0;
+  glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+  if (bits == 0) {
+    return false;
+  }
+
+  for (GpuQuerySlot& slot : profiler->slots) {
+    glGenQueries(RNR_GPU_PROFILE_MAX_ZONES * 2, slot.queries);
+    slot.zone_count = 0;
+    slot.pending = false;
+  }
+  profiler->initialized = true;
+  return true;
+}
+
+void ShutdownGpuProfiler() {
+  GpuProfiler *profiler = GetGpuProfiler();
+  if (!profiler->initialized) {
+    return;
+  }
+  for (GpuQuerySlot& slot : profiler->slots) {
+    glDeleteQueries(RNR_GPU_PROFILE_MAX_ZONES * 2, slot.queries);
+  }
+  profiler->initialized = false;
+  profiler->current = nullptr;
+}
+
+void BeginGpuFrame(uint64_t frame_index) {
+  GpuProfiler *profiler = GetGpuProfiler();
+  if (!profiler->initialized) {
+    return;
+  }
+  RNR_PROFILE_SCOPE("Read GPU queries");
+
+  // Oldest first, so the history stays in order. A frame that is not ready
+  // means the later ones aren't either.
+  for (uint64_t i = RNR_GPU_PROFILE_SLOTS; i > 0; i--) {
+    if (profiler->frame_count < i) {
+      continue;
+    }
+    GpuQuerySlot& slot = profiler->slots[(profiler->frame_count - i) % RNR_GPU_PROFILE_SLOTS];
+    if (slot.pending && !ResolveSlot(profiler, &slot)) {
+      break;
+    }
+  }
+
+  GpuQuerySlot& slot = profiler->slots[profiler->frame_count % RNR_GPU_PROFILE_SLOTS];
+  if (slot.pending) {
+    // Still not ready after RNR_GPU_PROFILE_LATENCY frames. We don't wait.
+    slot.pending = false;
+    profiler->dropped++;
+  }
+  slot.zone_count = 0;
+  slot.last_query = -1;
+  slot.frame_index = frame_index;
+  profiler->current = &slot;
+  profiler->depth = 0;
+  profiler->frame_count++;
+}
+
+void EndGpuFrame() {
+  GpuProfiler *profiler = GetGpuProfiler();
+  if (!profiler->current) {
+    return;
+  }
+  profiler->current->pending = true;
+  profiler->current = nullptr;
+}
+
+int BeginGpuZone(const char *name) {
+  GpuProfiler *profiler = GetGpuProfiler();
+  GpuQuerySlot *slot = profiler->current;
+  if (!slot || slot->zone_count == RNR_GPU_PROFILE_MAX_ZONES) {
+    return -1;
+  }
+  uint32_t index = slot->zone_count++;
+  slot->zones[index] = {name, profiler->depth++, false};
+  glQueryCounter(slot->queries[index * 2], GL_TIMESTAMP);
+  slot->last_query = (int)index * 2;
+  return (int)index;
+}
+
+void EndGpuZone(int zone) {
+  GpuProfiler *profiler = GetGpuProfiler();
+  GpuQuerySlot *slot = profiler->current;
+  if (!slot || zone < 0) {
+    return;
+  }
+  glQueryCounter(slot->queries[zone * 2 + 1], GL_TIMESTAMP);
+  slot->last_query = zone * 2 + 1;
+  slot->zones[zone].ended = true;
+  profiler->depth--;
+}
+
+const GpuFrame *GetGpuFrame(size_t age) {
+  GpuProfiler *profiler = GetGpuProfiler();
+  if (age >= profiler->resolved_count || age >= RNR_PROFILE_FRAME_COUNT) {
+    return nullptr;
+  }
+  return &profiler->frames[(profiler->resolved_count - 1 - age) % RNR_PROFILE_FRAME_COUNT];
+}
+
+uint64_t GetGpuDroppedFrames() {
+  return GetGpuProfiler()->dropped;
+}
+
+}   // namespace profiling
+}   // namespace renoir
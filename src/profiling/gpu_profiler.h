@@ -0,0 +1,94 @@
+/******************************************************************************
+ * @file: gpu_profiler.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-20
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * GPU zones. RNR_GPU_PROFILE_SCOPE("name") brackets the GL commands of the
+ * scope with two GL_TIMESTAMP queries. Timestamps (instead of
+ * GL_TIME_ELAPSED) let zones nest and place them within the frame.
+ *
+ * The queries of a frame are only read once they are available, which is
+ * usually RNR_GPU_PROFILE_LATENCY frames later, so reading them never stalls
+ * the pipeline. If a frame's queries are still not ready when its slot comes
+ * around again, the frame is dropped instead of waiting.
+ *
+ * Everything must be called from the thread that owns the GL context.
+ ******************************************************************************/
+
+#ifndef SRC_PROFILING_GPU_PROFILER_H
+#define SRC_PROFILING_GPU_PROFILER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "profiling/profiler.h"
+
+// Frames whose queries can be in flight at the same time
+#define RNR_GPU_PROFILE_LATENCY 3
+// Zones per frame. Zones past it are not measured.
+#define RNR_GPU_PROFILE_MAX_ZONES 64
+
+namespace renoir {
+namespace profiling {
+
+struct GpuZone {
+  const char *name;
+  uint32_t depth;
+  // Milliseconds since the first zone of the frame began
+  double begin_ms;
+  double duration_ms;
+};
+
+struct GpuFrame {
+  // The frame index given to BeginGpuFrame
+  uint64_t index = 0;
+  // From the first zone begin to the last zone end
+  double duration_ms = 0;
+  // In begin order
+  std::vector<GpuZone> zones;
+};
+
+// Needs a current GL context with timer queries (GL 3.3 or ARB_timer_query).
+// Returns false if they are not supported; the rest of calls do nothing then.
+bool InitGpuProfiler();
+void ShutdownGpuProfiler();
+
+// Reads back whatever earlier frames finished and starts recording a new
+// one. |frame_index| tags the results (usually the profiler frame index).
+void BeginGpuFrame(uint64_t frame_index);
+void EndGpuFrame();
+
+// Returns the zone to pass to EndGpuZone, or -1 if the frame is full
+int BeginGpuZone(const char *name);
+void EndGpuZone(int zone);
+
+// Resolved frames, from the most recent (|age| 0) backwards. Only the last
+// RNR_PROFILE_FRAME_COUNT are kept. Returns nullptr past the history.
+const GpuFrame *GetGpuFrame(size_t age);
+// Frames whose queries were not ready in time and were thrown away
+uint64_t GetGpuDroppedFrames();
+
+}   // namespace profiling
+}   // namespace renoir
+
+#if RNR_PROFILE_ENABLED
+
+#define RNR_GPU_PROFILE_SCOPE_IMPL(name, zone_var)                                  \
+  int zone_var = -1;                                                                \
+  SCOPED_TRIGGER(zone_var = ::renoir::profiling::BeginGpuZone(name),                \
+                 ::renoir::profiling::EndGpuZone(zone_var))
+
+// |name| must be a string literal
+#define RNR_GPU_PROFILE_SCOPE(name)                                                 \
+  RNR_GPU_PROFILE_SCOPE_IMPL(name, COMBINE(gpu_profile_zone_, __LINE__))
+
+#else
+
+#define RNR_GPU_PROFILE_SCOPE(name)
+
+#endif
+
+#endif  // SRC_PROFILING_GPU_PROFILER_H
@@ -0,0 +1,142 @@
+/******************************************************************************
+ * @file: profile_snapshot.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-19
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+
+#include "profiling/profile_snapshot.h"
+
+namespace renoir {
+namespace profiling {
+
+namespace {
+
+struct ProfileZoneSample {
+  const char *name;
+  double ms;
+};
+
+}   // namespace
+
+const ProfileThreadInfo *ProfileSnapshot::GetThread(size_t thread_uid) const {
+  auto it = std::lower_bound(threads.begin(), threads.end(), thread_uid,
+                             [](const ProfileThreadInfo& info, size_t uid) {
+                               return info.thread_uid < uid;
+                             });
+  if (it == threads.end() || it->thread_uid != thread_uid) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+void TakeProfileSnapshot(size_t frame_count, ProfileSnapshot *out) {
+  size_t available = 0;
+  while (available < frame_count && GetProfileFrame(available)) {
+    available++;
+  }
+
+  // Which frame lands in which slot changes on every refresh, so every slot
+  // gets the largest capacity the profiler has. Otherwise a slot would grow
+  // whenever a bigger frame rotates into it.
+  size_t zone_capacity = 0;
+  for (size_t age = 0; age < available; age++) {
+    zone_capacity = std::max(zone_capacity, GetProfileFrame(age)->zones.capacity());
+  }
+
+  out->frames.resize(available);
+  for (size_t i = 0; i < available; i++) {
+    // Assigning into the existing frames keeps their zone capacity
+    out->frames[i].zones.reserve(zone_capacity);
+    out->frames[i] = *GetProfileFrame(available - 1 - i);
+  }
+
+  // The thread entries (and their names) are reused, so refreshing doesn't
+  // allocate unless a thread showed up or got a longer name
+  GlobalProfileContext *global_context = GetGlobalProfileContext();
+  std::lock_guard<std::mutex> guard(global_context->mutex);
+  size_t count = 0;
+  for (auto& it : global_context->contexts) {
+    ThreadProfileContext *context = it.second;
+    if (count == out->threads.size()) {
+      out->threads.emplace_back();
+    }
+    ProfileThreadInfo& info = out->threads[count++];
+    info.thread_uid = context->thread_uid;
+    info.name.assign(context->thread_name());
+    if (!context->alive.load(std::memory_order_acquire)) {
+      info.name.append(" (exited)");
+    }
+    info.dropped = context->dropped.load(std::memory_order_relaxed);
+  }
+  out->threads.resize(count);
+}
+
+void ComputeProfileZoneStats(const ProfileSnapshot& snapshot,
+                             std::vector<ProfileZoneStats> *out) {
+  // Kept between calls, so once it has grown computing the stats doesn't
+  // allocate
+  thread_local std::vector<ProfileZoneSample> samples;
+  samples.clear();
+  size_t zone_capacity = 0;
+  for (const ProfileFrame& frame : snapshot.frames) {
+    zone_capacity = std::max(zone_capacity, frame.zones.capacity());
+  }
+  samples.reserve(zone_capacity * snapshot.frames.size());
+  for (const ProfileFrame& frame : snapshot.frames) {
+    for (const ProfileZone& zone : frame.zones) {
+      samples.push_back({zone.name, platform::TicksToMilliseconds(zone.end - zone.begin)});
+    }
+  }
+
+  // The same name can come from different literals, so we group by content.
+  // Within a name the durations end up sorted.
+  std::sort(samples.begin(), samples.end(),
+            [](const ProfileZoneSample& a, const ProfileZoneSample& b) {
+              int compare = a.name == b.name ? 0 : strcmp(a.name, b.name);
+              return compare != 0 ? compare < 0 : a.ms < b.ms;
+            });
+
+  out->clear();
+  size_t begin = 0;
+  while (begin < samples.size()) {
+    size_t end = begin + 1;
+    while (end < samples.size() &&
+           (samples[end].name == samples[begin].name ||
+            strcmp(samples[end].name, samples[begin].name) == 0)) {
+      end++;
+    }
+
+    ProfileZoneStats stats;
+    stats.name = samples[begin].name;
+    stats.count = end - begin;
+    stats.total_ms = 0;
+    for (size_t i = begin; i < end; i++) {
+      stats.total_ms += samples[i].ms;
+    }
+    stats.min_ms = samples[begin].ms;
+    stats.max_ms = samples[end - 1].ms;
+    stats.avg_ms = stats.total_ms / (double)stats.count;
+
+    // Nearest rank: the smallest sample with at least 99% of them at or
+    // below it, ceil(0.99 * count) - 1 (in integers, so it can't round up)
+    size_t p99_rank = (stats.count * 99 + 99) / 100;
+    size_t p99_index = std::min(p99_rank > 0 ? p99_rank - 1 : 0, stats.count - 1);
+    stats.p99_ms = samples[begin + p99_index].ms;
+    out->push_back(stats);
+    begin = end;
+  }
+
+  std::sort(out->begin(), out->end(), [](const ProfileZoneStats& a, const ProfileZoneStats& b) {
+    return a.total_ms > b.total_ms;
+  });
+}
+
+}   // namespace profiling
+}   // namespace renoir
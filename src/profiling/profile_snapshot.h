@@ -0,0 +1,65 @@
+/******************************************************************************
+ * @file: profile_snapshot.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-19
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Copies of the profiled frames for whoever wants to look at them (the
+ * profiler window, exporters). Viewers work on the copy, so they neither
+ * hold the collector nor get their own cost mixed with the frames they show.
+ ******************************************************************************/
+
+#ifndef SRC_PROFILING_PROFILE_SNAPSHOT_H
+#define SRC_PROFILING_PROFILE_SNAPSHOT_H
+
+#include <string>
+#include <vector>
+
+#include "profiling/profiler.h"
+
+namespace renoir {
+namespace profiling {
+
+struct ProfileThreadInfo {
+  size_t thread_uid;
+  std::string name;
+  uint64_t dropped;
+};
+
+struct ProfileSnapshot {
+  // Oldest first
+  std::vector<ProfileFrame> frames;
+  // Sorted by UID
+  std::vector<ProfileThreadInfo> threads;
+
+ public:
+  // nullptr if the thread is not known
+  const ProfileThreadInfo *GetThread(size_t thread_uid) const;
+};
+
+// Copies the last |frame_count| frames (or as many as there are) into |out|,
+// reusing its memory. Must be called from the thread that marks frames.
+void TakeProfileSnapshot(size_t frame_count, ProfileSnapshot *out);
+
+struct ProfileZoneStats {
+  // One of the zone name literals (they are static)
+  const char *name;
+  size_t count;
+  double total_ms;
+  double min_ms;
+  double avg_ms;
+  double p99_ms;
+  double max_ms;
+};
+
+// Stats of every zone name across the frames of |snapshot|, sorted by total
+// time (descending). Reuses the memory of |out|.
+void ComputeProfileZoneStats(const ProfileSnapshot& snapshot,
+                             std::vector<ProfileZoneStats> *out);
+
+}   // namespace profiling
+}   // namespace renoir
+
+#endif  // SRC_PROFILING_PROFILE_SNAPSHOT_H
@@ -0,0 +1,154 @@
+/******************************************************************************
+ * @file: profiler.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-19
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include <algorithm>
+
+#include "profiling/profiler.h"
+
+namespace renoir {
+namespace profiling {
+
+using ::renoir::platform::GetThreadContext;
+
+ThreadProfileContext::ThreadProfileContext()
+  : thread_context(GetThreadContext()),
+    thread_uid(thread_context->UID),
+    alive(true),
+    dropped(0),
+    depth(0),
+    write_index(0),
+    read_index(0) {}
+
+bool ThreadProfileContext::Push(const ProfileEvent& event) {
+  uint64_t write = write_index.load(std::memory_order_relaxed);
+  uint64_t read = read_index.load(std::memory_order_acquire);
+  if (write - read >= RNR_PROFILE_THREAD_EVENTS) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  events[write & (RNR_PROFILE_THREAD_EVENTS - 1)] = event;
+  write_index.store(write + 1, std::memory_order_release);
+  return true;
+}
+
+bool ThreadProfileContext::Pop(ProfileEvent *out) {
+  uint64_t read = read_index.load(std::memory_order_relaxed);
+  uint64_t write = write_index.load(std::memory_order_acquire);
+  if (read == write) {
+    return false;
+  }
+  *out = events[read & (RNR_PROFILE_THREAD_EVENTS - 1)];
+  read_index.store(read + 1, std::memory_order_release);
+  return true;
+}
+
+GlobalProfileContext *GetGlobalProfileContext() {
+  static GlobalProfileContext global_context;
+  return &global_context;
+}
+
+ThreadProfileContext *RegisterThreadProfileContext() {
+  ThreadProfileContext *context = new ThreadProfileContext();
+
+  GlobalProfileContext *global_context = GetGlobalProfileContext();
+  std::lock_guard<std::mutex> guard(global_context->mutex);
+  global_context->contexts[context->thread_uid] = context;
+  return context;
+}
+
+void UnregisterThreadProfileContext(ThreadProfileContext *context) {
+  // Kept in the map, the collector might not have emptied it yet. Readers
+  // check |alive| and use the thread context under the mutex.
+  GlobalProfileContext *global_context = GetGlobalProfileContext();
+  std::lock_guard<std::mutex> guard(global_context->mutex);
+  context->exited_name = context->thread_context->name;
+  context->alive.store(false, std::memory_order_release);
+}
+
+void MarkProfileFrame() {
+  GlobalProfileContext *global_context = GetGlobalProfileContext();
+  uint64_t now = platform::GetTicks();
+  if (global_context->frame_begin == 0) {
+    global_context->frame_begin = now;
+  }
+
+  ProfileFrame& frame = global_context->frames[global_context->frame_index %
+                                                RNR_PROFILE_FRAME_COUNT];
+  frame.index = global_context->frame_index;
+  frame.begin = global_context->frame_begin;
+  frame.end = now;
+  frame.zones.clear();   // Keeps the capacity, so steady state doesn't allocate
+
+  {
+    std::lock_guard<std::mutex> guard(global_context->mutex);
+    ProfileEvent event;
+    for (auto& it : global_context->contexts) {
+      ThreadProfileContext *context = it.second;
+      while (context->Pop(&event)) {
+        frame.zones.push_back({event.name, event.begin, event.end, context->thread_uid,
+                               event.depth, -1});
+      }
+    }
+  }
+
+  // Zones are pushed when they end, so children come before their parents.
+  // Sorting by begin (parents first on ties) gives us pre-order per thread.
+  std::vector<ProfileZone>& zones = frame.zones;
+  std::sort(zones.begin(), zones.end(), [](const ProfileZone& a, const ProfileZone& b) {
+    if (a.thread_uid != b.thread_uid) {
+      return a.thread_uid < b.thread_uid;
+    }
+    if (a.begin != b.begin) {
+      return a.begin < b.begin;
+    }
+    return a.depth < b.depth;
+  });
+
+  // The parent is the closest enclosing zone. It might not be here if it
+  // ends in a later frame, so we check both the depth and the time range.
+  std::vector<int32_t>& stack = global_context->zone_stack;
+  stack.clear();
+  for (size_t i = 0; i < zones.size(); i++) {
+    ProfileZone& zone = zones[i];
+    if (i > 0 && zones[i - 1].thread_uid != zone.thread_uid) {
+      stack.clear();
+    }
+    while (!stack.empty()) {
+      const ProfileZone& top = zones[stack.back()];
+      if (top.depth < zone.depth && top.end >= zone.end) {
+        break;
+      }
+      stack.pop_back();
+    }
+    zone.parent = stack.empty() ? -1 : stack.back();
+    stack.push_back((int32_t)i);
+  }
+
+  global_context->frame_index++;
+  global_context->frame_count = std::min(global_context->frame_count + 1,
+                                         (size_t)RNR_PROFILE_FRAME_COUNT);
+  global_context->frame_begin = now;
+}
+
+void RestartProfileFrame() {
+  GetGlobalProfileContext()->frame_begin = platform::GetTicks();
+}
+
+const ProfileFrame *GetProfileFrame(size_t age) {
+  GlobalProfileContext *global_context = GetGlobalProfileContext();
+  if (age >= global_context->frame_count) {
+    return nullptr;
+  }
+  uint64_t index = global_context->frame_index - 1 - age;
+  return &global_context->frames[index % RNR_PROFILE_FRAME_COUNT];
+}
+
+}   // namespace profiling
+}   // namespace renoir
@@ -0,0 +1,215 @@
+/******************************************************************************
+ * @file: profiler.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-19
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * CPU profiler zones. RNR_PROFILE_SCOPE("name") times the rest of the scope
+ * and, when the scope exits, pushes one event (name, begin/end ticks and
+ * nesting depth) into a per-thread SPSC ring. No locks and no allocations on
+ * the instrumented thread.
+ *
+ * Once per frame the main thread calls RNR_PROFILE_FRAME(), which empties
+ * every ring into the frame that just ended and rebuilds its hierarchy
+ * (each zone knows its parent). The last RNR_PROFILE_FRAME_COUNT frames are
+ * kept.
+ *
+ * Everything compiles away with RNR_PROFILE_ENABLED set to 0.
+ ******************************************************************************/
+
+#ifndef SRC_PROFILING_PROFILER_H
+#define SRC_PROFILING_PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "platform/clock.h"
+#include "platform/thread.h"
+#include "utils/macros.h"
+#include "utils/scope_trigger.h"
+
+#ifndef RNR_PROFILE_ENABLED
+#define RNR_PROFILE_ENABLED 1
+#endif
+// Per thread zones waiting for the next frame mark. Must be a power of two.
+#define RNR_PROFILE_THREAD_EVENTS 8192
+// Frames kept after they end
+#define RNR_PROFILE_FRAME_COUNT 120
+
+namespace renoir {
+namespace profiling {
+
+static_assert((RNR_PROFILE_THREAD_EVENTS & (RNR_PROFILE_THREAD_EVENTS - 1)) == 0,
+              "RNR_PROFILE_THREAD_EVENTS must be a power of two");
+
+// |name| must point to static storage (string literals)
+struct ProfileEvent {
+  const char *name;
+  uint64_t begin;
+  uint64_t end;
+  uint32_t depth;
+};
+
+/**
+ * Same ring layout as the log rings: the owning thread is the only producer,
+ * the frame collector the only consumer, and the indices are monotonic.
+ * Zones that don't fit are dropped (and counted).
+ */
+struct ThreadProfileContext {
+  // Only valid while |alive| is set. Use thread_name() for the name.
+  platform::ThreadContext *thread_context;
+  size_t thread_uid;
+  // Cleared under the global context mutex, before the thread context is
+  // destroyed with its thread
+  std::atomic<bool> alive;
+  // Name of the thread when it exited. Guarded by the global context mutex.
+  std::string exited_name;
+  std::atomic<uint64_t> dropped;
+  // Producer only: zones currently open
+  uint32_t depth;
+
+  char padding0[64];
+  std::atomic<uint64_t> write_index;
+  char padding1[64 - sizeof(std::atomic<uint64_t>)];
+  std::atomic<uint64_t> read_index;
+  char padding2[64 - sizeof(std::atomic<uint64_t>)];
+  ProfileEvent events[RNR_PROFILE_THREAD_EVENTS];
+
+ public:
+  ThreadProfileContext();
+  DISABLE_COPY(ThreadProfileContext);
+  DISABLE_MOVE(ThreadProfileContext);
+
+ public:
+  // Producer side. Returns false if the ring was full.
+  bool Push(const ProfileEvent& event);
+  // Consumer side. Returns false if there are no pending events.
+  bool Pop(ProfileEvent *out);
+
+  // The global context mutex must be held, it keeps the thread context alive
+  const char *thread_name() const {
+    return alive.load(std::memory_order_acquire) ? thread_context->name.c_str()
+                                                 : exited_name.c_str();
+  }
+};
+
+struct ProfileZone {
+  const char *name;
+  uint64_t begin;
+  uint64_t end;
+  size_t thread_uid;
+  uint32_t depth;
+  // Index into ProfileFrame::zones, -1 for the roots
+  int32_t parent;
+};
+
+/**
+ * Every zone that ended between two frame marks. Zones are sorted by thread
+ * and then by begin time, so each thread's zones are contiguous and a parent
+ * always comes before its children.
+ */
+struct ProfileFrame {
+  uint64_t index = 0;
+  uint64_t begin = 0;
+  uint64_t end = 0;
+  std::vector<ProfileZone> zones;
+};
+
+struct GlobalProfileContext {
+  // Keyed by ThreadContext::UID, like the log contexts
+  std::map<size_t, ThreadProfileContext*> contexts;
+  // Guards |contexts|
+  std::mutex mutex;
+
+  // Frame collector state. Only touched by the thread that marks frames.
+  uint64_t frame_index = 0;
+  uint64_t frame_begin = 0;
+  ProfileFrame frames[RNR_PROFILE_FRAME_COUNT];
+  // How many of |frames| are valid
+  size_t frame_count = 0;
+  // Scratch for rebuilding the hierarchy
+  std::vector<int32_t> zone_stack;
+};
+
+GlobalProfileContext *GetGlobalProfileContext();
+
+// Allocates and registers a new context. Contexts are never freed.
+ThreadProfileContext *RegisterThreadProfileContext();
+void UnregisterThreadProfileContext(ThreadProfileContext *context);
+
+namespace internal {
+
+struct ThreadProfileContextHolder {
+  ThreadProfileContext *context;
+
+  ThreadProfileContextHolder() : context(RegisterThreadProfileContext()) {}
+  ~ThreadProfileContextHolder() { UnregisterThreadProfileContext(context); }
+};
+
+}   // namespace internal
+
+inline ThreadProfileContext *GetLocalProfileContext() {
+  thread_local internal::ThreadProfileContextHolder holder;
+  return holder.context;
+}
+
+inline uint64_t BeginProfileZone() {
+  GetLocalProfileContext()->depth++;
+  return platform::GetTicks();
+}
+
+inline void EndProfileZone(const char *name, uint64_t begin) {
+  uint64_t end = platform::GetTicks();
+  ThreadProfileContext *context = GetLocalProfileContext();
+  context->depth--;
+  context->Push({name, begin, end, context->depth});
+}
+
+// Ends the current frame and starts the next one. Must always be called from
+// the same thread (the main one).
+void MarkProfileFrame();
+
+// Moves the beginning of the frame being recorded to now, so time the main
+// thread spent idle (eg. blocked waiting for events) isn't counted as frame
+// time. Same thread as MarkProfileFrame.
+void RestartProfileFrame();
+
+// Frames that ended, from the most recent (|age| 0) backwards.
+// Returns nullptr if |age| is past the kept history.
+const ProfileFrame *GetProfileFrame(size_t age);
+
+// Index the frame being recorded will have in its ProfileFrame
+inline uint64_t GetCurrentProfileFrameIndex() {
+  return GetGlobalProfileContext()->frame_index;
+}
+
+}   // namespace profiling
+}   // namespace renoir
+
+#if RNR_PROFILE_ENABLED
+
+#define RNR_PROFILE_SCOPE_IMPL(name, begin_var)                                     \
+  uint64_t begin_var = 0;                                                           \
+  SCOPED_TRIGGER(begin_var = ::renoir::profiling::BeginProfileZone(),               \
+                 ::renoir::profiling::EndProfileZone(name, begin_var))
+
+// |name| must be a string literal
+#define RNR_PROFILE_SCOPE(name) RNR_PROFILE_SCOPE_IMPL(name, COMBINE(profile_begin_, __LINE__))
+#define RNR_PROFILE_FRAME() ::renoir::profiling::MarkProfileFrame()
+#define RNR_PROFILE_RESTART_FRAME() ::renoir::profiling::RestartProfileFrame()
+
+#else
+
+#define RNR_PROFILE_SCOPE(name)
+#define RNR_PROFILE_FRAME()
+#define RNR_PROFILE_RESTART_FRAME()
+
+#endif
+
+#endif  // SRC_PROFILING_PROFILER_H
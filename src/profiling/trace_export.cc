@@ -0,0 +1,427 @@
+/******************************************************************************
+ * @file: trace_export.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-20
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <thread>
+
+#include "profiling/trace_export.h"
+#include "utils/memory.h"
+
+namespace renoir {
+namespace profiling {
+
+using ::renoir::logging::GetGlobalLogContext;
+using ::renoir::logging::GlobalLogContext;
+using ::renoir::logging::LogEntry;
+using ::renoir::logging::LogHistory;
+using ::renoir::logging::ThreadLocalLogContext;
+using ::renoir::platform::GetThreadContext;
+using ::renoir::utils::CreateStatus;
+using ::renoir::utils::Status;
+using ::renoir::utils::StatusKind;
+
+namespace {
+
+struct PendingCapture {
+  std::unique_ptr<TraceCapture> capture;
+  std::string path;
+};
+
+struct TraceExporter {
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool running = false;
+  // Guarded by |mutex|
+  std::deque<PendingCapture> pending;
+  std::string directory;
+
+  std::atomic<bool> requested;
+  std::atomic<double> spike_threshold_ms;
+  std::atomic<size_t> written;
+
+  // Frame thread only
+  // Frames left before taking the spike capture, 0 if none is coming
+  size_t spike_frames_left = 0;
+  size_t cooldown_frames_left = 0;
+
+ public:
+  TraceExporter() : requested(false), spike_threshold_ms(0), written(0) {}
+};
+
+TraceExporter *GetTraceExporter() {
+  static TraceExporter exporter;
+  return &exporter;
+}
+
+void WriterThreadMain() {
+  GetThreadContext()->name = "Trace writer";
+  utils::SetThreadMemoryTag(utils::MEMORY_TAG_PROFILING);
+
+  TraceExporter *exporter = GetTraceExporter();
+  std::unique_lock<std::mutex> lock(exporter->mutex);
+  while (true) {
+    exporter->cv.wait(lock, [exporter]() {
+      return !exporter->running || !exporter->pending.empty();
+    });
+    // Pending captures are written even when stopping
+    if (exporter->pending.empty()) {
+      break;
+    }
+
+    PendingCapture pending = std::move(exporter->pending.front());
+    exporter->pending.pop_front();
+    lock.unlock();
+
+    Status status = WriteChromeTrace(*pending.capture, pending.path.c_str());
+    if (utils::IsStatusOk(status)) {
+      exporter->written++;
+      RNR_LOG_INFO("Wrote %s trace capture to %s", pending.capture->reason,
+                   pending.path.c_str());
+    } else {
+      RNR_LOG_ERROR("Could not write trace capture: %s", status.context.msg.c_str());
+    }
+
+    lock.lock();
+  }
+}
+
+// Copies the entries of |history| whose ticks are in [begin, end)
+void CopyLogEntries(size_t thread_uid, const LogHistory& history, uint64_t begin, uint64_t end,
+                    std::vector<TraceLogEntry> *out) {
+  // Entries of a thread are appended in the order they were logged, so their
+  // ticks are sorted. The ones dropped meanwhile are older than any other,
+  // so they count as before |begin|.
+  uint64_t count = history.Count();
+  uint64_t low = history.First();
+  uint64_t high = count;
+  LogEntry entry;
+  while (low < high) {
+    uint64_t mid = low + (high - low) / 2;
+    if (!history.Read(mid, &entry) || entry.ticks < begin) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  for (uint64_t i = low; i < count && out->size() < RNR_TRACE_MAX_LOG_ENTRIES; i++) {
+    if (!history.Read(i, &entry)) {
+      continue;
+    }
+    if (entry.ticks >= end) {
+      break;
+    }
+    out->push_back({thread_uid, entry});
+  }
+}
+
+// Microseconds since |base|. Events before |base| (zones that began in an
+// earlier frame) get negative timestamps, which the viewers handle.
+double TicksToTraceTime(uint64_t ticks, uint64_t base) {
+  if (ticks >= base) {
+    return platform::TicksToSeconds(ticks - base) * 1000000.0;
+  }
+  return -platform::TicksToSeconds(base - ticks) * 1000000.0;
+}
+
+// Length of the valid UTF-8 sequence starting at |c| (a non ASCII byte), or
+// 0 if it's not one. Overlong forms, surrogates and code points past
+// U+10FFFF are not valid either.
+size_t GetUtf8SequenceLength(const uint8_t *c) {
+  size_t len;
+  uint8_t min = 0x80, max = 0xbf;   // Range of the second byte
+  if (c[0] >= 0xc2 && c[0] <= 0xdf) {
+    len = 2;
+  } else if (c[0] >= 0xe0 && c[0] <= 0xef) {
+    len = 3;
+    if (c[0] == 0xe0) { min = 0xa0; }
+    if (c[0] == 0xed) { max = 0x9f; }
+  } else if (c[0] >= 0xf0 && c[0] <= 0xf4) {
+    len = 4;
+    if (c[0] == 0xf0) { min = 0x90; }
+    if (c[0] == 0xf4) { max = 0x8f; }
+  } else {
+    return 0;
+  }
+
+  if (c[1] < min || c[1] > max) {
+    return 0;
+  }
+  // The terminator is not a continuation byte, so we never read past it
+  for (size_t i = 2; i < len; i++) {
+    if (c[i] < 0x80 || c[i] > 0xbf) {
+      return 0;
+    }
+  }
+  return len;
+}
+
+void QueueCapture(TraceExporter *exporter, const char *reason) {
+  // No point in taking a capture nobody will write
+  {
+    std::lock_guard<std::mutex> guard(exporter->mutex);
+    if (!exporter->running) {
+      return;
+    }
+  }
+
+  auto capture = std::unique_ptr<TraceCapture>(new TraceCapture());
+  TakeTraceCapture(RNR_TRACE_CAPTURE_FRAMES, capture.get());
+  if (capture->snapshot.frames.empty()) {
+    return;
+  }
+  capture->reason = reason;
+
+  PendingCapture pending;
+  pending.path = exporter->directory + "/renoir_trace_" +
+                 std::to_string(capture->snapshot.frames.back().index) + ".json";
+  pending.capture = std::move(capture);
+  {
+    // It could have stopped while we took the capture
+    std::lock_guard<std::mutex> guard(exporter->mutex);
+    if (!exporter->running) {
+      return;
+    }
+    exporter->pending.push_back(std::move(pending));
+  }
+  exporter->cv.notify_one();
+}
+
+}   // namespace
+
+void TakeTraceCapture(size_t frame_count, TraceCapture *out) {
+  RNR_PROFILE_SCOPE("Take trace capture");
+  TakeProfileSnapshot(frame_count, &out->snapshot);
+  out->log_entries.clear();
+  out->reason = "request";
+  if (out->snapshot.frames.empty()) {
+    return;
+  }
+
+  uint64_t begin = out->snapshot.frames.front().begin;
+  uint64_t end = out->snapshot.frames.back().end;
+  std::vector<ProfileThreadInfo>& threads = out->snapshot.threads;
+
+  // Like DrainLogContexts, the global mutex is only held to snapshot the
+  // contexts (which are never freed) and read the names, which need it. The
+  // entries, up to RNR_TRACE_MAX_LOG_ENTRIES of them, are copied after.
+  std::vector<const ThreadLocalLogContext*> contexts;
+  GlobalLogContext *global_context = GetGlobalLogContext();
+  {
+    std::lock_guard<std::mutex> guard(global_context->mutex);
+    contexts.reserve(global_context->log_contexts.size());
+    for (auto& it : global_context->log_contexts) {
+      ThreadLocalLogContext *context = it.second;
+      contexts.push_back(context);
+
+      // Threads that log but have no profile zones still need a name
+      if (out->snapshot.GetThread(context->thread_uid)) {
+        continue;
+      }
+      ProfileThreadInfo info;
+      info.thread_uid = context->thread_uid;
+      info.name = context->thread_name();
+      if (!context->alive.load(std::memory_order_acquire)) {
+        info.name += " (exited)";
+      }
+      info.dropped = 0;
+      auto pos = std::lower_bound(threads.begin(), threads.end(), info.thread_uid,
+                                  [](const ProfileThreadInfo& thread, size_t uid) {
+                                    return thread.thread_uid < uid;
+                                  });
+      threads.insert(pos, std::move(info));
+    }
+  }
+
+  for (const ThreadLocalLogContext *context : contexts) {
+    CopyLogEntries(context->thread_uid, context->history, begin, end, &out->log_entries);
+  }
+}
+
+void WriteJsonString(FILE *file, const char *str) {
+  for (const char *c = str; *c; c++) {
+    if ((uint8_t)*c >= 0x80) {
+      // JSON has to be valid UTF-8. Log messages and names can hold anything
+      // (or be cut in the middle of a character), so bad bytes are replaced.
+      size_t len = GetUtf8SequenceLength((const uint8_t*)c);
+      if (len == 0) {
+        fputs("\\ufffd", file);
+      } else {
+        fwrite(c, 1, len, file);
+        c += len - 1;
+      }
+      continue;
+    }
+    switch (*c) {
+      case '"': fputs("\\\"", file); break;
+      case '\\': fputs("\\\\", file); break;
+      case '\n': fputs("\\n", file); break;
+      case '\r': fputs("\\r", file); break;
+      case '\t': fputs("\\t", file); break;
+      default:
+        if ((uint8_t)*c < 0x20) {
+          fprintf(file, "\\u%04x", (unsigned)(uint8_t)*c);
+        } else {
+          fputc(*c, file);
+        }
+        break;
+    }
+  }
+}
+
+Status WriteChromeTrace(const TraceCapture& capture, const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not open %s", path);
+  }
+  // Events are streamed straight into the file, big writes keep it cheap
+  static thread_local char file_buffer[64 * 1024];
+  setvbuf(file, file_buffer, _IOFBF, sizeof(file_buffer));
+
+  const ProfileSnapshot& snapshot = capture.snapshot;
+  uint64_t base = snapshot.frames.empty() ? 0 : snapshot.frames.front().begin;
+  bool first = true;
+  auto separator = [&]() {
+    fputs(first ? "\n" : ",\n", file);
+    first = false;
+  };
+
+  fputs("{\"displayTimeUnit\":\"ms\",\"otherData\":{\"reason\":\"", file);
+  WriteJsonString(file, capture.reason);
+  fputs("\"},\"traceEvents\":[", file);
+
+  for (const ProfileThreadInfo& thread : snapshot.threads) {
+    separator();
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,"
+                  "\"args\":{\"name\":\"", thread.thread_uid);
+    WriteJsonString(file, thread.name.c_str());
+    fputs("\"}}", file);
+  }
+
+  for (const ProfileFrame& frame : snapshot.frames) {
+    separator();
+    fprintf(file, "{\"name\":\"Frame %llu\",\"cat\":\"frame\",\"ph\":\"i\",\"s\":\"g\","
+                  "\"pid\":1,\"tid\":0,\"ts\":%.3f,\"args\":{\"duration_ms\":%.3f}}",
+            (unsigned long long)frame.index, TicksToTraceTime(frame.begin, base),
+            platform::TicksToMilliseconds(frame.end - frame.begin));
+
+    for (const ProfileZone& zone : frame.zones) {
+      separator();
+      fputs("{\"name\":\"", file);
+      WriteJsonString(file, zone.name);
+      fprintf(file, "\",\"cat\":\"zone\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,"
+                    "\"ts\":%.3f,\"dur\":%.3f}",
+              zone.thread_uid, TicksToTraceTime(zone.begin, base),
+              platform::TicksToSeconds(zone.end - zone.begin) * 1000000.0);
+    }
+  }
+
+  char message[1024];
+  for (const TraceLogEntry& log_entry : capture.log_entries) {
+    const LogEntry& entry = log_entry.entry;
+    logging::FormatLogEntry(entry, message, sizeof(message));
+    separator();
+    fputs("{\"name\":\"", file);
+    WriteJsonString(file, message);
+    fprintf(file, "\",\"cat\":\"log\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%zu,"
+                  "\"ts\":%.3f,\"args\":{\"level\":\"%s\",\"location\":\"",
+            log_entry.thread_uid, TicksToTraceTime(entry.ticks, base),
+            logging::GetLogLevelShortName(entry.level));
+    WriteJsonString(file, entry.filename);
+    fprintf(file, ":%zu\"}}", entry.line);
+  }
+
+  fputs("\n]}\n", file);
+  bool failed = ferror(file) != 0;
+  if (fclose(file) != 0 || failed) {
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not write %s", path);
+  }
+  return {};
+}
+
+void StartTraceExporter(std::string directory, double spike_threshold_ms) {
+  TraceExporter *exporter = GetTraceExporter();
+  std::lock_guard<std::mutex> guard(exporter->mutex);
+  if (exporter->running) {
+    return;
+  }
+  exporter->directory = std::move(directory);
+  exporter->spike_threshold_ms = spike_threshold_ms;
+  exporter->running = true;
+  exporter->thread = std::thread(WriterThreadMain);
+}
+
+void StopTraceExporter() {
+  TraceExporter *exporter = GetTraceExporter();
+  {
+    std::lock_guard<std::mutex> guard(exporter->mutex);
+    if (!exporter->running) {
+      return;
+    }
+    exporter->running = false;
+  }
+  exporter->cv.notify_one();
+  exporter->thread.join();
+}
+
+void RequestTraceCapture() {
+  GetTraceExporter()->requested = true;
+}
+
+void UpdateTraceExporter() {
+  TraceExporter *exporter = GetTraceExporter();
+  if (exporter->requested.exchange(false)) {
+    QueueCapture(exporter, "request");
+  }
+
+  if (exporter->cooldown_frames_left > 0) {
+    exporter->cooldown_frames_left--;
+  }
+  if (exporter->spike_frames_left > 0) {
+    if (--exporter->spike_frames_left == 0) {
+      QueueCapture(exporter, "spike");
+      exporter->cooldown_frames_left = RNR_TRACE_SPIKE_COOLDOWN_FRAMES;
+    }
+    return;
+  }
+
+  double threshold = exporter->spike_threshold_ms.load();
+  const ProfileFrame *frame = GetProfileFrame(0);
+  if (threshold <= 0 || !frame || exporter->cooldown_frames_left > 0) {
+    return;
+  }
+  if (platform::TicksToMilliseconds(frame->end - frame->begin) > threshold) {
+    RNR_LOG_WARN("Frame %llu took %.2f ms, capturing a trace",
+                 (unsigned long long)frame->index,
+                 platform::TicksToMilliseconds(frame->end - frame->begin));
+    exporter->spike_frames_left = RNR_TRACE_SPIKE_POST_FRAMES;
+  }
+}
+
+void SetTraceSpikeThreshold(double spike_threshold_ms) {
+  GetTraceExporter()->spike_threshold_ms = spike_threshold_ms;
+}
+
+double GetTraceSpikeThreshold() {
+  return GetTraceExporter()->spike_threshold_ms.load();
+}
+
+size_t GetTraceCaptureCount() {
+  return GetTraceExporter()->written.load();
+}
+
+}   // namespace profiling
+}   // namespace renoir
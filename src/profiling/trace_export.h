@@ -0,0 +1,94 @@
+/******************************************************************************
+ * @file: trace_export.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-20
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Captures of the profiled frames, exported as Chrome Trace Event Format
+ * JSON (chrome://tracing, Perfetto). A capture holds the zones of the last
+ * frames, the log entries logged in the same time span and a marker per
+ * frame.
+ *
+ * Captures are taken on request (RequestTraceCapture, eg. from a hotkey) or
+ * when a frame takes longer than the spike threshold. In the latter case the
+ * capture waits a few more frames, so it shows what came after the hitch as
+ * well. The main thread only copies the data; the JSON is written by the
+ * trace writer thread.
+ ******************************************************************************/
+
+#ifndef SRC_PROFILING_TRACE_EXPORT_H
+#define SRC_PROFILING_TRACE_EXPORT_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "logging/log.h"
+#include "profiling/profile_snapshot.h"
+#include "utils/status.h"
+
+// Frames slower than this trigger a capture by default
+#ifndef RNR_TRACE_SPIKE_THRESHOLD_MS
+#define RNR_TRACE_SPIKE_THRESHOLD_MS 100.0
+#endif
+// Frames in a capture (at most RNR_PROFILE_FRAME_COUNT)
+#define RNR_TRACE_CAPTURE_FRAMES 60
+// Frames recorded after a spike before the capture is taken
+#define RNR_TRACE_SPIKE_POST_FRAMES 10
+// Frames after a spike capture during which spikes are ignored
+#define RNR_TRACE_SPIKE_COOLDOWN_FRAMES 600
+// Log entries copied into a capture, to bound what the main thread copies
+#define RNR_TRACE_MAX_LOG_ENTRIES 100000
+
+namespace renoir {
+namespace profiling {
+
+static_assert(RNR_TRACE_CAPTURE_FRAMES <= RNR_PROFILE_FRAME_COUNT,
+              "A capture can't have more frames than the profiler keeps");
+
+struct TraceLogEntry {
+  size_t thread_uid;
+  logging::LogEntry entry;
+};
+
+struct TraceCapture {
+  // Oldest first. Includes every thread that logged, not just the profiled ones.
+  ProfileSnapshot snapshot;
+  // Sorted by thread and then by time
+  std::vector<TraceLogEntry> log_entries;
+  // Why the capture was taken ("request", "spike")
+  const char *reason;
+};
+
+// Copies the last |frame_count| frames and the log entries within them.
+// Must be called from the thread that marks frames.
+void TakeTraceCapture(size_t frame_count, TraceCapture *out);
+
+// Timestamps are in microseconds since the beginning of the first frame
+utils::Status WriteChromeTrace(const TraceCapture& capture, const char *path);
+// Writes |str| as the contents of a JSON string (without the quotes)
+void WriteJsonString(FILE *file, const char *str);
+
+// Captures are written as |directory|/renoir_trace_<frame>.json.
+// |spike_threshold_ms| <= 0 disables the spike captures.
+void StartTraceExporter(std::string directory, double spike_threshold_ms);
+// Writes the pending captures and joins the writer thread
+void StopTraceExporter();
+
+// Can be called from any thread. The capture is taken on the next
+// UpdateTraceExporter.
+void RequestTraceCapture();
+// Call once per frame, after RNR_PROFILE_FRAME(), from the same thread
+void UpdateTraceExporter();
+
+void SetTraceSpikeThreshold(double spike_threshold_ms);
+double GetTraceSpikeThreshold();
+// Captures written so far
+size_t GetTraceCaptureCount();
+
+}   // namespace profiling
+}   // namespace renoir
+
+#endif  // SRC_PROFILING_TRACE_EXPORT_H
@@ -0,0 +1,622 @@
+/******************************************************************************
+ * @file: memory.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-26
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description: TODO(Cristian): Add description
+ ******************************************************************************/
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "utils/memory.h"
+
+namespace renoir {
+namespace utils {
+
+namespace {
+
+// Counters of one thread. Only that thread writes them (plain load + store),
+// any thread can read them.
+struct TagCounters {
+  std::atomic<int64_t> heap_bytes;
+  std::atomic<int64_t> pooled_bytes;
+  std::atomic<int64_t> external_bytes;
+  std::atomic<uint64_t> heap_allocations;
+  std::atomic<uint64_t> pool_allocations;
+  std::atomic<uint64_t> frees;
+};
+
+struct ThreadMemoryCounters {
+  TagCounters tags[MEMORY_TAG_COUNT];
+  std::atomic<size_t> thread_uid;
+  // Never removed, the counters of a thread outlive it
+  ThreadMemoryCounters *next;
+};
+
+// Constant initialized, so they work for the allocations of static
+// constructors too. Plain thread_locals, so they need no guard and are still
+// there while the thread's other thread_locals are destroyed.
+std::atomic<ThreadMemoryCounters*> thread_counters_head(nullptr);
+std::atomic<size_t> thread_counters_count(0);
+thread_local ThreadMemoryCounters *thread_counters = nullptr;
+thread_local MemoryTag thread_memory_tag = MEMORY_TAG_GENERAL;
+
+template <typename T>
+inline void AddToCounter(std::atomic<T> *counter, T value) {
+  counter->store(counter->load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+ThreadMemoryCounters *GetThreadCounters() {
+  ThreadMemoryCounters *counters = thread_counters;
+  if (counters) {
+    return counters;
+  }
+  // Straight from malloc, HeapAllocate would come back here. All zeros is a
+  // valid state for the atomics.
+  void *raw = calloc(1, sizeof(ThreadMemoryCounters));
+  if (!raw) {
+    // Out of memory. Whatever this thread does won't be counted.
+    static ThreadMemoryCounters lost_counters;
+    return &lost_counters;
+  }
+  counters = new (raw) ThreadMemoryCounters();
+  ThreadMemoryCounters *head = thread_counters_head.load(std::memory_order_relaxed);
+  do {
+    counters->next = head;
+  } while (!thread_counters_head.compare_exchange_weak(head, counters, std::memory_order_release,
+                                                       std::memory_order_relaxed));
+  thread_counters_count.fetch_add(1, std::memory_order_relaxed);
+  thread_counters = counters;
+  return counters;
+}
+
+void ReadTagCounters(const TagCounters& counters, MemoryTagStats *stats) {
+  stats->live_heap_bytes += counters.heap_bytes.load(std::memory_order_relaxed);
+  stats->live_pooled_bytes += counters.pooled_bytes.load(std::memory_order_relaxed);
+  stats->external_bytes += counters.external_bytes.load(std::memory_order_relaxed);
+  stats->heap_allocations += counters.heap_allocations.load(std::memory_order_relaxed);
+  stats->pool_allocations += counters.pool_allocations.load(std::memory_order_relaxed);
+  stats->frees += counters.frees.load(std::memory_order_relaxed);
+}
+
+// Sums over every thread
+void SumTagCounters(MemoryTagStats stats[MEMORY_TAG_COUNT]) {
+  for (ThreadMemoryCounters *counters = thread_counters_head.load(std::memory_order_acquire);
+       counters; counters = counters->next) {
+    for (size_t tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+      ReadTagCounters(counters->tags[tag], &stats[tag]);
+    }
+  }
+}
+
+inline int64_t TotalBytes(const MemoryTagStats& stats) {
+  return stats.live_heap_bytes + stats.live_pooled_bytes + stats.external_bytes;
+}
+
+inline bool IsTagUsed(const MemoryTagStats& stats) {
+  return stats.heap_allocations + stats.pool_allocations + stats.frees > 0 ||
+         stats.external_bytes != 0;
+}
+
+void WriteTagStats(FILE *file, const MemoryTagStats& stats) {
+  fprintf(file, "{\"live_heap_bytes\": %lld, \"live_pooled_bytes\": %lld, "
+                "\"external_bytes\": %lld, \"peak_bytes\": %lld, \"heap_allocations\": %llu, "
+                "\"pool_allocations\": %llu, \"frees\": %llu, \"last_frame_allocations\": %llu}",
+          (long long)stats.live_heap_bytes, (long long)stats.live_pooled_bytes,
+          (long long)stats.external_bytes, (long long)stats.peak_bytes,
+          (unsigned long long)stats.heap_allocations, (unsigned long long)stats.pool_allocations,
+          (unsigned long long)stats.frees, (unsigned long long)stats.last_frame_allocations);
+}
+
+const char *kMemoryTagNames[MEMORY_TAG_COUNT] = {
+  "general", "logging", "imgui", "dock", "gl_staging", "profiling", "allocators",
+};
+
+// In front of every HeapAllocate block
+struct HeapHeader {
+  uint64_t size;
+  MemoryTag tag;
+};
+static_assert(sizeof(HeapHeader) <= RNR_MEMORY_ALIGNMENT, "HeapHeader has to fit its slot");
+
+inline uintptr_t AlignUp(uintptr_t value, size_t alignment) {
+  return (value + alignment - 1) & ~(uintptr_t)(alignment - 1);
+}
+
+// In front of every PoolAllocate block. A whole alignment unit, so the
+// memory after it stays aligned.
+struct PoolHeader {
+  uint32_t pool_class;
+  MemoryTag tag;
+  uint64_t size;
+};
+static_assert(sizeof(PoolHeader) <= RNR_MEMORY_ALIGNMENT, "PoolHeader has to fit its slot");
+
+// Marks the PoolAllocate blocks that went to the heap
+#define RNR_POOL_CLASS_LARGE 0xFFFFFFFFu
+
+struct MemoryPools {
+  std::mutex mutexes[RNR_POOL_CLASS_COUNT];
+  std::aligned_storage<sizeof(FixedPool), alignof(FixedPool)>::type
+      pool_storage[RNR_POOL_CLASS_COUNT];
+  FixedPool *pools[RNR_POOL_CLASS_COUNT];
+  std::atomic<size_t> large_allocations;
+
+  MemoryPools() : large_allocations(0) {
+    for (size_t i = 0; i < RNR_POOL_CLASS_COUNT; i++) {
+      size_t block_size = RNR_MEMORY_ALIGNMENT + ((size_t)RNR_POOL_MIN_SIZE << i);
+      pools[i] = new (&pool_storage[i]) FixedPool(block_size, RNR_POOL_PAGE_SIZE / block_size);
+    }
+  }
+};
+
+// Never destroyed: ImGui (and others) can free their blocks while the
+// statics are being torn down
+MemoryPools *GetMemoryPools() {
+  static std::aligned_storage<sizeof(MemoryPools), alignof(MemoryPools)>::type storage;
+  static MemoryPools *pools = new (&storage) MemoryPools();
+  return pools;
+}
+
+uint32_t GetPoolClass(size_t size) {
+  uint32_t pool_class = 0;
+  for (size_t class_size = RNR_POOL_MIN_SIZE; class_size < size; class_size <<= 1) {
+    pool_class++;
+  }
+  return pool_class < RNR_POOL_CLASS_COUNT ? pool_class : RNR_POOL_CLASS_LARGE;
+}
+
+// Sampled by BeginMemoryFrame
+struct TagFrameState {
+  int64_t peak_bytes = 0;
+  uint64_t frame_allocations = 0;
+  uint64_t last_frame_allocations = 0;
+};
+
+struct FrameArenas {
+  LinearArena first;
+  LinearArena second;
+  LinearArena *current;
+  uint64_t frame_count = 0;
+  uint64_t frame_heap_allocations = 0;
+  MemoryStats stats;
+  TagFrameState tags[MEMORY_TAG_COUNT];
+
+  FrameArenas()
+      : first(RNR_FRAME_ARENA_SIZE), second(RNR_FRAME_ARENA_SIZE), current(&first) {}
+};
+
+FrameArenas *GetFrameArenas() {
+  static FrameArenas arenas;
+  return &arenas;
+}
+
+}   // namespace
+
+const char *GetMemoryTagName(MemoryTag tag) {
+  return tag < MEMORY_TAG_COUNT ? kMemoryTagNames[tag] : "unknown";
+}
+
+MemoryTag SetThreadMemoryTag(MemoryTag tag) {
+  MemoryTag previous = thread_memory_tag;
+  thread_memory_tag = tag;
+  return previous;
+}
+
+MemoryTag GetThreadMemoryTag() {
+  return thread_memory_tag;
+}
+
+void SetThreadMemoryUID(size_t thread_uid) {
+  GetThreadCounters()->thread_uid.store(thread_uid, std::memory_order_relaxed);
+}
+
+void TrackExternalBytes(MemoryTag tag, int64_t delta) {
+  AddToCounter(&GetThreadCounters()->tags[tag].external_bytes, delta);
+}
+
+void *HeapAllocate(size_t size) {
+  uint8_t *raw = (uint8_t*)malloc(RNR_MEMORY_ALIGNMENT + size);
+  if (!raw) {
+    return nullptr;
+  }
+  MemoryTag tag = thread_memory_tag;
+  HeapHeader *header = (HeapHeader*)raw;
+  header->size = size;
+  header->tag = tag;
+  TagCounters *counters = &GetThreadCounters()->tags[tag];
+  AddToCounter(&counters->heap_allocations, (uint64_t)1);
+  AddToCounter(&counters->heap_bytes, (int64_t)size);
+  return raw + RNR_MEMORY_ALIGNMENT;
+}
+
+void HeapFree(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+  uint8_t *raw = (uint8_t*)ptr - RNR_MEMORY_ALIGNMENT;
+  const HeapHeader *header = (const HeapHeader*)raw;
+  TagCounters *counters = &GetThreadCounters()->tags[header->tag];
+  AddToCounter(&counters->frees, (uint64_t)1);
+  AddToCounter(&counters->heap_bytes, -(int64_t)header->size);
+  free(raw);
+}
+
+uint64_t GetHeapAllocationCount() {
+  uint64_t count = 0;
+  for (ThreadMemoryCounters *counters = thread_counters_head.load(std::memory_order_acquire);
+       counters; counters = counters->next) {
+    for (const TagCounters& tag : counters->tags) {
+      count += tag.heap_allocations.load(std::memory_order_relaxed);
+    }
+  }
+  return count;
+}
+
+LinearArena::LinearArena(size_t capacity) : capacity_(capacity) {
+  RNR_MEMORY_TAG(MEMORY_TAG_ALLOCATORS);
+  if (capacity_ > 0) {
+    buffer_ = (uint8_t*)HeapAllocate(capacity_);
+  }
+}
+
+LinearArena::~LinearArena() {
+  Reset();
+  HeapFree(buffer_);
+}
+
+void *LinearArena::Allocate(size_t size, size_t alignment) {
+  uintptr_t base = (uintptr_t)buffer_;
+  uintptr_t start = AlignUp(base + used_, alignment);
+  if (buffer_ && start + size <= base + capacity_) {
+    used_ = (size_t)(start - base) + size;
+    peak_ = used() > peak_ ? used() : peak_;
+    return (void*)start;
+  }
+
+  // Doesn't fit. The link to the other blocks goes in front.
+  RNR_MEMORY_TAG(MEMORY_TAG_ALLOCATORS);
+  uint8_t *raw = (uint8_t*)HeapAllocate(sizeof(OverflowBlock) + alignment + size);
+  if (!raw) {
+    return nullptr;
+  }
+  OverflowBlock *block = (OverflowBlock*)raw;
+  block->next = overflow_blocks_;
+  overflow_blocks_ = block;
+  overflow_bytes_ += size;
+  overflows_++;
+  peak_ = used() > peak_ ? used() : peak_;
+  return (void*)AlignUp((uintptr_t)(raw + sizeof(OverflowBlock)), alignment);
+}
+
+void LinearArena::Reset() {
+  if (overflow_blocks_) {
+    while (overflow_blocks_) {
+      OverflowBlock *next = overflow_blocks_->next;
+      HeapFree(overflow_blocks_);
+      overflow_blocks_ = next;
+    }
+    // Whatever overflowed this time would do it every time
+    RNR_MEMORY_TAG(MEMORY_TAG_ALLOCATORS);
+    size_t capacity = capacity_ > 0 ? capacity_ : RNR_MEMORY_ALIGNMENT;
+    while (capacity < peak_) {
+      capacity *= 2;
+    }
+    HeapFree(buffer_);
+    buffer_ = (uint8_t*)HeapAllocate(capacity);
+    capacity_ = buffer_ ? capacity : 0;
+  }
+  used_ = 0;
+  overflow_bytes_ = 0;
+}
+
+FixedPool::FixedPool(size_t block_size, size_t blocks_per_page)
+    : block_size_(AlignUp(block_size > sizeof(FreeBlock) ? block_size : sizeof(FreeBlock),
+                          RNR_MEMORY_ALIGNMENT)),
+      blocks_per_page_(blocks_per_page > 0 ? blocks_per_page : 1) {}
+
+FixedPool::~FixedPool() {
+  while (pages_) {
+    Page *next = pages_->next;
+    HeapFree(pages_);
+    pages_ = next;
+  }
+}
+
+void *FixedPool::Allocate() {
+  if (!free_list_) {
+    // The page header takes a whole alignment unit, the blocks follow
+    RNR_MEMORY_TAG(MEMORY_TAG_ALLOCATORS);
+    uint8_t *raw = (uint8_t*)HeapAllocate(RNR_MEMORY_ALIGNMENT + blocks_per_page_ * block_size_);
+    if (!raw) {
+      return nullptr;
+    }
+    Page *page = (Page*)raw;
+    page->next = pages_;
+    pages_ = page;
+    // Threaded backwards, so the blocks are handed out in address order
+    uint8_t *blocks = raw + RNR_MEMORY_ALIGNMENT;
+    for (size_t i = blocks_per_page_; i > 0; i--) {
+      FreeBlock *block = (FreeBlock*)(blocks + (i - 1) * block_size_);
+      block->next = free_list_;
+      free_list_ = block;
+    }
+    block_count_ += blocks_per_page_;
+  }
+
+  FreeBlock *block = free_list_;
+  free_list_ = block->next;
+  blocks_in_use_++;
+  return block;
+}
+
+void FixedPool::Free(void *ptr) {
+  FreeBlock *block = (FreeBlock*)ptr;
+  block->next = free_list_;
+  free_list_ = block;
+  blocks_in_use_--;
+}
+
+void *PoolAllocate(size_t size) {
+  uint32_t pool_class = GetPoolClass(size);
+  uint8_t *raw = nullptr;
+  MemoryPools *pools = GetMemoryPools();
+  MemoryTag tag = thread_memory_tag;
+  if (pool_class == RNR_POOL_CLASS_LARGE) {
+    // Tracked as heap by HeapAllocate
+    raw = (uint8_t*)HeapAllocate(RNR_MEMORY_ALIGNMENT + size);
+    pools->large_allocations.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    {
+      std::lock_guard<std::mutex> guard(pools->mutexes[pool_class]);
+      raw = (uint8_t*)pools->pools[pool_class]->Allocate();
+    }
+    if (raw) {
+      TagCounters *counters = &GetThreadCounters()->tags[tag];
+      AddToCounter(&counters->pool_allocations, (uint64_t)1);
+      AddToCounter(&counters->pooled_bytes, (int64_t)size);
+    }
+  }
+  if (!raw) {
+    return nullptr;
+  }
+  PoolHeader *header = (PoolHeader*)raw;
+  header->pool_class = pool_class;
+  header->tag = tag;
+  header->size = size;
+  return raw + RNR_MEMORY_ALIGNMENT;
+}
+
+void PoolFree(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+  uint8_t *raw = (uint8_t*)ptr - RNR_MEMORY_ALIGNMENT;
+  const PoolHeader *header = (const PoolHeader*)raw;
+  uint32_t pool_class = header->pool_class;
+  MemoryPools *pools = GetMemoryPools();
+  if (pool_class == RNR_POOL_CLASS_LARGE) {
+    pools->large_allocations.fetch_sub(1, std::memory_order_relaxed);
+    HeapFree(raw);
+    return;
+  }
+  TagCounters *counters = &GetThreadCounters()->tags[header->tag];
+  AddToCounter(&counters->frees, (uint64_t)1);
+  AddToCounter(&counters->pooled_bytes, -(int64_t)header->size);
+  std::lock_guard<std::mutex> guard(pools->mutexes[pool_class]);
+  pools->pools[pool_class]->Free(raw);
+}
+
+void BeginMemoryFrame() {
+  FrameArenas *arenas = GetFrameArenas();
+  MemoryStats& stats = arenas->stats;
+  LinearArena *finished = arenas->current;
+  stats.frame_arena_used = finished->used();
+  stats.frame_arena_peak = finished->peak();
+
+  // The older arena, whose allocations are two frames old now. Growing it is
+  // charged to the frame that overflowed it.
+  arenas->current = finished == &arenas->first ? &arenas->second : &arenas->first;
+  arenas->current->Reset();
+  stats.frame_arena_capacity = arenas->current->capacity();
+  stats.frame_arena_overflows = arenas->first.overflows() + arenas->second.overflows();
+
+  uint64_t heap_count = GetHeapAllocationCount();
+  if (arenas->frame_count > 0) {
+    stats.last_frame_heap_allocations = heap_count - arenas->frame_heap_allocations;
+    stats.clean_frames = stats.last_frame_heap_allocations == 0 ? stats.clean_frames + 1 : 0;
+  }
+  arenas->frame_heap_allocations = heap_count;
+
+  // Peaks are only seen at frame boundaries, a spike within a frame that is
+  // gone by its end is missed
+  MemoryTagStats tags[MEMORY_TAG_COUNT];
+  SumTagCounters(tags);
+  for (size_t tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+    TagFrameState& state = arenas->tags[tag];
+    int64_t total = TotalBytes(tags[tag]);
+    state.peak_bytes = total > state.peak_bytes ? total : state.peak_bytes;
+    uint64_t allocations = tags[tag].heap_allocations + tags[tag].pool_allocations;
+    if (arenas->frame_count > 0) {
+      state.last_frame_allocations = allocations - state.frame_allocations;
+    }
+    state.frame_allocations = allocations;
+  }
+  arenas->frame_count++;
+}
+
+void *FrameAllocate(size_t size, size_t alignment) {
+  return GetFrameArenas()->current->Allocate(size, alignment);
+}
+
+const char *FrameFormattedString(const char *fmt, ...) {
+  va_list arglist;
+  va_start(arglist, fmt);
+  va_list arglist_copy;
+  va_copy(arglist_copy, arglist);
+  int length = vsnprintf(nullptr, 0, fmt, arglist);
+  va_end(arglist);
+
+  char *str = length >= 0 ? (char*)FrameAllocate((size_t)length + 1, 1) : nullptr;
+  if (str) {
+    vsnprintf(str, (size_t)length + 1, fmt, arglist_copy);
+  }
+  va_end(arglist_copy);
+  return str ? str : "";
+}
+
+void GetMemoryTagStats(MemoryTagStats stats[MEMORY_TAG_COUNT]) {
+  for (size_t tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+    stats[tag] = MemoryTagStats();
+  }
+  SumTagCounters(stats);
+  const FrameArenas *arenas = GetFrameArenas();
+  for (size_t tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+    const TagFrameState& state = arenas->tags[tag];
+    int64_t total = TotalBytes(stats[tag]);
+    stats[tag].peak_bytes = total > state.peak_bytes ? total : state.peak_bytes;
+    stats[tag].last_frame_allocations = state.last_frame_allocations;
+  }
+}
+
+size_t GetTrackedThreadCount() {
+  return thread_counters_count.load(std::memory_order_relaxed);
+}
+
+size_t GetThreadMemoryUsage(ThreadMemoryUsage *usage, size_t max_count) {
+  size_t count = 0;
+  for (ThreadMemoryCounters *counters = thread_counters_head.load(std::memory_order_acquire);
+       counters && count < max_count; counters = counters->next) {
+    ThreadMemoryUsage& thread_usage = usage[count++];
+    thread_usage = ThreadMemoryUsage();
+    thread_usage.thread_uid = counters->thread_uid.load(std::memory_order_relaxed);
+    for (size_t tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+      ReadTagCounters(counters->tags[tag], &thread_usage.tags[tag]);
+    }
+  }
+  return count;
+}
+
+MemoryStats GetMemoryStats() {
+  MemoryStats stats = GetFrameArenas()->stats;
+  stats.heap_allocations = GetHeapAllocationCount();
+  MemoryPools *pools = GetMemoryPools();
+  for (size_t i = 0; i < RNR_POOL_CLASS_COUNT; i++) {
+    std::lock_guard<std::mutex> guard(pools->mutexes[i]);
+    const FixedPool *pool = pools->pools[i];
+    stats.pools[i].block_size = pool->block_size() - RNR_MEMORY_ALIGNMENT;
+    stats.pools[i].blocks_in_use = pool->blocks_in_use();
+    stats.pools[i].block_count = pool->block_count();
+  }
+  stats.large_allocations = pools->large_allocations.load(std::memory_order_relaxed);
+  return stats;
+}
+
+Status WriteMemoryReport(const char *path) {
+  // Read before the file is opened, which allocates
+  MemoryTagStats tags[MEMORY_TAG_COUNT];
+  GetMemoryTagStats(tags);
+  // Threads can start in between, the ones that don't fit are left out
+  std::vector<ThreadMemoryUsage> threads(GetTrackedThreadCount());
+  threads.resize(GetThreadMemoryUsage(threads.data(), threads.size()));
+  MemoryStats stats = GetMemoryStats();
+
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not open %s", path);
+  }
+
+  fprintf(file, "{\n  \"heap_allocations\": %llu,\n  \"last_frame_heap_allocations\": %llu,\n",
+          (unsigned long long)stats.heap_allocations,
+          (unsigned long long)stats.last_frame_heap_allocations);
+  fputs("  \"tags\": {", file);
+  for (size_t tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+    fprintf(file, "%s\n    \"%s\": ", tag > 0 ? "," : "", kMemoryTagNames[tag]);
+    WriteTagStats(file, tags[tag]);
+  }
+  fputs("\n  },\n  \"threads\": [", file);
+  for (size_t i = 0; i < threads.size(); i++) {
+    fprintf(file, "%s\n    {\"uid\": %zu, \"tags\": {", i > 0 ? "," : "",
+            threads[i].thread_uid);
+    bool first = true;
+    for (size_t tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+      if (!IsTagUsed(threads[i].tags[tag])) {
+        continue;
+      }
+      fprintf(file, "%s\"%s\": ", first ? "" : ", ", kMemoryTagNames[tag]);
+      WriteTagStats(file, threads[i].tags[tag]);
+      first = false;
+    }
+    fputs("}}", file);
+  }
+  fputs("\n  ],\n  \"pools\": [", file);
+  for (size_t i = 0; i < RNR_POOL_CLASS_COUNT; i++) {
+    fprintf(file, "%s\n    {\"block_size\": %zu, \"blocks_in_use\": %zu, \"block_count\": %zu}",
+            i > 0 ? "," : "", stats.pools[i].block_size, stats.pools[i].blocks_in_use,
+            stats.pools[i].block_count);
+  }
+  fprintf(file, "\n  ],\n  \"large_allocations\": %zu,\n", stats.large_allocations);
+  fprintf(file, "  \"frame_arena\": {\"used\": %zu, \"peak\": %zu, \"capacity\": %zu, "
+                "\"overflows\": %llu}\n}\n",
+          stats.frame_arena_used, stats.frame_arena_peak, stats.frame_arena_capacity,
+          (unsigned long long)stats.frame_arena_overflows);
+
+  bool failed = ferror(file) != 0;
+  if (fclose(file) != 0 || failed) {
+    return CreateStatus(StatusKind::STATUS_ERROR, "Could not write %s", path);
+  }
+  return {};
+}
+
+}   // namespace utils
+}   // namespace renoir
+
+#if RNR_MEMORY_COUNT_NEW
+
+// Same as the default ones, only counted
+
+void *operator new(size_t size) {
+  void *ptr = ::renoir::utils::HeapAllocate(size > 0 ? size : 1);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t&) noexcept {
+  return ::renoir::utils::HeapAllocate(size > 0 ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return ::renoir::utils::HeapAllocate(size > 0 ? size : 1);
+}
+
+void operator delete(void *ptr) noexcept {
+  ::renoir::utils::HeapFree(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+  ::renoir::utils::HeapFree(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t&) noexcept {
+  ::renoir::utils::HeapFree(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept {
+  ::renoir::utils::HeapFree(ptr);
+}
+
+#endif  // RNR_MEMORY_COUNT_NEW
@@ -0,0 +1,296 @@
+/******************************************************************************
+ * @file: memory.h
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-26
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * Allocators that keep the heap out of the frame:
+ *
+ * - The frame arena: a linear allocator that is reset at frame boundaries.
+ *   It is double buffered, so an allocation lives for the frame it was made
+ *   in and the next one. Meant for the strings and scratch containers the UI
+ *   builds every frame (FrameFormattedString, FrameVector, FrameMap). Main
+ *   thread only.
+ * - Fixed size pools, and on top of them PoolAllocate/PoolFree, which serve
+ *   small blocks from size classes. Freed blocks are kept for reuse, so once
+ *   the pools have grown to what the program needs they don't touch the heap
+ *   again. ImGui allocates through them.
+ *
+ * Every heap allocation (global new, and the blocks of these allocators) is
+ * counted, so GetMemoryStats tells how many happened during the last frame.
+ * In steady state it should be 0.
+ *
+ * Allocations are also tracked by subsystem. Each thread has a current
+ * MemoryTag (RNR_MEMORY_TAG scopes it) that heap and pool allocations are
+ * charged to, and its own counters, which only it writes, so tracking costs
+ * a few plain loads and stores and never a lock or a shared atomic. A block
+ * freed by another thread is discounted from that thread's counters, so only
+ * the sums over every thread are meaningful. Heap blocks carry a 16 byte
+ * header with their size and tag.
+ ******************************************************************************/
+
+#ifndef SRC_UTILS_MEMORY_H
+#define SRC_UTILS_MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "utils/macros.h"
+#include "utils/status.h"
+
+// Of each of the two frame arenas. It grows when a frame needs more.
+#ifndef RNR_FRAME_ARENA_SIZE
+#define RNR_FRAME_ARENA_SIZE (1024 * 1024)
+#endif
+// Replace the global operator new/delete to count the allocations
+#ifndef RNR_MEMORY_COUNT_NEW
+#define RNR_MEMORY_COUNT_NEW 1
+#endif
+// Alignment of every arena and pool allocation (enough for any basic type)
+#define RNR_MEMORY_ALIGNMENT 16
+// Pools allocate their blocks in pages of about this size
+#define RNR_POOL_PAGE_SIZE (64 * 1024)
+// Size classes of PoolAllocate: 16, 32, ... 2048 bytes. Bigger allocations go
+// straight to the heap.
+#define RNR_POOL_CLASS_COUNT 8
+#define RNR_POOL_MIN_SIZE 16
+
+namespace renoir {
+namespace utils {
+
+enum MemoryTag : uint8_t {
+  MEMORY_TAG_GENERAL,
+  MEMORY_TAG_LOGGING,
+  MEMORY_TAG_IMGUI,
+  MEMORY_TAG_DOCK,
+  MEMORY_TAG_GL_STAGING,
+  MEMORY_TAG_PROFILING,
+  // The pages of the pools and the frame arenas. What other tags have pooled
+  // lives inside them.
+  MEMORY_TAG_ALLOCATORS,
+  MEMORY_TAG_COUNT,
+};
+
+const char *GetMemoryTagName(MemoryTag tag);
+
+// Of the calling thread. Returns the previous one.
+MemoryTag SetThreadMemoryTag(MemoryTag tag);
+MemoryTag GetThreadMemoryTag();
+// Called by platform::ThreadContext, so the counters can be matched with the
+// thread's name
+void SetThreadMemoryUID(size_t thread_uid);
+
+class ScopedMemoryTag {
+ public:
+  explicit ScopedMemoryTag(MemoryTag tag) : previous_(SetThreadMemoryTag(tag)) {}
+  ~ScopedMemoryTag() { SetThreadMemoryTag(previous_); }
+  DISABLE_COPY(ScopedMemoryTag);
+  DISABLE_MOVE(ScopedMemoryTag);
+
+ private:
+  MemoryTag previous_;
+};
+
+// Charges the allocations until the end of the scope to |tag|
+#define RNR_MEMORY_TAG(tag) \
+  ::renoir::utils::ScopedMemoryTag COMBINE(rnr_memory_tag_, __LINE__)(tag)
+
+// Memory we don't allocate but own, like GL buffers. |delta| can be negative.
+void TrackExternalBytes(MemoryTag tag, int64_t delta);
+
+// Counted malloc/free. What the allocators use for their own memory.
+void *HeapAllocate(size_t size);
+void HeapFree(void *ptr);
+// Since the start of the program, from every thread
+uint64_t GetHeapAllocationCount();
+
+/**
+ * Bump allocator over a fixed buffer. Allocations are only freed all at once
+ * by Reset. When the buffer runs out it keeps going with blocks from the heap,
+ * and the next Reset grows the buffer to the peak so that doesn't happen
+ * again.
+ * Not thread safe.
+ */
+class LinearArena {
+ public:
+  explicit LinearArena(size_t capacity);
+  ~LinearArena();
+  DISABLE_COPY(LinearArena);
+  DISABLE_MOVE(LinearArena);
+
+ public:
+  // |alignment| must be a power of two
+  void *Allocate(size_t size, size_t alignment = RNR_MEMORY_ALIGNMENT);
+  void Reset();
+
+  // Including the heap blocks
+  size_t used() const { return used_ + overflow_bytes_; }
+  size_t peak() const { return peak_; }
+  size_t capacity() const { return capacity_; }
+  // Allocations that didn't fit in the buffer
+  uint64_t overflows() const { return overflows_; }
+
+ private:
+  struct OverflowBlock {
+    OverflowBlock *next;
+  };
+
+ private:
+  uint8_t *buffer_ = nullptr;
+  size_t capacity_ = 0;
+  size_t used_ = 0;
+  OverflowBlock *overflow_blocks_ = nullptr;
+  size_t overflow_bytes_ = 0;
+  size_t peak_ = 0;
+  uint64_t overflows_ = 0;
+};
+
+/**
+ * Blocks of a single size, kept in a free list. Pages of blocks are taken
+ * from the heap when the list is empty and only given back on destruction.
+ * Not thread safe.
+ */
+class FixedPool {
+ public:
+  // |block_size| is rounded up to RNR_MEMORY_ALIGNMENT
+  FixedPool(size_t block_size, size_t blocks_per_page);
+  ~FixedPool();
+  DISABLE_COPY(FixedPool);
+  DISABLE_MOVE(FixedPool);
+
+ public:
+  void *Allocate();
+  void Free(void *block);
+
+  size_t block_size() const { return block_size_; }
+  size_t blocks_in_use() const { return blocks_in_use_; }
+  size_t block_count() const { return block_count_; }
+
+ private:
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+  struct Page {
+    Page *next;
+  };
+
+ private:
+  size_t block_size_;
+  size_t blocks_per_page_;
+  FreeBlock *free_list_ = nullptr;
+  Page *pages_ = nullptr;
+  size_t blocks_in_use_ = 0;
+  size_t block_count_ = 0;
+};
+
+// Any thread. Aligned to RNR_MEMORY_ALIGNMENT. PoolFree takes nullptr.
+void *PoolAllocate(size_t size);
+void PoolFree(void *ptr);
+
+// Main thread, once per frame before anything allocates from the frame
+// arena. Everything allocated two frames ago is gone after it.
+void BeginMemoryFrame();
+// Main thread. Valid until the end of the next frame.
+void *FrameAllocate(size_t size, size_t alignment = RNR_MEMORY_ALIGNMENT);
+// FormattedString into the frame arena
+const char *FrameFormattedString(const char *fmt, ...) PRINTF_FORMAT_ATTRIBUTE(1, 2);
+
+// For standard containers that only live within a frame. Deallocation does
+// nothing, the memory comes back with the arena.
+template <typename T>
+class FrameAllocator {
+ public:
+  using value_type = T;
+
+  FrameAllocator() = default;
+  template <typename U>
+  FrameAllocator(const FrameAllocator<U>&) {}
+
+  T *allocate(size_t count) {
+    return (T*)FrameAllocate(count * sizeof(T), alignof(T) > RNR_MEMORY_ALIGNMENT
+                                                    ? alignof(T)
+                                                    : RNR_MEMORY_ALIGNMENT);
+  }
+  void deallocate(T*, size_t) {}
+};
+
+template <typename T, typename U>
+bool operator==(const FrameAllocator<T>&, const FrameAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const FrameAllocator<T>&, const FrameAllocator<U>&) { return false; }
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+template <typename K, typename V>
+using FrameMap = std::map<K, V, std::less<K>, FrameAllocator<std::pair<const K, V>>>;
+
+struct MemoryTagStats {
+  int64_t live_heap_bytes = 0;
+  // PoolAllocate blocks (requested size)
+  int64_t live_pooled_bytes = 0;
+  // TrackExternalBytes
+  int64_t external_bytes = 0;
+  // Of heap + pooled + external, sampled at every BeginMemoryFrame
+  int64_t peak_bytes = 0;
+  uint64_t heap_allocations = 0;
+  uint64_t pool_allocations = 0;
+  uint64_t frees = 0;
+  // Heap + pool allocations between the last two BeginMemoryFrame
+  uint64_t last_frame_allocations = 0;
+};
+
+// Sums over every thread, indexed by MemoryTag
+void GetMemoryTagStats(MemoryTagStats stats[MEMORY_TAG_COUNT]);
+
+struct ThreadMemoryUsage {
+  // 0 if the thread never created its platform::ThreadContext
+  size_t thread_uid = 0;
+  // Only the live and total counters, peaks are not tracked per thread
+  MemoryTagStats tags[MEMORY_TAG_COUNT];
+};
+
+// Threads that allocated at some point, including the ones that exited
+size_t GetTrackedThreadCount();
+// Fills up to |max_count| and returns how many
+size_t GetThreadMemoryUsage(ThreadMemoryUsage *usage, size_t max_count);
+
+struct PoolClassStats {
+  size_t block_size = 0;
+  size_t blocks_in_use = 0;
+  size_t block_count = 0;
+};
+
+struct MemoryStats {
+  uint64_t heap_allocations = 0;
+  // Between the last two BeginMemoryFrame
+  uint64_t last_frame_heap_allocations = 0;
+  // Frames in a row without heap allocations
+  uint64_t clean_frames = 0;
+
+  // Of the frame arena the last frame used
+  size_t frame_arena_used = 0;
+  size_t frame_arena_peak = 0;
+  size_t frame_arena_capacity = 0;
+  uint64_t frame_arena_overflows = 0;
+
+  PoolClassStats pools[RNR_POOL_CLASS_COUNT];
+  // Live PoolAllocate allocations bigger than the biggest class
+  size_t large_allocations = 0;
+};
+
+MemoryStats GetMemoryStats();
+
+// Tags, threads, pools and frame arena as JSON
+Status WriteMemoryReport(const char *path);
+
+}   // namespace utils
+}   // namespace renoir
+
+#endif  // SRC_UTILS_MEMORY_H
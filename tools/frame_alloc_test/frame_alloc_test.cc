@@ -0,0 +1,144 @@
+/******************************************************************************
+ * @file: frame_alloc_test.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-27
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * renoir_frame_alloc_test: runs frames that do what the editor frame does
+ * outside of ImGui and GL (profiling, logging, the log view with a search,
+ * the profiler stats refresh, jobs, the frame arena and the pools) and
+ * checks that once warmed up they don't touch the heap, on any thread.
+ * Exits with 1 if a measured frame allocated.
+ *
+ *  renoir_frame_alloc_test [WARMUP_FRAMES] [FRAMES]
+ *
+ * The warm up has to be long enough for the log history and the view to
+ * reach their retention limits, after which they only reuse memory. The
+ * default one fills the history budget twice. The history uses the editor's
+ * budget, the view a small one (see the target).
+ ******************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "logging/log.h"
+#include "logging/log_view.h"
+#include "platform/jobs.h"
+#include "profiling/profile_snapshot.h"
+#include "profiling/profiler.h"
+#include "utils/memory.h"
+
+using namespace ::renoir::logging;
+using namespace ::renoir::profiling;
+using namespace ::renoir::utils;
+
+namespace {
+
+// Entries logged per frame, more than the editor does when idle
+const size_t kLogsPerFrame = 64;
+// Frames between profiler stats refreshes (250 ms at 60 fps)
+const size_t kStatsRefreshFrames = 15;
+
+struct FrameState {
+  LogView view;
+  ProfileSnapshot snapshot;
+  std::vector<ProfileZoneStats> stats;
+};
+
+void RunFrame(FrameState *state, size_t frame) {
+  RNR_PROFILE_FRAME();
+  BeginMemoryFrame();
+  RNR_PROFILE_SCOPE("Frame");
+
+  {
+    RNR_PROFILE_SCOPE("Log");
+    for (size_t i = 0; i < kLogsPerFrame; i++) {
+      RNR_LOG_INFO("Frame %zu entry %zu: %s", frame, i, "some text to search");
+    }
+  }
+
+  {
+    RNR_PROFILE_SCOPE("Jobs");
+    ::renoir::platform::ParallelFor(0, 256, 16, [](size_t begin, size_t end) {
+      RNR_PROFILE_SCOPE("Job piece");
+      volatile size_t sum = 0;
+      for (size_t i = begin; i < end; i++) {
+        sum += i;
+      }
+    });
+  }
+
+  {
+    RNR_PROFILE_SCOPE("UI scratch");
+    FrameVector<int> values;
+    FrameMap<size_t, int> lanes;
+    for (int i = 0; i < 100; i++) {
+      values.push_back(i);
+      lanes[(size_t)i % 7] += i;
+    }
+    FrameFormattedString("Frame %zu: %zu values", frame, values.size());
+
+    void *blocks[8];
+    for (size_t i = 0; i < 8; i++) {
+      blocks[i] = PoolAllocate(16 << i);
+    }
+    for (void *block : blocks) {
+      PoolFree(block);
+    }
+  }
+
+  state->view.Update();
+  if (frame % kStatsRefreshFrames == 0) {
+    RNR_PROFILE_SCOPE("Profiler stats");
+    TakeProfileSnapshot(RNR_PROFILE_FRAME_COUNT, &state->snapshot);
+    ComputeProfileZoneStats(state->snapshot, &state->stats);
+  }
+}
+
+}   // namespace
+
+int main(int argc, char **argv) {
+  size_t budget_frames = RNR_LOG_HISTORY_MAX_CHUNKS * RNR_LOG_HISTORY_CHUNK_ENTRIES / kLogsPerFrame;
+  size_t warmup_frames = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 2 * budget_frames;
+  size_t frames = argc > 2 ? (size_t)strtoull(argv[2], nullptr, 10) : 600;
+
+  ::renoir::platform::StartJobSystem(3);
+  StartLogDrainThread(false);
+  SetLogOverflowPolicy(LogOverflowPolicy::LOG_OVERFLOW_BLOCK);
+
+  FrameState *state = new FrameState();
+  LogFilter filter;
+  filter.text = "search";
+  state->view.SetFilter(filter);
+
+  for (size_t frame = 0; frame < warmup_frames; frame++) {
+    RunFrame(state, frame);
+  }
+
+  size_t failed_frames = 0;
+  uint64_t total = 0;
+  for (size_t frame = warmup_frames; frame < warmup_frames + frames; frame++) {
+    uint64_t start = GetHeapAllocationCount();
+    RunFrame(state, frame);
+    uint64_t allocations = GetHeapAllocationCount() - start;
+    if (allocations > 0 && failed_frames++ < 10) {
+      printf("Frame %zu: %llu heap allocations\n", frame, (unsigned long long)allocations);
+    }
+    total += allocations;
+  }
+
+  delete state;
+  StopLogDrainThread();
+  ::renoir::platform::StopJobSystem();
+
+  printf("%zu frames after %zu of warm up: %llu heap allocations in %zu frames\n", frames,
+         warmup_frames, (unsigned long long)total, failed_frames);
+  if (total != 0) {
+    printf("FAIL: frames allocated in steady state\n");
+    return 1;
+  }
+  printf("PASS\n");
+  return 0;
+}
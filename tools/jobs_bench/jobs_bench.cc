@@ -0,0 +1,106 @@
+/******************************************************************************
+ * @file: jobs_bench.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-17
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * renoir_jobs_bench: jobs/sec of the job system with fine-grained jobs,
+ * from 1 thread up to one per core.
+ *
+ *  renoir_jobs_bench [JOB_COUNT] [JOB_US]
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "platform/clock.h"
+#include "platform/jobs.h"
+
+using namespace ::renoir::platform;
+
+namespace {
+
+// Children per root job
+const size_t kBatchSize = 2048;
+
+struct BenchJob {
+  uint64_t duration_ticks;
+};
+
+struct BatchJob {
+  size_t count;
+  JobFunction function;
+  BenchJob bench_job;
+};
+
+void BusyJob(Job *, const void *data) {
+  const BenchJob *bench_job = (const BenchJob*)data;
+  uint64_t end = GetTicks() + bench_job->duration_ticks;
+  while (GetTicks() < end) {}
+}
+
+void EmptyJob(Job *, const void *) {}
+
+// The root creates its children, so it's already running if they wrap
+// around its thread's job pool
+void SpawnBatchJob(Job *job, const void *data) {
+  const BatchJob *batch = (const BatchJob*)data;
+  JobHandle self;
+  self.job = job;
+  self.generation = job->generation.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < batch->count; i++) {
+    RunJob(CreateChildJob(self, batch->function, &batch->bench_job, sizeof(batch->bench_job)));
+  }
+}
+
+double RunBench(size_t job_count, uint64_t duration_ticks) {
+  BenchJob bench_job = {duration_ticks};
+  JobFunction function = duration_ticks ? BusyJob : EmptyJob;
+
+  uint64_t start = GetTicks();
+  for (size_t done = 0; done < job_count; done += kBatchSize) {
+    BatchJob batch = {std::min(kBatchSize, job_count - done), function, bench_job};
+    JobHandle root = CreateJob(SpawnBatchJob, &batch, sizeof(batch));
+    RunJob(root);
+    WaitForJob(root);
+  }
+  return TicksToSeconds(GetTicks() - start);
+}
+
+}   // namespace
+
+int main(int argc, char **argv) {
+  size_t job_count = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 1000000;
+  double job_us = argc > 2 ? atof(argv[2]) : 1.0;
+  uint64_t duration_ticks = NanosecondsToTicks((uint64_t)(job_us * 1000.0));
+
+  size_t cores = std::thread::hardware_concurrency();
+  if (cores == 0) {
+    cores = 1;
+  }
+
+  printf("%zu jobs of %.2f us\n", job_count, job_us);
+  printf("%8s %16s %16s %10s %16s\n", "threads", "empty jobs/s", "busy jobs/s", "speedup",
+         "efficiency");
+  double single_thread_rate = 0;
+  for (size_t threads = 1; threads <= cores; threads++) {
+    StartJobSystem(threads - 1);
+    double empty_seconds = RunBench(job_count, 0);
+    double busy_seconds = RunBench(job_count, duration_ticks);
+    StopJobSystem();
+
+    double empty_rate = (double)job_count / empty_seconds;
+    double busy_rate = (double)job_count / busy_seconds;
+    if (threads == 1) {
+      single_thread_rate = busy_rate;
+    }
+    double speedup = busy_rate / single_thread_rate;
+    printf("%8zu %16.0f %16.0f %9.2fx %15.0f%%\n", threads, empty_rate, busy_rate, speedup,
+           100.0 * speedup / (double)threads);
+  }
+  return 0;
+}
@@ -0,0 +1,76 @@
+/******************************************************************************
+ * @file: log_alloc_test.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-27
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * renoir_log_alloc_test: checks that logging doesn't touch the heap once
+ * warmed up, counting with utils::GetHeapAllocationCount (every thread, so
+ * the drain is included). Exits with 1 if any call allocated.
+ *
+ *  renoir_log_alloc_test [CALLS]
+ *
+ * Warming up registers the thread's context and fills the history budget
+ * (RNR_LOG_HISTORY_BUDGET_BYTES, the one the editor uses), after which the
+ * drain only recycles chunks.
+ ******************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "logging/log.h"
+#include "utils/memory.h"
+
+using namespace ::renoir::logging;
+
+namespace {
+
+// Every argument kind the encoder handles
+void LogEveryKind(size_t i) {
+  RNR_LOG_INFO("Entry %zu: %d %u %lld %f %c %s %p", i, (int)i, (unsigned)i, (long long)i,
+               (double)i * 0.5, 'x', "some string", (void*)&i);
+  RNR_LOG_WARN("No arguments");
+}
+
+// Waits until the drain took everything we logged
+void WaitForDrain(const ThreadLocalLogContext *context) {
+  while (context->read_index.load() != context->write_index.load()) {
+    std::this_thread::yield();
+  }
+}
+
+}   // namespace
+
+int main(int argc, char **argv) {
+  size_t calls = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 100000;
+
+  StartLogDrainThread(false);
+  ThreadLocalLogContext *context = GetLocalLogContext();
+  SetLogOverflowPolicy(LogOverflowPolicy::LOG_OVERFLOW_BLOCK);
+
+  size_t warmup_calls = 2 * RNR_LOG_HISTORY_CHUNK_ENTRIES * RNR_LOG_HISTORY_MAX_CHUNKS;
+  for (size_t i = 0; i < warmup_calls; i++) {
+    LogEveryKind(i);
+  }
+  WaitForDrain(context);
+
+  uint64_t start = ::renoir::utils::GetHeapAllocationCount();
+  for (size_t i = 0; i < calls; i++) {
+    LogEveryKind(i);
+  }
+  WaitForDrain(context);
+  uint64_t allocations = ::renoir::utils::GetHeapAllocationCount() - start;
+  StopLogDrainThread();
+
+  printf("%zu log calls, %llu heap allocations, %llu dropped\n", 2 * calls,
+         (unsigned long long)allocations, (unsigned long long)context->dropped.load());
+  if (allocations != 0) {
+    printf("FAIL: logging allocated in steady state\n");
+    return 1;
+  }
+  printf("PASS\n");
+  return 0;
+}
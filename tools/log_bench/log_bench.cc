@@ -0,0 +1,125 @@
+/******************************************************************************
+ * @file: log_bench.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-27
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * renoir_log_bench: cost of a log call (ns per RNR_LOG_INFO) on the calling
+ * thread, with 1, 4 and 16 threads logging at once and the drain running.
+ *
+ *  renoir_log_bench [CALLS_PER_THREAD] [drop|overwrite|block]
+ *
+ * Calls the overflow policy discarded are cheaper than the rest, so the
+ * share of them is printed too. With "block" nothing is discarded unless
+ * the drain falls behind for RNR_LOG_BLOCK_TIMEOUT_US.
+ ******************************************************************************/
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "logging/log.h"
+#include "platform/clock.h"
+
+using namespace ::renoir::logging;
+using namespace ::renoir::platform;
+
+namespace {
+
+const size_t kThreadCounts[] = {1, 4, 16};
+
+struct ProducerResult {
+  uint64_t ticks = 0;
+  uint64_t discarded = 0;
+};
+
+struct BenchResult {
+  double ns_per_call = 0;
+  double calls_per_second = 0;
+  double discarded_percent = 0;
+};
+
+void ProducerMain(size_t calls, LogOverflowPolicy policy, const std::atomic<bool> *go,
+                  ProducerResult *result) {
+  ThreadLocalLogContext *context = GetLocalLogContext();
+  SetLogOverflowPolicy(policy);
+  uint64_t discarded_before = context->dropped.load() + context->overwritten.load();
+  while (!go->load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+
+  uint64_t start = GetTicks();
+  for (size_t i = 0; i < calls; i++) {
+    RNR_LOG_INFO("Bench entry %zu of %zu (%f)", i, calls, (double)i * 0.5);
+  }
+  result->ticks = GetTicks() - start;
+  result->discarded = context->dropped.load() + context->overwritten.load() - discarded_before;
+}
+
+BenchResult RunBench(size_t thread_count, size_t calls, LogOverflowPolicy policy) {
+  std::atomic<bool> go(false);
+  std::vector<ProducerResult> results(thread_count);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < thread_count; i++) {
+    threads.emplace_back(ProducerMain, calls, policy, &go, &results[i]);
+  }
+  go.store(true, std::memory_order_release);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  BenchResult bench;
+  uint64_t max_ticks = 0;
+  uint64_t discarded = 0;
+  double total_ns = 0;
+  for (const ProducerResult& result : results) {
+    total_ns += (double)TicksToNanoseconds(result.ticks);
+    max_ticks = result.ticks > max_ticks ? result.ticks : max_ticks;
+    discarded += result.discarded;
+  }
+  double total_calls = (double)(calls * thread_count);
+  bench.ns_per_call = total_ns / total_calls;
+  bench.calls_per_second = total_calls / TicksToSeconds(max_ticks);
+  bench.discarded_percent = 100.0 * (double)discarded / total_calls;
+  return bench;
+}
+
+bool ParsePolicy(const char *name, LogOverflowPolicy *policy) {
+  if (strcmp(name, "drop") == 0) {
+    *policy = LogOverflowPolicy::LOG_OVERFLOW_DROP_NEWEST;
+  } else if (strcmp(name, "overwrite") == 0) {
+    *policy = LogOverflowPolicy::LOG_OVERFLOW_OVERWRITE_OLDEST;
+  } else if (strcmp(name, "block") == 0) {
+    *policy = LogOverflowPolicy::LOG_OVERFLOW_BLOCK;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+}   // namespace
+
+int main(int argc, char **argv) {
+  size_t calls = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 1000000;
+  LogOverflowPolicy policy = LogOverflowPolicy::LOG_OVERFLOW_BLOCK;
+  if (argc > 2 && !ParsePolicy(argv[2], &policy)) {
+    fprintf(stderr, "Unknown policy \"%s\" (drop, overwrite or block)\n", argv[2]);
+    return 1;
+  }
+
+  StartLogDrainThread(false);
+  printf("%zu calls per thread, %s\n", calls, LogOverflowPolicy::ToString(policy).c_str());
+  printf("%8s %12s %16s %12s\n", "threads", "ns/call", "calls/s", "discarded");
+  for (size_t thread_count : kThreadCounts) {
+    BenchResult bench = RunBench(thread_count, calls, policy);
+    printf("%8zu %12.1f %16.0f %11.2f%%\n", thread_count, bench.ns_per_call,
+           bench.calls_per_second, bench.discarded_percent);
+  }
+  StopLogDrainThread();
+  return 0;
+}
@@ -0,0 +1,93 @@
+/******************************************************************************
+ * @file: log_format_test.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-27
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * renoir_log_format_test: checks that the deferred formatting (FormatLogArgs)
+ * prints the same as snprintf with the same arguments. Exits with 1 if any
+ * case differs.
+ ******************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+
+#include "logging/log_format.h"
+
+using namespace ::renoir::logging;
+
+namespace {
+
+int failures = 0;
+
+void Compare(const char *fmt, const char *deferred, const char *expected) {
+  if (strcmp(deferred, expected) != 0) {
+    printf("FAIL \"%s\": got \"%s\", expected \"%s\"\n", fmt, deferred, expected);
+    failures++;
+  }
+}
+
+// Formats |args| both ways and compares them
+template <typename... Args>
+void Check(const char *fmt, Args... args) {
+  uint8_t buffer[256];
+  bool truncated;
+  size_t len = EncodeLogArgs(buffer, sizeof(buffer), &truncated, args...);
+  char deferred[256];
+  FormatLogArgs(fmt, buffer, len, deferred, sizeof(deferred));
+  char expected[256];
+  snprintf(expected, sizeof(expected), fmt, args...);
+  Compare(fmt, deferred, expected);
+}
+
+// For cases snprintf can't do the same way (missing or unsupported ones)
+template <typename... Args>
+void CheckAgainst(const char *expected, const char *fmt, Args... args) {
+  uint8_t buffer[256];
+  bool truncated;
+  size_t len = EncodeLogArgs(buffer, sizeof(buffer), &truncated, args...);
+  char deferred[256];
+  FormatLogArgs(fmt, buffer, len, deferred, sizeof(deferred));
+  Compare(fmt, deferred, expected);
+}
+
+}   // namespace
+
+int main() {
+  // Negative values under the unsigned conversions are read at their width
+  Check("%x %u %o %X", -1, -1, -1, -1);
+  Check("%x %u %o", -42, -42, -42);
+  Check("%#x %08o %10u", -1, -8, -3);
+  Check("%hx %hu %hhx %hhu", (short)-1, (short)-1, (signed char)-1, (signed char)-1);
+  Check("%hx %hhu", -1, -1);
+  Check("%lx %lu %lo", -1L, -1L, -1L);
+  Check("%llx %llu %llo", -1LL, -1LL, -1LL);
+  Check("%zx %zu", (size_t)-1, (size_t)-1);
+  Check("%jd %jx", (intmax_t)-5, (intmax_t)-5);
+
+  // Narrower arguments are promoted, like varargs do
+  Check("%x %u %d", (short)-2, (signed char)-3, (short)-4);
+  Check("%d %u", (unsigned short)65535, (unsigned char)255);
+  Check("%d %i", -2147483647 - 1, 2147483647);
+  Check("%u %x", 4294967295u, 4294967295u);
+
+  // The rest of the conversions
+  Check("%5.2f|%-8s|%c|%e|%g", 3.14159, "abc", 'z', 1e10, 0.0001);
+  Check("%*d|%-*d|%.*s", 6, -12, 4, 7, 2, "hello");
+  Check("%+d % d %05d", 3, 3, -3);
+
+  // Unsupported conversions don't take an argument
+  CheckAgainst("%k 7 8", "%k %d %d", 7, 8);
+  CheckAgainst("%w 1 x", "%w %x %s", 1, "x");
+  // Missing ones print as <?>
+  CheckAgainst("1 <?>", "%d %d", 1);
+
+  if (failures > 0) {
+    printf("%d cases differ from printf\n", failures);
+    return 1;
+  }
+  printf("Deferred formatting matches printf\n");
+  return 0;
+}
@@ -0,0 +1,181 @@
+/******************************************************************************
+ * @file: logcat.cc
+ * @author: Cristián Donoso C.
+ * @email: cristiandonosoc@gmail.com
+ * @date: 2018-05-16
+ * @license: 2018 Cristián Donoso C. - All Rights Reserved.
+ *
+ * @description:
+ * renoir_logcat: decodes the binary log files written by FileLogSink.
+ *
+ *  renoir_logcat [-l LEVEL] [-t THREAD] [-f FILE] [-g TEXT] LOG_FILE...
+ *
+ * Files are printed in the order given, so pass rotated ones oldest first
+ * (renoir.rlog.3 renoir.rlog.2 renoir.rlog.1 renoir.rlog).
+ ******************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "logging/log_file.h"
+
+using ::renoir::logging::GetLogLevelShortName;
+using ::renoir::logging::LogFileReader;
+using ::renoir::logging::LogFileRecord;
+using ::renoir::logging::LogLevel;
+using ::renoir::logging::LogRecordHeader;
+using ::renoir::utils::IsStatusOk;
+using ::renoir::utils::Status;
+
+namespace {
+
+struct LogcatOptions {
+  int max_level = (int)LogLevel::LOG_DEBUG;
+  bool filter_thread = false;
+  size_t thread_uid = 0;
+  const char *filename = nullptr;   // Substring of the source filename
+  const char *text = nullptr;       // Substring of the formatted message
+};
+
+void PrintUsage() {
+  fprintf(stderr,
+          "Usage: renoir_logcat [options] LOG_FILE...\n"
+          "  -l LEVEL   Only entries at LEVEL or more severe (FATAL ERROR WARN INFO DEBUG)\n"
+          "  -t THREAD  Only entries of thread THREAD (the T# of the output)\n"
+          "  -f FILE    Only entries logged from a file containing FILE\n"
+          "  -g TEXT    Only entries whose message contains TEXT\n");
+}
+
+bool ParseLevel(const char *name, int *level) {
+  for (int i = 0; i <= (int)LogLevel::LOG_DEBUG; i++) {
+    if (strcmp(name, GetLogLevelShortName((LogLevel::InternalEnum)i)) == 0) {
+      *level = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Bounded strstr, as the filename in the file is not terminated
+bool Contains(const char *str, size_t len, const char *needle) {
+  size_t needle_len = strlen(needle);
+  if (needle_len > len) {
+    return false;
+  }
+  for (size_t i = 0; i + needle_len <= len; i++) {
+    if (memcmp(str + i, needle, needle_len) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool PrintLogFile(const char *path, const LogcatOptions& options) {
+  LogFileReader reader;
+  Status status = reader.Open(path);
+  if (!IsStatusOk(status)) {
+    fprintf(stderr, "%s\n", status.context.msg.c_str());
+    return false;
+  }
+
+  char message[4096];
+  LogFileRecord record;
+  while (reader.Next(&record)) {
+    const LogRecordHeader *header = record.header;
+    // The cheap filters go before paying for the formatting
+    if (header->level > options.max_level) {
+      continue;
+    }
+    if (options.filter_thread && header->thread_uid != options.thread_uid) {
+      continue;
+    }
+    if (options.filename && !Contains(record.filename, header->filename_len, options.filename)) {
+      continue;
+    }
+
+    reader.FormatMessage(record, message, sizeof(message));
+    if (options.text && !strstr(message, options.text)) {
+      continue;
+    }
+
+    time_t time;
+    size_t us;
+    reader.TicksToWallClock(header->ticks, &time, &us);
+    struct tm local_time;
+#ifdef _WIN32
+    localtime_s(&local_time, &time);
+#else
+    localtime_r(&time, &local_time);
+#endif
+    char time_buffer[32];
+    strftime(time_buffer, sizeof(time_buffer), "%H:%M:%S", &local_time);
+
+    // Only the basename, same as FormatLogLine
+    const char *filename = record.filename;
+    int filename_len = header->filename_len;
+    for (int i = 0; i < header->filename_len; i++) {
+      if (record.filename[i] == '/' || record.filename[i] == '\\') {
+        filename = record.filename + i + 1;
+        filename_len = header->filename_len - i - 1;
+      }
+    }
+
+    printf("[%s.%06zu][T%llu][%-5s] %.*s:%u: %s\n", time_buffer, us,
+           (unsigned long long)header->thread_uid,
+           GetLogLevelShortName((LogLevel::InternalEnum)header->level), filename_len, filename,
+           header->line, message);
+  }
+
+  if (reader.corrupted()) {
+    fprintf(stderr, "%s: stopped at a corrupted record\n", path);
+  }
+  return true;
+}
+
+}   // namespace
+
+int main(int argc, char **argv) {
+  LogcatOptions options;
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-'; arg++) {
+    const char *option = argv[arg];
+    if (strcmp(option, "-h") == 0 || strcmp(option, "--help") == 0) {
+      PrintUsage();
+      return 0;
+    }
+    if (arg + 1 >= argc) {
+      PrintUsage();
+      return 1;
+    }
+    const char *value = argv[++arg];
+    if (strcmp(option, "-l") == 0) {
+      if (!ParseLevel(value, &options.max_level)) {
+        fprintf(stderr, "Unknown level: %s\n", value);
+        return 1;
+      }
+    } else if (strcmp(option, "-t") == 0) {
+      options.filter_thread = true;
+      options.thread_uid = (size_t)strtoull(value, nullptr, 10);
+    } else if (strcmp(option, "-f") == 0) {
+      options.filename = value;
+    } else if (strcmp(option, "-g") == 0) {
+      options.text = value;
+    } else {
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  if (arg >= argc) {
+    PrintUsage();
+    return 1;
+  }
+
+  bool ok = true;
+  for (; arg < argc; arg++) {
+    ok = PrintLogFile(argv[arg], options) && ok;
+  }
+  return ok ? 0 : 1;
+}